@@ -0,0 +1,531 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+#include "AsyncRadio.h"
+
+static const char *TAG = "AsyncRadio";
+
+namespace TI_CC1101
+{
+    static const byte kHeaderReadBit  = 0b10000000;
+    static const byte kBurstAccessBit = 0b01000000;
+    // Writing a couple of unchanged registers is cheaper than starting a new burst, as in CC1101Device
+    static const int  kMaxWriteGap    = 2;
+
+    int AsyncRadio::Begin()
+    {
+        // Free slots first, then the oldest finished one
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (int i = 0; i < kMaxOps; i++)
+            {
+                int  slot     = (m_nextSlot + i) % kMaxOps;
+                Op  &op       = m_ops[slot];
+                byte expected = pass == 0 ? Free : Finished;
+
+                if (op.State.compare_exchange_strong(expected, Building, std::memory_order_acquire))
+                {
+                    op.Generation++;
+                    op.Overflowed  = false;
+                    op.Error       = RadioError::None;
+                    op.StepCount   = 0;
+                    op.ByteCount   = 0;
+                    op.Callback    = nullptr;
+                    op.Context     = nullptr;
+                    m_nextSlot     = (slot + 1) % kMaxOps;
+                    return slot;
+                }
+            }
+        }
+        ESP_LOGW(TAG, "all %d operations in flight", kMaxOps);
+        return -1;
+    }
+
+    bool AsyncRadio::AddWrite(int op, byte address, byte value)
+    {
+        return AddBurstWrite(op, address, &value, 1);
+    }
+
+    bool AsyncRadio::AddBurstWrite(int op, byte address, const byte *values, int length)
+    {
+        if (!addStep(op, StepKind::Write, address, length, 0))
+        {
+            return false;
+        }
+        Op &target = m_ops[op];
+        memcpy(&target.Bytes[target.Steps[target.StepCount - 1].Offset], values, length);
+        return true;
+    }
+
+    bool AsyncRadio::AddStrobe(int op, byte strobe)
+    {
+        return addStep(op, StepKind::Strobe, strobe, 0, 0);
+    }
+
+    bool AsyncRadio::AddRead(int op, byte address, int length)
+    {
+        return addStep(op, StepKind::Read, address, length, 0);
+    }
+
+    bool AsyncRadio::AddDelay(int op, uint32_t delayMicros)
+    {
+        return addStep(op, StepKind::Delay, 0, 0, delayMicros);
+    }
+
+    RadioFuture AsyncRadio::Submit(int op, RadioOpCallback callback, void *context)
+    {
+        RadioFuture future;
+        uint32_t    head = 0;
+
+        if (op < 0 || op >= kMaxOps || m_ops[op].State.load(std::memory_order_relaxed) != Building)
+        {
+            return future;
+        }
+        m_ops[op].Callback = callback;
+        m_ops[op].Context  = context;
+        m_ops[op].State.store(Queued, std::memory_order_release);
+
+        // At most kMaxOps operations are queued or running at once, so the queue can't overrun
+        head                    = m_queueHead.load(std::memory_order_relaxed);
+        m_queue[head % kMaxOps] = op;
+        m_queueHead.store(head + 1, std::memory_order_release);
+#if !defined(CC1101_HOST) && !defined(ARDUINO)
+        if (TaskHandle_t worker = m_worker.load())
+        {
+            xTaskNotifyGive(worker);
+        }
+#endif
+        future.Slot       = (int16_t)op;
+        future.Generation = m_ops[op].Generation;
+        return future;
+    }
+
+    RadioFuture AsyncRadio::Strobe(byte strobe, RadioOpCallback callback, void *context)
+    {
+        int op = Begin();
+
+        if (op >= 0)
+        {
+            AddStrobe(op, strobe);
+        }
+        return Submit(op, callback, context);
+    }
+
+    RadioFuture AsyncRadio::ReadStatus(byte address, RadioOpCallback callback, void *context)
+    {
+        int op = Begin();
+
+        if (op >= 0)
+        {
+            AddRead(op, address, 1);
+        }
+        return Submit(op, callback, context);
+    }
+
+    RadioFuture AsyncRadio::DumpRegisters(RadioOpCallback callback, void *context)
+    {
+        int op = Begin();
+
+        if (op >= 0)
+        {
+            AddRead(op, 0, CC1101_CONFIG::kNumConfigRegisters);
+            AddRead(op, CC1101_CONFIG::PATABLE, 8);
+        }
+        return Submit(op, callback, context);
+    }
+
+    RadioFuture AsyncRadio::ApplyRegisters(const byte (&registers)[CC1101_CONFIG::kNumConfigRegisters], const byte (&patable)[8], bool enterReceive, RadioOpCallback callback, void *context)
+    {
+        int op = Begin();
+
+        if (op >= 0)
+        {
+            // The whole image is staged; only what differs from the chip goes out
+            AddStrobe(op, CC1101_CONFIG::SIDLE);
+            AddBurstWrite(op, 0, registers, CC1101_CONFIG::kNumConfigRegisters);
+            AddBurstWrite(op, CC1101_CONFIG::PATABLE, patable, 8);
+            if (enterReceive)
+            {
+                AddStrobe(op, CC1101_CONFIG::SRX);
+            }
+        }
+        return Submit(op, callback, context);
+    }
+
+    void AsyncRadio::SeedShadow(const byte (&registers)[CC1101_CONFIG::kNumConfigRegisters], const byte (&patable)[8])
+    {
+        memcpy(m_shadow, registers, sizeof(m_shadow));
+        memcpy(m_patableShadow, patable, sizeof(m_patableShadow));
+        m_known        = (1ull << CC1101_CONFIG::kNumConfigRegisters) - 1;
+        m_patableKnown = true;
+    }
+
+    RadioOpStatus AsyncRadio::Status(RadioFuture future) const
+    {
+        if (!future.IsValid() || future.Slot >= kMaxOps)
+        {
+            return RadioOpStatus::Gone;
+        }
+        const Op &op = m_ops[future.Slot];
+        if (op.Generation != future.Generation)
+        {
+            return RadioOpStatus::Gone;
+        }
+        if (op.State.load(std::memory_order_acquire) != Finished)
+        {
+            return RadioOpStatus::Pending;
+        }
+        return op.Error != RadioError::None ? RadioOpStatus::Failed : RadioOpStatus::Done;
+    }
+
+    RadioError AsyncRadio::Error(RadioFuture future) const
+    {
+        if (Status(future) == RadioOpStatus::Failed)
+        {
+            return m_ops[future.Slot].Error;
+        }
+        return RadioError::None;
+    }
+
+    int AsyncRadio::Result(RadioFuture future, byte *out, int maxLength) const
+    {
+        int count = 0;
+
+        if (Status(future) != RadioOpStatus::Done)
+        {
+            return -1;
+        }
+        const Op &op = m_ops[future.Slot];
+        for (int i = 0; i < op.StepCount && count < maxLength; i++)
+        {
+            const Step &step = op.Steps[i];
+            if (step.Kind == StepKind::Read)
+            {
+                int length = std::min((int)step.Length, maxLength - count);
+                memcpy(&out[count], &op.Bytes[step.Offset], length);
+                count += length;
+            }
+        }
+        return count;
+    }
+
+    void AsyncRadio::RunPending()
+    {
+        uint32_t tail  = m_queueTail.load(std::memory_order_relaxed);
+        uint32_t head  = m_queueHead.load(std::memory_order_acquire);
+        int      count = 0;
+        int      batch[kMaxOps];
+
+        if (tail == head)
+        {
+            return;
+        }
+        for (; tail != head; tail++)
+        {
+            batch[count++] = m_queue[tail % kMaxOps];
+        }
+        for (int i = 0; i < count; i++)
+        {
+            Op &op = m_ops[batch[i]];
+            if (op.Overflowed)
+            {
+                op.Error = RadioError::InvalidConfig;
+                continue;
+            }
+            saveStaged();
+            for (int s = 0; s < op.StepCount && op.Error == RadioError::None; s++)
+            {
+                if (!runStep(op, op.Steps[s]))
+                {
+                    op.Error = m_bus.LastError();
+                }
+            }
+            if (op.Error != RadioError::None)
+            {
+                restoreStaged();
+            }
+        }
+        // A failure here fails the operations whose writes were still staged
+        flushWrites();
+        m_queueTail.store(head, std::memory_order_release);
+        m_batches++;
+
+        for (int i = 0; i < count; i++)
+        {
+            Op         &op     = m_ops[batch[i]];
+            RadioFuture future = {(int16_t)batch[i], op.Generation};
+
+            op.State.store(Finished, std::memory_order_release);
+            if (op.Callback != nullptr)
+            {
+                op.Callback(future, op.Error != RadioError::None ? RadioOpStatus::Failed : RadioOpStatus::Done, op.Context);
+            }
+        }
+    }
+
+#if !defined(CC1101_HOST) && !defined(ARDUINO)
+    bool AsyncRadio::Start(UBaseType_t taskPriority)
+    {
+        bool         bRet = true;
+        TaskHandle_t task = nullptr;
+
+        CBRA(m_worker == nullptr);
+        CBRA(xTaskCreate(workerTask, "cc1101async", kWorkerStackSize, this, taskPriority, &task) == pdPASS);
+        m_worker = task;
+        // Anything submitted before the task existed
+        xTaskNotifyGive(task);
+
+    Error:
+        return bRet;
+    }
+
+    void AsyncRadio::workerTask(void *context)
+    {
+        AsyncRadio *radio = static_cast<AsyncRadio *>(context);
+
+        for (;;)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            radio->RunPending();
+        }
+    }
+#endif
+
+    bool AsyncRadio::addStep(int op, StepKind kind, byte address, int length, uint32_t delayMicros)
+    {
+        if (op < 0 || op >= kMaxOps)
+        {
+            return false;
+        }
+        Op &target = m_ops[op];
+        if (target.StepCount == kMaxSteps || target.ByteCount + length > kMaxOpBytes)
+        {
+            target.Overflowed = true;
+            return false;
+        }
+        target.Steps[target.StepCount++] = {kind, address, (byte)length, (byte)target.ByteCount, delayMicros};
+        target.ByteCount += length;
+        return true;
+    }
+
+    bool AsyncRadio::runStep(Op &op, const Step &step)
+    {
+        bool  bRet    = true;
+        byte  status  = 0;
+        byte *data    = &op.Bytes[step.Offset];
+        byte  address = step.Address & 0b00111111;
+
+        switch (step.Kind)
+        {
+            case StepKind::Write:
+                if (address + step.Length <= CC1101_CONFIG::kNumConfigRegisters)
+                {
+                    bRet = stageWrites(op, address, data, step.Length);
+                    break;
+                }
+                // PATABLE and TX FIFO are barriers: their contents depend on the access order
+                CBR(flushBefore(op));
+                if (address == CC1101_CONFIG::PATABLE && step.Length == sizeof(m_patableShadow))
+                {
+                    if (m_patableKnown && memcmp(m_patableShadow, data, step.Length) == 0)
+                    {
+                        break;
+                    }
+                    memcpy(m_patableShadow, data, step.Length);
+                    m_patableKnown = true;
+                }
+                else if (address == CC1101_CONFIG::PATABLE)
+                {
+                    m_patableKnown = false;
+                }
+                if (step.Length == 1)
+                {
+                    CBR(m_bus.WriteByteToAddress(address, data[0], status));
+                }
+                else
+                {
+                    CBR(m_bus.WriteBytesToAddress(address | kBurstAccessBit, data, step.Length, status));
+                }
+                trackStatus(status);
+                break;
+            case StepKind::Strobe:
+                CBR(flushBefore(op));
+                CBR(m_bus.WriteByte(address, status));
+                trackStatus(status);
+                if (address == CC1101_CONFIG::SRES)
+                {
+                    memcpy(m_shadow, ConfigValues::CONFIG_REGISTER_RESET_VALUES, sizeof(m_shadow));
+                    m_known        = (1ull << CC1101_CONFIG::kNumConfigRegisters) - 1;
+                    m_patableKnown = false;
+                }
+                break;
+            case StepKind::Read:
+                CBR(flushBefore(op));
+                if (step.Length == 1)
+                {
+                    // Status registers need the burst bit to be told apart from the strobes
+                    bool statusRegister = address >= CC1101_CONFIG::PARTNUM && address <= CC1101_CONFIG::RCCTRL0_STATUS;
+                    CBR(m_bus.ReadRegister(address | kHeaderReadBit | (statusRegister ? kBurstAccessBit : 0), data[0]));
+                }
+                else
+                {
+                    CBR(m_bus.ReadBurstRegister(address | kHeaderReadBit | kBurstAccessBit, data, step.Length));
+                }
+                break;
+            case StepKind::Delay:
+                CBR(flushBefore(op));
+#if defined(CC1101_HOST)
+                // The simulated bus has no timing
+#elif defined(ARDUINO)
+                delayMicroseconds(step.DelayMicros);
+#else
+                if (step.DelayMicros >= portTICK_PERIOD_MS * 1000)
+                {
+                    vTaskDelay(pdMS_TO_TICKS(step.DelayMicros / 1000));
+                }
+                else
+                {
+                    delayMicroseconds(step.DelayMicros);
+                }
+#endif
+                break;
+        }
+
+    Error:
+        return bRet;
+    }
+
+    bool AsyncRadio::stageWrites(const Op &op, byte address, const byte *values, int length)
+    {
+        for (int i = 0; i < length; i++)
+        {
+            uint64_t bit = 1ull << (address + i);
+            if ((m_stagedMask & bit) != 0)
+            {
+                m_writesCoalesced++; // overwritten before it reached the chip
+            }
+            m_staged[address + i]   = values[i];
+            m_stagedBy[address + i] = (int8_t)(&op - m_ops);
+            m_stagedMask |= bit;
+        }
+        return true;
+    }
+
+    // The flush in front of a barrier step. If it fails, the barrier still runs unless op staged some of the writes
+    // that didn't go out.
+    bool AsyncRadio::flushBefore(const Op &op)
+    {
+        return flushWrites() || op.Error == RadioError::None;
+    }
+
+    void AsyncRadio::saveStaged()
+    {
+        memcpy(m_undoStaged, m_staged, sizeof(m_undoStaged));
+        memcpy(m_undoStagedBy, m_stagedBy, sizeof(m_undoStagedBy));
+        m_undoMask = m_stagedMask;
+    }
+
+    // Takes back what the failed operation staged, including values it overwrote for operations before it
+    void AsyncRadio::restoreStaged()
+    {
+        memcpy(m_staged, m_undoStaged, sizeof(m_staged));
+        memcpy(m_stagedBy, m_undoStagedBy, sizeof(m_stagedBy));
+        m_stagedMask = m_undoMask;
+    }
+
+    // Puts the staged writes on the bus, one burst per run of registers that need writing. A run may bridge up to
+    // kMaxWriteGap registers whose value is known (staged or in the shadow).
+    bool AsyncRadio::flushWrites()
+    {
+        bool bRet    = true;
+        int  address = 0;
+        byte status  = 0;
+        byte values[CC1101_CONFIG::kNumConfigRegisters];
+
+        auto isStaged   = [this](int i) { return (m_stagedMask & (1ull << i)) != 0; };
+        auto isKnown    = [this](int i) { return (m_known & (1ull << i)) != 0; };
+        auto needsWrite = [&](int i) { return isStaged(i) && !(isKnown(i) && m_shadow[i] == m_staged[i]); };
+
+        while (address < CC1101_CONFIG::kNumConfigRegisters)
+        {
+            if (!needsWrite(address))
+            {
+                if (isStaged(address))
+                {
+                    m_writesCoalesced++; // the chip already holds it
+                }
+                address++;
+                continue;
+            }
+            int last   = address;
+            int writes = 1;
+            for (int next = address + 1; next < CC1101_CONFIG::kNumConfigRegisters && next - last <= kMaxWriteGap + 1; next++)
+            {
+                if (!isStaged(next) && !isKnown(next))
+                {
+                    break;
+                }
+                if (needsWrite(next))
+                {
+                    last = next;
+                    writes++;
+                }
+            }
+            int runLength = last - address + 1;
+            for (int i = address; i <= last; i++)
+            {
+                values[i - address] = isStaged(i) ? m_staged[i] : m_shadow[i];
+                m_shadow[i]         = values[i - address];
+                m_known |= 1ull << i;
+            }
+            if (runLength == 1)
+            {
+                CBR(m_bus.WriteByteToAddress(address, values[0], status));
+            }
+            else
+            {
+                CBR(m_bus.WriteBytesToAddress(address | kBurstAccessBit, values, runLength, status));
+            }
+            trackStatus(status);
+            m_writesCoalesced += writes - 1;
+            address = last + 1;
+        }
+
+    Error:
+        if (!bRet)
+        {
+            // Whatever didn't make it is unknown now, and fails the operations that staged it
+            for (int i = address; i < CC1101_CONFIG::kNumConfigRegisters; i++)
+            {
+                if (isStaged(i))
+                {
+                    Op &owner = m_ops[m_stagedBy[i]];
+                    m_known &= ~(1ull << i);
+                    if (owner.Error == RadioError::None)
+                    {
+                        owner.Error = m_bus.LastError();
+                    }
+                }
+            }
+            ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+        }
+        // Nothing is staged any more, so a later failure has nothing to take back
+        m_stagedMask = 0;
+        m_undoMask   = 0;
+        return bRet;
+    }
+} // namespace TI_CC1101
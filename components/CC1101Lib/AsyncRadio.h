@@ -0,0 +1,191 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <atomic>
+#include "CC1101Lib.h"
+#include "RadioBus.h"
+#include "RadioResult.h"
+#if !defined(CC1101_HOST) && !defined(ARDUINO)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+namespace TI_CC1101
+{
+    enum class RadioOpStatus : byte
+    {
+        Pending, // queued or running
+        Done,
+        Failed, // a bus transaction failed
+        Gone    // the slot has been reused since, the result is no longer available
+    };
+
+    // Handle to a submitted operation. Cheap to copy; the generation tells a stale handle from a reused slot.
+    struct RadioFuture
+    {
+        int16_t  Slot       = -1;
+        uint16_t Generation = 0;
+
+        bool IsValid() const { return Slot >= 0; }
+    };
+
+    typedef void (*RadioOpCallback)(RadioFuture future, RadioOpStatus status, void *context);
+
+    // Non-blocking access to the radio. The control task describes an operation as a list of steps (register
+    // writes, bursts, strobes, reads, delays), submits it and gets a RadioFuture back straight away. A worker runs
+    // the operations against a RadioBus and completes the future, calling the continuation if one was given.
+    //
+    // - Everything queued when the worker wakes up runs as one batch. Register writes inside the batch are not put
+    //   on the bus one by one: they collect in a pending image and go out at the next barrier (strobe, read, delay,
+    //   FIFO/PATABLE access, end of batch), as bursts over runs of adjacent registers. Writes of a value the chip is
+    //   known to hold already are dropped. So independent Set-style operations submitted back to back share bus
+    //   transactions instead of each paying a header byte and a CS toggle per register.
+    // - Barriers keep their order relative to the writes around them, which is all the CC1101 needs (writes take
+    //   effect in IDLE; strobes and reads see everything written before them).
+    // - A failed operation takes back its writes that are still staged. If putting staged writes on the bus fails,
+    //   the operations whose writes didn't make it fail, not the one whose barrier triggered the flush.
+    // - The chip's register contents are only known after SeedShadow() (e.g. from CC1101Device::CaptureSnapshot())
+    //   or after this class wrote them. Until then every write goes out.
+    //
+    // On the ESP32, Start() runs the worker in its own task and Submit() wakes it. In host builds (and Arduino) there
+    // is no task: call RunPending() from the loop, which does the same thing. This class owns the bus while it has
+    // operations queued; blocking CC1101Device calls on the same SpiMaster have to wait until they are done.
+    // CC1101Device::BeginAsyncConfig()/SubmitAsyncConfig() run its Set* calls through here instead.
+    //
+    // One control task submits (single producer), one worker runs (single consumer). Continuations run on the
+    // worker, keep them short.
+    class AsyncRadio
+    {
+      public:
+        static const int kMaxOps          = 16;
+        static const int kMaxSteps        = 24;
+        static const int kMaxOpBytes      = 96; // write data and read results of one operation
+        static const int kWorkerStackSize = 3072;
+
+        AsyncRadio(RadioBus &bus) : m_bus(bus) {}
+
+        // Building an operation. Begin() returns an operation id, or -1 if all slots are still queued or running.
+        // The Add* calls return false when the operation is out of steps or bytes; Submit() then fails it.
+        int  Begin();
+        bool AddWrite(int op, byte address, byte value);
+        bool AddBurstWrite(int op, byte address, const byte *values, int length);
+        bool AddStrobe(int op, byte strobe);
+        bool AddRead(int op, byte address, int length); // results are appended to the operation's result bytes
+        bool AddDelay(int op, uint32_t delayMicros);
+        RadioFuture Submit(int op, RadioOpCallback callback = nullptr, void *context = nullptr);
+
+        // Common operations
+        RadioFuture Strobe(byte strobe, RadioOpCallback callback = nullptr, void *context = nullptr);
+        RadioFuture ReadStatus(byte address, RadioOpCallback callback = nullptr, void *context = nullptr);
+        RadioFuture DumpRegisters(RadioOpCallback callback = nullptr, void *context = nullptr); // config registers, then PATABLE
+        // A full register image such as RadioProfile::Registers/PATable. SIDLE, only the registers that differ, then
+        // SRX if enterReceive.
+        RadioFuture ApplyRegisters(const byte (&registers)[CC1101_CONFIG::kNumConfigRegisters], const byte (&patable)[8], bool enterReceive,
+                                   RadioOpCallback callback = nullptr, void *context = nullptr);
+
+        void SeedShadow(const byte (&registers)[CC1101_CONFIG::kNumConfigRegisters], const byte (&patable)[8]);
+
+        RadioOpStatus Status(RadioFuture future) const;
+        RadioError    Error(RadioFuture future) const; // why a Failed operation failed, None otherwise
+        // Copies the bytes read by a finished operation. Returns how many, or -1 if it isn't Done.
+        int           Result(RadioFuture future, byte *out, int maxLength) const;
+        // The chip status byte of the last transaction the worker made
+        byte          LastChipStatus() const { return m_lastChipStatus.load(std::memory_order_relaxed); }
+
+        // Runs everything submitted so far. The worker task's body; call it directly where there is no task.
+        void RunPending();
+#if !defined(CC1101_HOST) && !defined(ARDUINO)
+        bool Start(UBaseType_t taskPriority);
+#endif
+
+        uint32_t BatchesRun() const { return m_batches; }
+        uint32_t WritesCoalesced() const { return m_writesCoalesced; } // register writes that didn't need their own transaction
+
+      protected:
+        enum class StepKind : byte
+        {
+            Write, // single or burst, Length bytes at Offset
+            Strobe,
+            Read,
+            Delay
+        };
+        struct Step
+        {
+            StepKind Kind;
+            byte     Address;
+            byte     Length;
+            byte     Offset; // into Bytes
+            uint32_t DelayMicros;
+        };
+        enum SlotState : byte
+        {
+            Free,
+            Building,
+            Queued,
+            Finished // Done or Failed, results readable until the slot is reused
+        };
+        struct Op
+        {
+            std::atomic<byte> State{Free};
+            uint16_t          Generation = 0;
+            bool              Overflowed = false; // an Add* didn't fit
+            RadioError        Error      = RadioError::None;
+            int               StepCount  = 0;
+            int               ByteCount  = 0;
+            Step              Steps[kMaxSteps];
+            byte              Bytes[kMaxOpBytes];
+            RadioOpCallback   Callback = nullptr;
+            void             *Context  = nullptr;
+        };
+
+        bool addStep(int op, StepKind kind, byte address, int length, uint32_t delayMicros);
+        bool runStep(Op &op, const Step &step);
+        bool stageWrites(const Op &op, byte address, const byte *values, int length);
+        bool flushWrites();
+        bool flushBefore(const Op &op);
+        void saveStaged();
+        void restoreStaged();
+        void trackStatus(byte status) { m_lastChipStatus.store(status, std::memory_order_relaxed); }
+
+        RadioBus &m_bus;
+        Op        m_ops[kMaxOps];
+        int       m_nextSlot = 0; // where Begin() starts looking, so finished results survive as long as possible
+
+        // Slots in submission order, single producer (Submit) and single consumer (RunPending)
+        int                   m_queue[kMaxOps];
+        std::atomic<uint32_t> m_queueHead{0};
+        std::atomic<uint32_t> m_queueTail{0};
+
+        // Worker side. Known chip contents, and writes staged since the last barrier with the slot that staged each.
+        // The undo copy is the staging as it was when the running operation started (or at the last flush since).
+        byte              m_shadow[CC1101_CONFIG::kNumConfigRegisters];
+        byte              m_patableShadow[8];
+        uint64_t          m_known        = 0; // bit per config register
+        bool              m_patableKnown = false;
+        byte              m_staged[CC1101_CONFIG::kNumConfigRegisters];
+        int8_t            m_stagedBy[CC1101_CONFIG::kNumConfigRegisters];
+        uint64_t          m_stagedMask   = 0;
+        byte              m_undoStaged[CC1101_CONFIG::kNumConfigRegisters];
+        int8_t            m_undoStagedBy[CC1101_CONFIG::kNumConfigRegisters];
+        uint64_t          m_undoMask     = 0;
+        std::atomic<byte> m_lastChipStatus{0};
+        uint32_t          m_batches         = 0;
+        uint32_t          m_writesCoalesced = 0;
+#if !defined(CC1101_HOST) && !defined(ARDUINO)
+        static void               workerTask(void *context);
+        std::atomic<TaskHandle_t> m_worker{nullptr};
+#endif
+    };
+} // namespace TI_CC1101
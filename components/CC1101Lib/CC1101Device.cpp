@@ -14,6 +14,8 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <cmath>
+#include <algorithm>
+#include <cstring>
 #ifndef ARDUINO
 #include <driver/rtc_io.h>
 #include <format>
@@ -21,14 +23,52 @@
 #include "CC1101Device.h"
 #include "CC1101Lib.h"
 #include "SpiMaster.h"
+#include "CaptureStreamer.h"
 
 static const char *TAG = "CC1101Device";
 
+namespace
+{
+    using namespace TI_CC1101;
+    using GDx = ConfigValues::GDx_CFG_LowerSixBits;
+
+    // How each GdoRole is programmed into IOCFGx and which events its edges raise
+    struct GdoRoleInfo
+    {
+        GdoRole  Role;
+        GDx      Signal;
+        uint32_t RisingEvents;
+        uint32_t FallingEvents;
+    };
+    const GdoRoleInfo kGdoRoles[] = {
+        {GdoRole::Unused, GDx::HIGH_IMPEDANCE_3_STATE, 0, 0},
+        {GdoRole::SerialData, GDx::SERIAL_DATA_OUTPUT, 0, 0},
+        {GdoRole::SyncWordDetected, GDx::SYNC_WORD_OR_RX_PKT_DISCARDED_OR_TX_UNDERFLOW, GdoEvents::SyncWordDetected, GdoEvents::PacketEnd},
+        {GdoRole::PacketEnd, GDx::RX_FIFO_ABOVE_THRESHOLD, GdoEvents::PacketEnd, 0},
+        {GdoRole::CrcOk, GDx::CRC_OK_RECVD, GdoEvents::CrcOk, 0},
+        {GdoRole::ChannelClear, GDx::CLEAR_CHANNEL_ASSESSMENT, GdoEvents::ChannelClear, GdoEvents::ChannelBusy},
+        {GdoRole::CarrierSense, GDx::CARRIER_SENSE, GdoEvents::CarrierSensed, GdoEvents::CarrierLost},
+        {GdoRole::RxFifoThreshold, GDx::RX_FIFO_BELOW_THRESHOLD, GdoEvents::RxFifoThreshold, 0},
+        {GdoRole::TxFifoThreshold, GDx::TX_FIFO_BELOW_THRESHOLD, 0, GdoEvents::TxFifoBelowThreshold},
+        {GdoRole::PreambleQuality, GDx::PREAMBLE_QUALITY_REACHED, GdoEvents::PreambleQuality, 0},
+        {GdoRole::ChipReady, GDx::CHIP_RDY_N, 0, 0},
+    };
+    const GdoRoleInfo *findGdoRole(GdoRole role)
+    {
+        for (const GdoRoleInfo &info : kGdoRoles)
+        {
+            if (info.Role == role)
+            {
+                return &info;
+            }
+        }
+        return nullptr;
+    }
+} // namespace
+
 
 namespace TI_CC1101
 {
-    CC1101Device *CC1101Device::snm_thisPtr;
-
     void CC110DeviceConfig::DebugDump()
     {
 #if _DEBUG
@@ -41,6 +81,7 @@ namespace TI_CC1101
         ESP_LOGD(TAG, "\tReceiveFilterBandwidthKHz = " FLOAT_FMT, ReceiveFilterBandwidthKHz);
         ESP_LOGD(TAG, "\tFrequencyDeviationKhz = " FLOAT_FMT, FrequencyDeviationKhz);
         ESP_LOGD(TAG, "\tTxPower = %d ", TxPower);
+        ESP_LOGD(TAG, "\tPowerRamp = %d", (int)PowerRamp);
         ESP_LOGD(TAG, "\tModulationType = %d", (int)Modulation);
         ESP_LOGD(TAG, "\tManchesterEnabled = %s", ManchesterEnabled ? "true" : "false");
         ESP_LOGD(TAG, "\tPacketFormat = %d", (int)PacketFmt);
@@ -50,48 +91,198 @@ namespace TI_CC1101
         ESP_LOGD(TAG, "\tEnableCRCAutoflush = %s", EnableCRCAutoflush ? "true" : "false");
         ESP_LOGD(TAG, "\tSyncWordQualifierMode = %d", (int)SyncMode);
         ESP_LOGD(TAG, "\tAddressCheckConfiguration = %d", (int)AddressCheck);
+        ESP_LOGD(TAG, "\tSyncWord = " HEX_FMT, SyncWord);
+        ESP_LOGD(TAG, "\tPreambleLength = %d", (int)Preamble);
+        ESP_LOGD(TAG, "\tDeviceAddress = " HEX_FMT, DeviceAddress);
+        ESP_LOGD(TAG, "\tPreambleQualityThreshold = %d", PreambleQualityThreshold);
+        ESP_LOGD(TAG, "\tPacketLength = %d", PacketLength);
+        ESP_LOGD(TAG, "\tEnableWhitening = %s", EnableWhitening ? "true" : "false");
+        ESP_LOGD(TAG, "\tEnableFEC = %s", EnableFEC ? "true" : "false");
         ESP_LOGD(TAG, "\tEnableAppendStatusBytes = %s", EnableAppendStatusBytes ? "true" : "false");
+        ESP_LOGD(TAG, "\tUseWarmBootSnapshot = %s", UseWarmBootSnapshot ? "true" : "false");
+        ESP_LOGD(TAG, "\tGdoRoles = %d,%d,%d", (int)Gdo0Role, (int)Gdo1Role, (int)Gdo2Role);
+        ESP_LOGD(TAG, "\tClearChannelMode = %d", (int)ClearChannelMode);
+        ESP_LOGD(TAG, "\tCarrierSenseThresholdDb = %d", CarrierSenseThresholdDb);
 #endif
     }
+    // FNV-1a over the fields that end up in registers. Pins and UseWarmBootSnapshot don't affect the register image.
+    uint32_t CC110DeviceConfig::Hash() const
+    {
+        uint32_t hash  = 2166136261u;
+        auto     mixIn = [&hash](const void *data, size_t len) {
+            const byte *bytes = static_cast<const byte *>(data);
+            for (size_t i = 0; i < len; i++)
+            {
+                hash = (hash ^ bytes[i]) * 16777619u;
+            }
+        };
+        int enumValues[] = {(int)Modulation, (int)PacketFmt, (int)PacketLengthCfg, (int)SyncMode, (int)AddressCheck, (int)Gdo0Role, (int)Gdo1Role, (int)Gdo2Role, (int)ClearChannelMode, CarrierSenseThresholdDb,
+                            (int)PowerRamp, SyncWord, (int)Preamble, DeviceAddress, PreambleQualityThreshold, PacketLength};
+        bool flags[]     = {ManchesterEnabled, DisableDCFilter, EnableCRC, EnableCRCAutoflush, EnableAppendStatusBytes, EnableWhitening, EnableFEC};
+
+        mixIn(&OscillatorFrequencyMHz, sizeof(OscillatorFrequencyMHz));
+        mixIn(&CarrierFrequencyMHz, sizeof(CarrierFrequencyMHz));
+        mixIn(&ReceiveFilterBandwidthKHz, sizeof(ReceiveFilterBandwidthKHz));
+        mixIn(&FrequencyDeviationKhz, sizeof(FrequencyDeviationKhz));
+        mixIn(&TxPower, sizeof(TxPower));
+        mixIn(enumValues, sizeof(enumValues));
+        mixIn(flags, sizeof(flags));
+        return hash;
+    }
+    // Rejects the combinations the datasheet says don't work. Everything here would otherwise silently drop
+    // every packet, or pass packets the radio was supposed to filter.
+    bool CC110DeviceConfig::Validate() const
+    {
+        bool bRet          = true;
+        bool packetHandler = PacketFmt == PacketFormat::Normal;
+        // length byte in variable mode, and the two status bytes, share the FIFO with the payload
+        int  fifoBytes     = PacketLength + (PacketLengthCfg == PacketLengthConfig::Variable ? 1 : 0) + (EnableAppendStatusBytes ? 2 : 0);
+
+        if (PacketLengthCfg == PacketLengthConfig::Reserved)
+        {
+            ESP_LOGE(TAG, "reserved packet length config");
+            bRet = false;
+        }
+        if (Modulation == ModulationType::INVALID_2 || Modulation == ModulationType::INVALID_5 || Modulation == ModulationType::INVALID_6)
+        {
+            ESP_LOGE(TAG, "reserved modulation format %d", (int)Modulation);
+            bRet = false;
+        }
+        // pg 78, Manchester encoding is not supported at the same time as 4-FSK
+        if (ManchesterEnabled && Modulation == ModulationType::FSK_4)
+        {
+            ESP_LOGE(TAG, "Manchester encoding can't be used with 4-FSK");
+            bRet = false;
+        }
+        if (PreambleQualityThreshold > 7)
+        {
+            ESP_LOGE(TAG, "PQT %d out of range 0..7", PreambleQualityThreshold);
+            bRet = false;
+        }
+        // Address filtering, CRC, PQT, whitening and FEC are done by the packet handler, which is bypassed in the
+        // serial modes. Use PacketCodec on the raw bits there instead.
+        if (!packetHandler && (AddressCheck != AddressCheckConfiguration::None || EnableCRC || EnableCRCAutoflush || PreambleQualityThreshold != 0 || EnableWhitening || EnableFEC))
+        {
+            ESP_LOGE(TAG, "address check, CRC, PQT, whitening and FEC need PacketFormat::Normal");
+            bRet = false;
+        }
+        // pg 78, FEC is only supported in fixed packet length mode, and not together with Manchester encoding
+        if (EnableFEC && PacketLengthCfg != PacketLengthConfig::Fixed)
+        {
+            ESP_LOGE(TAG, "FEC needs fixed packet length");
+            bRet = false;
+        }
+        if (EnableFEC && ManchesterEnabled)
+        {
+            ESP_LOGE(TAG, "Manchester encoding can't be used with FEC");
+            bRet = false;
+        }
+        // pg 73, autoflush requires that only one packet is in the RX FIFO and that it fits
+        if (EnableCRCAutoflush)
+        {
+            if (!EnableCRC)
+            {
+                ESP_LOGE(TAG, "CRC autoflush without CRC");
+                bRet = false;
+            }
+            if (PacketLengthCfg == PacketLengthConfig::Infinite)
+            {
+                ESP_LOGE(TAG, "CRC autoflush can't be used with infinite packet length");
+                bRet = false;
+            }
+            if (fifoBytes > 64)
+            {
+                ESP_LOGE(TAG, "CRC autoflush needs the packet to fit in the RX FIFO, %d bytes", fifoBytes);
+                bRet = false;
+            }
+        }
+        if (PacketLengthCfg == PacketLengthConfig::Fixed && PacketLength == 0)
+        {
+            ESP_LOGE(TAG, "fixed packet length of 0");
+            bRet = false;
+        }
+        // pg 74, in variable length mode the address byte comes after the length byte, and PKTLEN caps the length.
+        // An address check with a maximum length of 0 can never match.
+        if (packetHandler && AddressCheck != AddressCheckConfiguration::None && PacketLengthCfg == PacketLengthConfig::Variable && PacketLength == 0)
+        {
+            ESP_LOGE(TAG, "address check with a maximum packet length of 0");
+            bRet = false;
+        }
+        return bRet;
+    }
     CC1101Device::CC1101Device()
     {
+        resetShadowRegisters();
     }
 
     CC1101Device::~CC1101Device()
     {
+        DetachGdoInterrupt(GdoPin::GDO0);
+        DetachGdoInterrupt(GdoPin::GDO1);
+        DetachGdoInterrupt(GdoPin::GDO2);
     }
 
-    bool CC1101Device::Init(std::shared_ptr<SpiMaster> &spiMaster, CC110DeviceConfig &deviceConfig)
+    Result<void> CC1101Device::Init(std::shared_ptr<SpiMaster> &spiMaster, CC110DeviceConfig &deviceConfig)
     {
-        bool bRet      = true;
+        bool       bRet        = true;
+        bool       warmBoot    = false;
+        byte       partNumber  = 0;
+        byte       chipVersion = 0;
+        RadioError error       = RadioError::None;
+
         m_spiMaster    = spiMaster;
         m_deviceConfig = deviceConfig;
+        m_pendingError = RadioError::None;
 
         m_deviceConfig.DebugDump();
+        if (!m_deviceConfig.Validate())
+        {
+            error = RadioError::InvalidConfig;
+            CBR(false);
+        }
         if (m_deviceConfig.OscillatorFrequencyMHz != 0)
         {
             m_oscillatorFrequencyHz = m_deviceConfig.OscillatorFrequencyMHz * 1'000'000;
         }
-        m_ISRQueueHandle = deviceConfig.InterruptQueue;
-
-        Reset();
-        regConfig();
-        configure();
+        warmBoot = m_deviceConfig.UseWarmBootSnapshot && tryWarmBoot();
+        if (!warmBoot)
+        {
+            Reset();
+            regConfig();
+            configure();
 
-        delayMilliseconds(1);
+            delayMilliseconds(1);
 
-        DumpRegisters();
+            DumpRegisters();
+        }
+        // What is in the chip now is the boot profile. Record it so SwitchProfile() can come back to it.
+        recordBootProfile();
 
-        byte partNumber  = readRegister(CC1101_CONFIG::PARTNUM);
-        byte chipVersion = readRegister(CC1101_CONFIG::VERSION);
+        partNumber  = readRegister(CC1101_CONFIG::PARTNUM);
+        chipVersion = readRegister(CC1101_CONFIG::VERSION);
 
         ESP_LOGI(TAG, "Part Number " HEX_FMT " and chip version " HEX_FMT, partNumber, chipVersion);
-        CBRA((partNumber == kPartNumber) && (chipVersion == kChipVersion));
+        // An SPI error while configuring explains a wrong part number better than the part number does
+        error = TakeError();
+        CBR(error == RadioError::None);
+        if ((partNumber != kPartNumber) || (chipVersion != kChipVersion))
+        {
+            error = RadioError::UnknownChip;
+            CBR(false);
+        }
 
-        snm_thisPtr = this;
+        if (m_deviceConfig.UseWarmBootSnapshot && !warmBoot)
+        {
+            SaveSnapshot();
+        }
 
     Error:
-        return bRet;
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed: %s", __PRETTY_FUNCTION__, RadioErrorName(error));
+            return error;
+        }
+        return {};
     }
 
     void CC1101Device::Reset()
@@ -105,88 +296,410 @@ namespace TI_CC1101
          * Issue the SRES strobe on the SI line.
          * When SO goes low again, reset is complete and the chip is in the IDLE state.
          */
-        bool bRet       = true;
-        byte statusCode = 0;
+        bool bRet             = true;
+        bool manualChipSelect = false;
+        byte statusCode       = 0;
+
+        resetShadowRegisters();
+        resetRxPacket();
+        m_PATABLEWrites++; // back to its reset value
 
         CERA(do_gpio_set_level(m_spiMaster->ClockPin(), 1));
         CERA(do_gpio_set_level(m_spiMaster->MosiPin(), 0));
 
-        // This is specific to the CC1101, so it does not go into SpiMaster
-        lowerChipSelect();
+        // This is specific to the CC1101, so it does not go into SpiMaster. It is also the only place CSn is
+        // driven by hand; everything else leaves it to the bus.
+        CBR(m_spiMaster->BeginManualChipSelect());
+        manualChipSelect = true;
+        m_spiMaster->lowerChipSelect();
         delayMicroseconds(1);
-        raiseChipSelect();
+        m_spiMaster->raiseChipSelect();
         delayMicroseconds(41);
-        lowerChipSelect();
+        m_spiMaster->lowerChipSelect();
         delayMicroseconds(1);
-        raiseChipSelect();
+        m_spiMaster->raiseChipSelect();
 
-        waitForMisoLow();
+        // SO only shows CHIP_RDYn while CSn is low
+        m_spiMaster->lowerChipSelect();
+        CBR(waitForMisoLow());
 
         // This is a command strobe so we only need the lower 6 bits, i.e, the address.
-        // See page 32, Section 10.4
+        // See page 32, Section 10.4. The bus raises CSn once the strobe is out.
         ESP_LOGI(TAG, "Sending reset");
-        CBRA(m_spiMaster->WriteByte(CC1101_CONFIG::SRES, statusCode));
+        if (!m_spiMaster->WriteByte(CC1101_CONFIG::SRES, statusCode))
+        {
+            recordError(m_spiMaster->LastError());
+            CBR(false);
+        }
 
-        waitForMisoLow();
-        raiseChipSelect();
+        m_spiMaster->lowerChipSelect();
+        CBR(waitForMisoLow());
+        // When SO goes low again the chip is in IDLE; the status byte from SRES is from before the reset
+        m_chipStatus.State = StatusByteStateMachineMode::IDLE;
 
     Error:
+        if (manualChipSelect)
+        {
+            m_spiMaster->raiseChipSelect();
+            if (!m_spiMaster->EndManualChipSelect())
+            {
+                recordError(m_spiMaster->LastError());
+                bRet = false;
+            }
+        }
         if (!bRet)
         {
             ESP_LOGW(TAG, "CC1101 reset failed"); // reset failed
         }
     }
-    bool CC1101Device::BeginReceive()
+    Result<void> CC1101Device::BeginReceive()
     {
-        bool          bRet    = true;
-#ifndef ARDUINO
-        gpio_config_t gpioConfig;
-
-        gpioConfig.intr_type    = GPIO_INTR_POSEDGE;
-        gpioConfig.pin_bit_mask = 1 << m_deviceConfig.RxPin;
-        gpioConfig.mode         = GPIO_MODE_INPUT;
-        gpioConfig.pull_up_en   = GPIO_PULLUP_DISABLE;
-        gpioConfig.pull_down_en = GPIO_PULLDOWN_DISABLE;
-
-        ESP_LOGD(TAG, "%s gpioconfig pin mask is " HEX_FMT, __FUNCTION__, (int)gpioConfig.pin_bit_mask);
-        CERA(gpio_config(&gpioConfig));
+        bool       bRet  = true;
+        RadioError error = RadioError::None;
 
-        CERA(gpio_install_isr_service(0));
+        // Update() is expected to run on the task that starts receiving
+        m_eventTask = xTaskGetCurrentTaskHandle();
+        m_edgeRing.SetConsumerTask(m_eventTask);
 
-        CERA(gpio_isr_handler_add(m_deviceConfig.RxPin, gpioISR, this));
-
-#else // ARDUINO
-        pinMode(m_deviceConfig.RxPin,INPUT);
-        attachInterrupt(digitalPinToInterrupt(m_deviceConfig.RxPin),gpioISR,CHANGE);
+        {
+            // GDO2 first, so that if both lines carry serial data the edges come from RxPin
+            bool edgesCaptured = false;
+            CBRA(attachGdoRoleInterrupt(GdoPin::GDO2, m_gdoRoles[(int)GdoPin::GDO2], edgesCaptured));
+            CBRA(attachGdoRoleInterrupt(GdoPin::GDO0, m_gdoRoles[(int)GdoPin::GDO0], edgesCaptured));
+        }
 
-#endif
         // Turn on the radio for receive
         enableReceiveMode();
+        error = TakeError();
+        CBR(error == RadioError::None);
+        m_lastHealthCheckMicros = micros();
+        m_lastActivityMicros    = m_lastHealthCheckMicros;
 
         //esp_intr_dump(NULL);
     Error:
         if (!bRet)
         {
-            ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+            ESP_LOGE(TAG, "%s failed: %s", __PRETTY_FUNCTION__, RadioErrorName(error));
+            // The GDO interrupts can't be set up. Not something a retry fixes.
+            return error == RadioError::None ? RadioError::InvalidConfig : error;
         }
-        return false;
+        return {};
     }
     void CC1101Device::Update()
     {
-        uint32_t ignore = 0;
+        PulseEdge  edges[32];
+        Pulse      pulses[32];
+        Pulse      filtered[32 + PulseFilter::kMaxHeldPulses + 2];
+        size_t     edgeCount      = 0;
+        size_t     pulseCount     = 0;
+        size_t     filteredCount  = 0;
+        uint32_t   startMicros    = 0;
+        uint32_t   filteredMicros = 0;
+        uint32_t   events         = 0;
+        bool       carrierSensed  = true;
+        RadioError health         = RadioError::None;
+
+        // The last status byte may already show an overflow, no need to wait for the watchdog to read MARCSTATE
+        if (m_chipStatus.State == StatusByteStateMachineMode::FIFOOverflowRX)
+        {
+            recordError(RadioError::RxFifoOverflow);
+        }
+        // Whatever went wrong during the last round (SPI error, RX FIFO overflow, ...) is dealt with before the next
+        if (m_pendingError != RadioError::None)
+        {
+            (void)Recover(TakeError());
+        }
+        if (m_healthIntervalMicros != 0 && !m_asyncTransmitting && micros() - m_lastHealthCheckMicros >= m_healthIntervalMicros)
+        {
+            m_lastHealthCheckMicros = micros();
+            health                  = CheckHealth();
+            if (health != RadioError::None)
+            {
+                (void)Recover(health);
+            }
+        }
+        if (m_captureStreamer != nullptr)
+        {
+            m_captureStreamer->KeepAlive();
+        }
+        if (!WaitForEvents(pdMS_TO_TICKS(100)))
+        {
+            return;
+        }
+        events = TakeEvents();
+        if (events & GdoEvents::SyncWordDetected)
+        {
+            ESP_LOGD(TAG, "sync word at %u us", (unsigned)LastSyncMicros());
+        }
+        if (events & GdoEvents::RxDataReady)
+        {
+            byte rxBytes = readRegister(CC1101_CONFIG::RXBYTES);
+            if ((rxBytes & kRxFifoByteCountMask) > 0)
+            {
+                m_lastActivityMicros = micros();
+            }
+            drainRxFifo(rxBytes);
+        }
+        if (m_pulseFilter != nullptr && m_pulseFilter->RequiresCarrierSense())
+        {
+            // A CarrierSense GDO catches carrier that came and went since the last Update(), PKTSTATUS.CS is now
+            carrierSensed = (events & GdoEvents::CarrierSensed) || (readRegister(CC1101_CONFIG::PKTSTATUS) & kPktStatusCarrierSense);
+        }
+        while ((edgeCount = m_edgeRing.PopBatch(edges)) > 0)
+        {
+            ESP_LOGD(TAG, "%d edges received, last at %u us, %u dropped so far", (int)edgeCount, (unsigned)edges[edgeCount - 1].TimestampMicros, (unsigned)m_edgeRing.Overflows());
+            m_lastActivityMicros = micros();
+            pulseCount = edgesToPulses(edges, edgeCount, pulses, startMicros);
+            if (pulseCount == 0)
+            {
+                continue;
+            }
+            if (m_pulseDecoders != nullptr && m_pulseFilter != nullptr)
+            {
+                filteredCount = m_pulseFilter->Filter(startMicros, std::span<const Pulse>(pulses, pulseCount), carrierSensed, filtered, filteredMicros);
+                if (filteredCount > 0)
+                {
+                    m_pulseDecoders->Feed(filteredMicros, std::span<const Pulse>(filtered, filteredCount));
+                }
+            }
+            else if (m_pulseDecoders != nullptr)
+            {
+                m_pulseDecoders->Feed(startMicros, std::span<const Pulse>(pulses, pulseCount));
+            }
+            if (m_captureStreamer != nullptr)
+            {
+                m_captureStreamer->AddPulses(startMicros, std::span<const Pulse>(pulses, pulseCount));
+            }
+        }
+    }
+    // Each edge ends the level the previous one started. The last edge is kept for the next batch.
+    size_t CC1101Device::edgesToPulses(const PulseEdge *edges, size_t edgeCount, Pulse *pulses, uint32_t &startMicros)
+    {
+        size_t pulseCount = 0;
+
+        for (size_t i = 0; i < edgeCount; i++)
+        {
+            if (m_haveEdge)
+            {
+                if (pulseCount == 0)
+                {
+                    startMicros = m_lastEdge.TimestampMicros;
+                }
+                pulses[pulseCount++] = {edges[i].TimestampMicros - m_lastEdge.TimestampMicros, m_lastEdge.Level};
+            }
+            m_lastEdge = edges[i];
+            m_haveEdge = true;
+        }
+        return pulseCount;
+    }
+    /// @brief Route interrupts from one GDO line to this device.
+    ///
+    /// Each GDO has its own handler context. On every edge the ISR ORs risingEvents or fallingEvents into the pending
+    /// mask (atomically, so events from different pins never overwrite each other) and wakes the task that called
+    /// BeginReceive() if the mask was empty. Events accumulate until TakeEvents().
+    /// @param captureEdges also record a timestamped PulseEdge per edge, for async serial data
+    bool CC1101Device::AttachGdoInterrupt(GdoPin gdo, gpio_num_t pin, uint32_t risingEvents, uint32_t fallingEvents, bool captureEdges)
+    {
+        bool                 bRet    = true;
+        GdoInterruptContext &context = m_gdoContexts[(int)gdo];
+
+        DetachGdoInterrupt(gdo);
+
+        context.Device        = this;
+        context.Pin           = pin;
+        context.RisingEvents  = risingEvents;
+        context.FallingEvents = fallingEvents;
+        context.CaptureEdges  = captureEdges;
+        context.EdgeCount     = 0;
 #ifndef ARDUINO
-        if (xQueueReceive(m_ISRQueueHandle, &ignore, pdTICKS_TO_MS(100)) == pdTRUE)
         {
-            ESP_LOGD(TAG, "interrupt received ");
-            //gpio level % d ", 0);//gpio_get_level(m_deviceConfig.RxPin));
+            gpio_config_t gpioConfig;
+            esp_err_t     ret;
+
+            gpioConfig.intr_type    = GPIO_INTR_ANYEDGE;
+            gpioConfig.pin_bit_mask = 1ULL << pin;
+            gpioConfig.mode         = GPIO_MODE_INPUT;
+            gpioConfig.pull_up_en   = GPIO_PULLUP_DISABLE;
+            gpioConfig.pull_down_en = GPIO_PULLDOWN_DISABLE;
+
+            ESP_LOGD(TAG, "%s GDO%d on pin %d, gpioconfig pin mask is " HEX_FMT, __FUNCTION__, (int)gdo, (int)pin, (int)gpioConfig.pin_bit_mask);
+            CERA(gpio_config(&gpioConfig));
+
+            // Shared by every device (and anyone else using GPIO interrupts), so it may already be installed
+            ret = gpio_install_isr_service(0);
+            CBRA(ret == ESP_OK || ret == ESP_ERR_INVALID_STATE);
+
+            CERA(gpio_isr_handler_add(pin, gdoISR, &context));
         }
 #else
-        if(m_dataReceived)
+        pinMode(pin, INPUT);
+        attachInterruptArg(digitalPinToInterrupt(pin), gdoISR, &context, CHANGE);
+#endif
+    Error:
+        if (!bRet)
+        {
+            context.Device = nullptr;
+            ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+        }
+        return bRet;
+    }
+    void CC1101Device::DetachGdoInterrupt(GdoPin gdo)
+    {
+        GdoInterruptContext &context = m_gdoContexts[(int)gdo];
+
+        if (context.Device == nullptr)
         {
-          Serial.printf("data recvd");
-          m_dataReceived = false;
+            return;
         }
+#ifndef ARDUINO
+        gpio_isr_handler_remove(context.Pin);
+#else
+        detachInterrupt(digitalPinToInterrupt(context.Pin));
 #endif
+        context.Device = nullptr;
+    }
+    /// @brief Program a GDO pin for a role and, if we are receiving, wire its interrupt.
+    ///
+    /// The role decides IOCFGx and which GdoEvents the pin's edges raise, so the task learns about sync words,
+    /// packet ends, CRC results or channel state from the interrupt alone, without polling status registers.
+    /// GDO1 doubles as SO, so it only gets the register setting, never an interrupt.
+    bool CC1101Device::SetGdoRole(GdoPin gdo, GdoRole role)
+    {
+        bool bRet          = true;
+        bool edgesCaptured = m_gdoContexts[(int)GdoPin::GDO0].CaptureEdges || m_gdoContexts[(int)GdoPin::GDO2].CaptureEdges;
+
+        switch (gdo)
+        {
+            case GdoPin::GDO0:
+                m_deviceConfig.Gdo0Role = role;
+                break;
+            case GdoPin::GDO1:
+                m_deviceConfig.Gdo1Role = role;
+                break;
+            case GdoPin::GDO2:
+                m_deviceConfig.Gdo2Role = role;
+                break;
+        }
+        role = resolveGdoRole(gdo);
+        writeGdoConfig(gdo, role);
+
+        if (m_eventTask != nullptr)
+        {
+            if (m_gdoContexts[(int)gdo].CaptureEdges)
+            {
+                edgesCaptured = false;
+            }
+            CBRA(attachGdoRoleInterrupt(gdo, role, edgesCaptured));
+        }
+    Error:
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+        }
+        return bRet;
+    }
+    GdoRole CC1101Device::resolveGdoRole(GdoPin gdo)
+    {
+        GdoRole configured = (gdo == GdoPin::GDO0) ? m_deviceConfig.Gdo0Role : (gdo == GdoPin::GDO1) ? m_deviceConfig.Gdo1Role : m_deviceConfig.Gdo2Role;
+
+        if (configured != GdoRole::Auto)
+        {
+            return configured;
+        }
+        switch (gdo)
+        {
+            case GdoPin::GDO0:
+                return (m_deviceConfig.PacketFmt == PacketFormat::AsyncSerialMode) ? GdoRole::SerialData : GdoRole::PacketEnd;
+            case GdoPin::GDO2:
+                return (m_deviceConfig.PacketFmt == PacketFormat::AsyncSerialMode) ? GdoRole::SerialData : GdoRole::ChipReady;
+            case GdoPin::GDO1:
+            default:
+                return GdoRole::Unused;
+        }
+    }
+    gpio_num_t CC1101Device::gdoPinNumber(GdoPin gdo)
+    {
+        switch (gdo)
+        {
+            case GdoPin::GDO0:
+                return m_deviceConfig.TxPin;
+            case GdoPin::GDO2:
+                return m_deviceConfig.RxPin;
+            case GdoPin::GDO1:
+            default:
+                return (gpio_num_t)-1;
+        }
+    }
+    // IOCFG2, IOCFG1 and IOCFG0 are at addresses 0, 1 and 2
+    void CC1101Device::writeGdoConfig(GdoPin gdo, GdoRole role)
+    {
+        const GdoRoleInfo *info    = findGdoRole(role);
+        byte               address = (byte)(CC1101_CONFIG::IOCFG0 - (int)gdo);
+
+        if (!m_compilingProfile)
+        {
+            m_gdoRoles[(int)gdo] = role;
+        }
+        if (info == nullptr)
+        {
+            return;
+        }
+        ESP_LOGD(TAG, "%s GDO%d -> role %d, IOCFG " HEX_FMT, __FUNCTION__, (int)gdo, (int)role, (int)info->Signal);
+        (void)writeRegister(address, (byte)info->Signal);
+    }
+    bool CC1101Device::attachGdoRoleInterrupt(GdoPin gdo, GdoRole role, bool &edgesCaptured)
+    {
+        const GdoRoleInfo *info         = findGdoRole(role);
+        bool               captureEdges = (role == GdoRole::SerialData) && !edgesCaptured;
+
+        if (gdo == GdoPin::GDO1 || info == nullptr || (info->RisingEvents == 0 && info->FallingEvents == 0 && !captureEdges))
+        {
+            DetachGdoInterrupt(gdo);
+            return true;
+        }
+        edgesCaptured = edgesCaptured || captureEdges;
+        return AttachGdoInterrupt(gdo, gdoPinNumber(gdo), info->RisingEvents, info->FallingEvents, captureEdges);
+    }
+    // After the registers changed underneath us (profile switch, snapshot restore), bring the roles and, if we are
+    // receiving, the interrupts in line with the new config. Pins whose role did not change are left alone.
+    bool CC1101Device::refreshGdoRoles()
+    {
+        bool   bRet          = true;
+        bool   edgesCaptured = false;
+        GdoPin order[]       = {GdoPin::GDO2, GdoPin::GDO0, GdoPin::GDO1};
+
+        for (GdoPin gdo : order)
+        {
+            GdoRole role    = resolveGdoRole(gdo);
+            bool    changed = (role != m_gdoRoles[(int)gdo]);
+
+            m_gdoRoles[(int)gdo] = role;
+            if (m_eventTask == nullptr)
+            {
+                continue;
+            }
+            if (changed)
+            {
+                CBRA(attachGdoRoleInterrupt(gdo, role, edgesCaptured));
+            }
+            else
+            {
+                edgesCaptured = edgesCaptured || m_gdoContexts[(int)gdo].CaptureEdges;
+            }
+        }
+    Error:
+        return bRet;
+    }
+    /// @brief Block until a GDO event or a captured edge is pending, or the timeout expires.
+    bool CC1101Device::WaitForEvents(TickType_t timeoutTicks)
+    {
+        if (m_pendingEvents.load(std::memory_order_acquire) != 0 || !m_edgeRing.Empty())
+        {
+            return true;
+        }
+        // Both the ISR and the edge ring give the same task notification
+        ulTaskNotifyTake(pdTRUE, timeoutTicks);
+        return m_pendingEvents.load(std::memory_order_acquire) != 0 || !m_edgeRing.Empty();
     }
     // Page 75 of TI Datasheet
     // Frequency is a 24-bit word set via FREQ0,FREQ1 and FREQ2 registers
@@ -200,7 +713,6 @@ namespace TI_CC1101
     //
     void CC1101Device::SetFrequencyMHz(float frequencyMHz)
     {
-        byte statusCode = 0;
         float frequencyIncrement = m_oscillatorFrequencyHz / (float)kFrequencyDivisor;
 
         if (frequencyMHz < 300)
@@ -220,12 +732,9 @@ namespace TI_CC1101
         ESP_LOGD(TAG, "SetFrequency() -> freq0=" HEX_FMT ", freq1=" HEX_FMT ", freq2 = " HEX_FMT ", increment= " FLOAT_FMT ", result = " FLOAT_FMT ", expected" FLOAT_FMT " MHz", freq0, freq1, freq2, frequencyIncrement,
                  frequencyIncrement * (float)(((int)freq2 << 16) | ((int)freq1 << 8) | (int)freq0), frequencyMHz);
 
-        statusCode = writeRegister(CC1101_CONFIG::FREQ0, freq0);
-        handleCommonStatusCodes(statusCode, false);
-        statusCode = writeRegister(CC1101_CONFIG::FREQ1, freq1);
-        handleCommonStatusCodes(statusCode, false);
-        statusCode = writeRegister(CC1101_CONFIG::FREQ2, freq2);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::FREQ0, freq0);
+        (void)writeRegister(CC1101_CONFIG::FREQ1, freq1);
+        (void)writeRegister(CC1101_CONFIG::FREQ2, freq2);
 
         m_carrierFrequencyMHz = frequencyMHz;
         ESP_LOGI(TAG, "m_carrierFrequencyMHz is now " FLOAT_FMT, m_carrierFrequencyMHz);
@@ -244,7 +753,6 @@ namespace TI_CC1101
     //
     void CC1101Device::SetReceiveChannelFilterBandwidth(float bandwidthKHz)
     {
-        byte statusCode = 0;
         byte modemCFG   = readRegister(CC1101_CONFIG::MDMCFG4);
         byte DataRate   = (byte)(modemCFG & 0x0F);
 
@@ -294,15 +802,13 @@ namespace TI_CC1101
         byte result = (byte)(((Exponent << 2 | Mantissa) << 4) | DataRate);
 
         ESP_LOGI(TAG, "%s:  input bw " FLOAT_FMT ", datarate " HEX_FMT " setting result=" HEX_FMT ", Mantissa=" HEX_FMT ",Exponent=" HEX_FMT , __FUNCTION__, bandwidthKHz, DataRate, result, Mantissa, Exponent);
-        statusCode = writeRegister(CC1101_CONFIG::MDMCFG4, result);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG4, result);
     }
     /// @brief Set the DataRate Exponent in MDMCFG4 and Mantissa in MDMCFG3
     /// @param Exponent
     /// @param Mantissa
     void CC1101Device::SetDataRate(byte Exponent, byte Mantissa)
     {
-        byte statusCode = 0;
         byte modem4CFG  = readRegister(CC1101_CONFIG::MDMCFG4);
 
         byte result = ((modem4CFG & ~0x0F) | Exponent);
@@ -310,11 +816,9 @@ namespace TI_CC1101
         ESP_LOGD(TAG, "%s: DataRate expected -> " FLOAT_FMT, __FUNCTION__, (float)(256 + Mantissa) * (1 << Exponent) / (float)(1 << 28) * m_oscillatorFrequencyHz);
 
         ESP_LOGD(TAG, "%s: Writing to MDMCFG4 -> " HEX_FMT, __FUNCTION__, result);
-        statusCode = writeRegister(CC1101_CONFIG::MDMCFG4, result);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG4, result);
         ESP_LOGD(TAG, "%s: Writing to MDMCFG3 -> " HEX_FMT, __FUNCTION__, Mantissa);
-        statusCode = writeRegister(CC1101_CONFIG::MDMCFG3, Mantissa);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG3, Mantissa);
     }
     /// <summary>
     /// Sets modem deviation allowed, per page 79 of TI Datasheet
@@ -332,7 +836,6 @@ namespace TI_CC1101
     // Bit 0-2 are Mantissa
     void CC1101Device::SetModemDeviation(float deviationKHz)
     {
-        byte statusCode = 0;
         // TODO this function seems broken. debug it
 
         float constantPart            = m_oscillatorFrequencyHz / (1 << 17);
@@ -427,8 +930,7 @@ namespace TI_CC1101
         }
         byte result = (byte)(Exponent << 4 | Mantissa);
         ESP_LOGD(TAG, "%s: setting result=" HEX_FMT ", Mantissa=" HEX_FMT ",Exponent=" HEX_FMT , __FUNCTION__, result, Mantissa, Exponent);
-        statusCode = writeRegister(CC1101_CONFIG::DEVIATN, result);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::DEVIATN, result);
     }
     /// <summary>
     /// Set output power level
@@ -438,54 +940,30 @@ namespace TI_CC1101
     // Page 59 of TI Datasheet
     void CC1101Device::SetOutputPower(int outputPower)
     {
-        byte        paSetting;
-        const byte *currentTable = nullptr;
-
         // Page of datasheet indicates that the operational frequency bands are 300-348,387-464 and 779-928
         if (m_carrierFrequencyMHz <= 348)
         {
-            currentTable     = ConfigValues::PATABLE_315_SETTINGS;
-            paSetting        = getMultiLayerInductorPower(outputPower, currentTable, ARRAYSIZE(ConfigValues::PATABLE_315_SETTINGS));
             m_currentPATable = PATables::PA_315;
-            ESP_LOGD(TAG, "%s: patable is 315 for freq " FLOAT_FMT "; setting is " HEX_FMT, __FUNCTION__, m_carrierFrequencyMHz, paSetting);
+            fillPATable(ConfigValues::PATABLE_315_SETTINGS, outputPower);
         }
         else if (m_carrierFrequencyMHz <= 464)
         {
-            currentTable     = ConfigValues::PATABLE_433_SETTINGS;
-            paSetting        = getMultiLayerInductorPower(outputPower, currentTable, ARRAYSIZE(ConfigValues::PATABLE_433_SETTINGS));
             m_currentPATable = PATables::PA_433;
-            ESP_LOGD(TAG, "%s: patable is 433 for freq " FLOAT_FMT "; setting is " HEX_FMT, __FUNCTION__, m_carrierFrequencyMHz, paSetting);
+            fillPATable(ConfigValues::PATABLE_433_SETTINGS, outputPower);
         }
         // I'm not sure what to do about 868, so this is all a bit adhoc over 464 MHz. I suppose it depends on your
         // chip.
         else if (m_carrierFrequencyMHz <= 880)
         {
-            currentTable     = ConfigValues::PATABLE_868_SETTINGS;
-            paSetting        = getWireWoundInductorPower(outputPower, currentTable, ARRAYSIZE(ConfigValues::PATABLE_868_SETTINGS));
             m_currentPATable = PATables::PA_868;
-            ESP_LOGD(TAG, "%s: patable is 868 for freq " FLOAT_FMT "; setting is " HEX_FMT, __FUNCTION__, m_carrierFrequencyMHz, paSetting);
+            fillPATable(ConfigValues::PATABLE_868_SETTINGS, outputPower);
         }
         else
         {
-            currentTable     = ConfigValues::PATABLE_915_SETTINGS;
-            paSetting        = getWireWoundInductorPower(outputPower, currentTable, ARRAYSIZE(ConfigValues::PATABLE_915_SETTINGS));
             m_currentPATable = PATables::PA_915;
-            ESP_LOGD(TAG, "%s: patable is 915 for freq " FLOAT_FMT "; setting is " HEX_FMT, __FUNCTION__, m_carrierFrequencyMHz, paSetting);
-        }
-
-        // ASK always uses index 0 PATABLE to transmit a 0;
-        if (m_deviceConfig.Modulation == ModulationType::ASK_OOK)
-        {
-            m_PATABLE[0] = 0;
-            m_PATABLE[1] = paSetting;
-            ESP_LOGD(TAG, "Modulation is ASK_OOK, patable should have " HEX_FMT " in index 1", paSetting);
-        }
-        else
-        {
-            m_PATABLE[0] = paSetting;
-            m_PATABLE[1] = 0;
-            ESP_LOGD(TAG, "Modulation is *not* ASK_OOK, patable should have " HEX_FMT " in index 0", paSetting);
+            fillPATable(ConfigValues::PATABLE_915_SETTINGS, outputPower);
         }
+        ESP_LOGD(TAG, "%s: patable %d for freq " FLOAT_FMT "; ramp %d", __FUNCTION__, (int)m_currentPATable, m_carrierFrequencyMHz, (int)m_deviceConfig.PowerRamp);
 #if _DEBUG
         {
             byte patables[8];
@@ -522,6 +1000,17 @@ namespace TI_CC1101
         }
 #endif
     }
+    /// @brief Switches PA shaping on or off. Rewrites PATABLE and FREND0.PA_POWER for the current output power.
+    void CC1101Device::SetPowerRamp(PaRampShape shape)
+    {
+        byte frend0;
+
+        m_deviceConfig.PowerRamp = shape;
+        SetOutputPower(m_deviceConfig.TxPower);
+
+        frend0     = (byte)((readRegister(CC1101_CONFIG::FREND0) & 0b11111000) | paPowerIndex(m_deviceConfig.Modulation));
+        (void)writeRegister(CC1101_CONFIG::FREND0, frend0);
+    }
     //
     //  Page 77,89 of TI Datasheet
     //
@@ -529,15 +1018,13 @@ namespace TI_CC1101
     //
     void CC1101Device::SetModulation(ModulationType modulationType)
     {
-        byte statusCode     = 0;
         byte currentMDMCFG2 = readRegister(CC1101_CONFIG::MDMCFG2);
         byte currentFREND0  = readRegister(CC1101_CONFIG::FREND0);
 
         byte frend0, mdmcfg2 = currentMDMCFG2;
 
-        // default to non-ASK_OOK, i.e, PATABLE[0] contains our only power level
-        // For ASK_OOK we point to PATABLE[1], because ASK always uses PATABLE[0] for transmitting '0'
-        frend0 = (byte)(currentFREND0 & 0b11110000); // clear the PA_POWER bits (pg 89)
+        // PA_POWER is the PATABLE index used for a '1' (pg 89), see paPowerIndex()
+        frend0 = (byte)((currentFREND0 & 0b11111000) | paPowerIndex(modulationType));
 
         currentMDMCFG2 = (currentMDMCFG2 & ~0b01110000); // clear modulation bits
         switch (modulationType)
@@ -549,7 +1036,6 @@ namespace TI_CC1101
                 mdmcfg2 = (byte)(currentMDMCFG2 | 0b00010000); // 1 in bits 4-6
                 break;
             case ModulationType::ASK_OOK:
-                frend0  = (byte)(frend0 | 0b00000001);         // 1 in the low nibble
                 mdmcfg2 = (byte)(currentMDMCFG2 | 0b00110000); // 011 in bits 4-6
                 break;
             case ModulationType::FSK_4:
@@ -567,12 +1053,10 @@ namespace TI_CC1101
         }
 
         ESP_LOGD(TAG, "%s Setting MDMCFG2 " HEX_FMT, __FUNCTION__, mdmcfg2);
-        statusCode = writeRegister(CC1101_CONFIG::MDMCFG2, mdmcfg2);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG2, mdmcfg2);
 
         ESP_LOGD(TAG, "%s Setting FREND0 " HEX_FMT, __FUNCTION__, frend0);
-        statusCode = writeRegister(CC1101_CONFIG::FREND0, frend0);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::FREND0, frend0);
     }
     /// <summary>
     /// Sets or unsets Manchester encoding (Pg 77) in register MDMCFG2
@@ -580,7 +1064,6 @@ namespace TI_CC1101
     /// <param name="shouldEnable"></param>
     void CC1101Device::SetManchesterEncoding(bool shouldEnable)
     {
-        byte statusCode     = 0;
         byte currentMDMCFG2 = readRegister(CC1101_CONFIG::MDMCFG2);
         byte result         = (byte)(currentMDMCFG2 & 0b11110111);
 
@@ -594,15 +1077,13 @@ namespace TI_CC1101
         }
 
         ESP_LOGD(TAG, "%s Setting MDMCFG2 " HEX_FMT, __FUNCTION__, result);
-        statusCode = writeRegister(CC1101_CONFIG::MDMCFG2, result);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG2, result);
     }
     /// <summary>
     /// Disable Digital DC blocking filter (Pg 77) in register MDMCFG2
     /// </summary>
     void CC1101Device::SetDigitalDCFilter(bool shouldDisable)
     {
-        byte statusCode     = 0;
         byte currentMdmcfg2 = readRegister(CC1101_CONFIG::MDMCFG2);
 
         currentMdmcfg2 = (currentMdmcfg2 & 0b01111111);
@@ -610,8 +1091,7 @@ namespace TI_CC1101
         byte setting = (shouldDisable ? 0b10000000 : 0b00000000);
 
         ESP_LOGD(TAG, "%s Setting MDMCFG2 " HEX_FMT, __FUNCTION__, (byte)(currentMdmcfg2 | setting));
-        statusCode = writeRegister(CC1101_CONFIG::MDMCFG2, (byte)(currentMdmcfg2 | setting));
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG2, (byte)(currentMdmcfg2 | setting));
     }
     /// <summary>
     /// Sets Sync Mode according to Page 77 in register MDMCFG2
@@ -626,13 +1106,11 @@ namespace TI_CC1101
     /// </summary>
     void CC1101Device::SetSyncMode(SyncWordQualifierMode syncMode)
     {
-        byte statusCode     = 0;
         byte currentMdmcfg2 = readRegister(CC1101_CONFIG::MDMCFG2);
         byte result         = (byte)((currentMdmcfg2 & 0b11111000) | (int)syncMode);
 
         ESP_LOGD(TAG, "%s Setting MDMCFG2 " HEX_FMT, __FUNCTION__, result);
-        statusCode = writeRegister(CC1101_CONFIG::MDMCFG2, result);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG2, result);
     }
     /// <summary>
     /// Set Packet Format (Pg 74) in register PKTCTRL0
@@ -640,7 +1118,6 @@ namespace TI_CC1101
     /// <param name="packetFormat"></param>
     void CC1101Device::SetPacketFormat(PacketFormat packetFormat)
     {
-        byte statusCode      = 0;
         byte currentPktCtrl0 = readRegister(CC1101_CONFIG::PKTCTRL0);
 
         byte result = (byte)(currentPktCtrl0 & 0b11001111);
@@ -659,8 +1136,7 @@ namespace TI_CC1101
                 break;
         }
         ESP_LOGD(TAG, "%s Setting PKTCTRL0 " HEX_FMT, __FUNCTION__, result);
-        statusCode = writeRegister(CC1101_CONFIG::PKTCTRL0, result);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::PKTCTRL0, result);
     }
     /// <summary>
     /// Set CRC for data (Pg 74) in register PKTCTRL0
@@ -668,7 +1144,6 @@ namespace TI_CC1101
     /// <param name="shouldEnable"></param>
     void CC1101Device::SetCRC(bool shouldEnable)
     {
-        byte statusCode      = 0;
         byte currentPktCtrl0 = readRegister(CC1101_CONFIG::PKTCTRL0);
 
         byte result = (byte)(currentPktCtrl0 & 0b11111011);
@@ -677,8 +1152,7 @@ namespace TI_CC1101
             result |= 0b00000100;
         }
         ESP_LOGD(TAG, "%s Setting PKTCTRL0 " HEX_FMT, __FUNCTION__, result);
-        statusCode = writeRegister(CC1101_CONFIG::PKTCTRL0, result);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::PKTCTRL0, result);
     }
     /// <summary>
     /// Set CRC Autoflush (Pg 73) in register PKTCTRL1
@@ -688,7 +1162,6 @@ namespace TI_CC1101
     /// <param name="shouldEnable"></param>
     void CC1101Device::SetCRCAutoFlush(bool shouldEnable)
     {
-        byte statusCode      = 0;
         byte currentPktCtrl1 = readRegister(CC1101_CONFIG::PKTCTRL1);
         currentPktCtrl1      = (byte)(currentPktCtrl1 & 0b11110111);
         if (shouldEnable)
@@ -696,8 +1169,7 @@ namespace TI_CC1101
             currentPktCtrl1 |= 0b00001000;
         }
         ESP_LOGD(TAG, "%s Setting PKTCTRL1" HEX_FMT, __FUNCTION__, currentPktCtrl1);
-        statusCode = writeRegister(CC1101_CONFIG::PKTCTRL1, currentPktCtrl1);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::PKTCTRL1, currentPktCtrl1);
     }
     /// <summary>
     /// Set Address Check (Pg 73) in register PKTCTRL1
@@ -705,63 +1177,349 @@ namespace TI_CC1101
     /// <param name="addressCheckConfig"></param>
     void CC1101Device::SetAddressCheck(AddressCheckConfiguration addressCheckConfig)
     {
-        byte statusCode      = 0;
         byte currentPktCtrl1 = readRegister(CC1101_CONFIG::PKTCTRL1);
         currentPktCtrl1      = (byte)((currentPktCtrl1 & 0b11111100) | (int)addressCheckConfig);
 
         ESP_LOGD(TAG, "%s Setting PKTCTRL1 " HEX_FMT, __FUNCTION__, currentPktCtrl1);
-        statusCode = writeRegister(CC1101_CONFIG::PKTCTRL1, currentPktCtrl1);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::PKTCTRL1, currentPktCtrl1);
     }
 
     /// @brief When enabled, two status bytes will be appended to the payload of the packet. The status bytes contain RSSI and LQI values, as well as CRC OK.
     /// @param shouldEnable
     void CC1101Device::SetAppendStatus(bool shouldEnable)
     {
-        byte statusCode      = 0;
         byte currentPktCtrl1 = readRegister(CC1101_CONFIG::PKTCTRL1);
         byte result          = (byte)((currentPktCtrl1 & 0b11111011) | (shouldEnable ? 0b100 : 0b000));
 
         ESP_LOGD(TAG, "%s Setting PKTCTRL1 " HEX_FMT, __FUNCTION__, result);
-        statusCode = writeRegister(CC1101_CONFIG::PKTCTRL1, result);
-        handleCommonStatusCodes(statusCode, false);
+        (void)writeRegister(CC1101_CONFIG::PKTCTRL1, result);
     }
 
-    // Dumps in SmartRF Studio order so we can compare
-    void CC1101Device::DumpRegisters()
+    /// @brief Set the 16-bit sync word (Pg 76) in registers SYNC1 and SYNC0. Repeated for the 30/32 sync modes.
+    void CC1101Device::SetSyncWord(uint16_t syncWord)
     {
-#if _DEBUG
-        ESP_LOGD(TAG, "IOCFG2:              " HEX_FMT, readRegister(CC1101_CONFIG::IOCFG2));
-        ESP_LOGD(TAG, "IOCFG1:              " HEX_FMT, readRegister(CC1101_CONFIG::IOCFG1));
-        ESP_LOGD(TAG, "IOCFG0:              " HEX_FMT, readRegister(CC1101_CONFIG::IOCFG0));
-        ESP_LOGD(TAG, "FIFOTHR:             " HEX_FMT, readRegister(CC1101_CONFIG::FIFOTHR));
-        ESP_LOGD(TAG, "SYNC1:               " HEX_FMT, readRegister(CC1101_CONFIG::SYNC1));
-        ESP_LOGD(TAG, "SYNC0:               " HEX_FMT, readRegister(CC1101_CONFIG::SYNC0));
-        ESP_LOGD(TAG, "PKTLEN:              " HEX_FMT, readRegister(CC1101_CONFIG::PKTLEN));
-        ESP_LOGD(TAG, "PKTCTRL1:            " HEX_FMT, readRegister(CC1101_CONFIG::PKTCTRL1));
-        ESP_LOGD(TAG, "PKTCTRL0:            " HEX_FMT, readRegister(CC1101_CONFIG::PKTCTRL0));
-        ESP_LOGD(TAG, "ADDR:                " HEX_FMT, readRegister(CC1101_CONFIG::ADDR));
-        ESP_LOGD(TAG, "CHANNR:              " HEX_FMT, readRegister(CC1101_CONFIG::CHANNR));
-        ESP_LOGD(TAG, "FSCTRL1              " HEX_FMT, readRegister(CC1101_CONFIG::FSCTRL1));
-        ESP_LOGD(TAG, "FSCTRL0:             " HEX_FMT, readRegister(CC1101_CONFIG::FSCTRL0));
-        ESP_LOGD(TAG, "FREQ2:               " HEX_FMT, readRegister(CC1101_CONFIG::FREQ2));
-        ESP_LOGD(TAG, "FREQ1:               " HEX_FMT, readRegister(CC1101_CONFIG::FREQ1));
-        ESP_LOGD(TAG, "FREQ0:               " HEX_FMT, readRegister(CC1101_CONFIG::FREQ0));
-        ESP_LOGD(TAG, "MDMCFG4:             " HEX_FMT, readRegister(CC1101_CONFIG::MDMCFG4));
-        ESP_LOGD(TAG, "MDMCFG3:             " HEX_FMT, readRegister(CC1101_CONFIG::MDMCFG3));
-        ESP_LOGD(TAG, "MDMCFG2:             " HEX_FMT, readRegister(CC1101_CONFIG::MDMCFG2));
-        ESP_LOGD(TAG, "MDMCFG1:             " HEX_FMT, readRegister(CC1101_CONFIG::MDMCFG1));
-        ESP_LOGD(TAG, "MDMCFG0:             " HEX_FMT, readRegister(CC1101_CONFIG::MDMCFG0));
-        ESP_LOGD(TAG, "DEVIATN:             " HEX_FMT, readRegister(CC1101_CONFIG::DEVIATN));
-        ESP_LOGD(TAG, "MCSM2:               " HEX_FMT, readRegister(CC1101_CONFIG::MCSM2));
-        ESP_LOGD(TAG, "MCSM1:               " HEX_FMT, readRegister(CC1101_CONFIG::MCSM1));
-        ESP_LOGD(TAG, "MCSM0:               " HEX_FMT, readRegister(CC1101_CONFIG::MCSM0));
-        ESP_LOGD(TAG, "FOCCFG:              " HEX_FMT, readRegister(CC1101_CONFIG::FOCCFG));
-        ESP_LOGD(TAG, "BSCFG:               " HEX_FMT, readRegister(CC1101_CONFIG::BSCFG));
-        ESP_LOGD(TAG, "AGCCTRL2:            " HEX_FMT, readRegister(CC1101_CONFIG::AGCCTRL2));
-        ESP_LOGD(TAG, "AGCCTRL1:            " HEX_FMT, readRegister(CC1101_CONFIG::AGCCTRL1));
-        ESP_LOGD(TAG, "AGCCTRL0:            " HEX_FMT, readRegister(CC1101_CONFIG::AGCCTRL0));
-        ESP_LOGD(TAG, "WOREVT1:             " HEX_FMT, readRegister(CC1101_CONFIG::WOREVT1));
+
+        ESP_LOGD(TAG, "%s Setting SYNC1:SYNC0 " HEX_FMT, __FUNCTION__, syncWord);
+        (void)writeRegister(CC1101_CONFIG::SYNC1, (byte)(syncWord >> 8));
+        (void)writeRegister(CC1101_CONFIG::SYNC0, (byte)(syncWord & 0xFF));
+    }
+    /// @brief Set the minimum number of preamble bytes to transmit (Pg 78) in register MDMCFG1. Leaves CHANSPC_E alone.
+    void CC1101Device::SetPreambleLength(PreambleLength preambleLength)
+    {
+        byte currentMdmcfg1 = readRegister(CC1101_CONFIG::MDMCFG1);
+        byte result         = (byte)((currentMdmcfg1 & 0b10001111) | ((byte)preambleLength << 4));
+
+        ESP_LOGD(TAG, "%s Setting MDMCFG1 " HEX_FMT, __FUNCTION__, result);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG1, result);
+    }
+    /// @brief Set the device address (Pg 74) in register ADDR. Only used when address check is enabled.
+    void CC1101Device::SetDeviceAddress(byte address)
+    {
+
+        ESP_LOGD(TAG, "%s Setting ADDR " HEX_FMT, __FUNCTION__, address);
+        (void)writeRegister(CC1101_CONFIG::ADDR, address);
+    }
+    /// @brief Set the preamble quality estimator threshold (Pg 73) in register PKTCTRL1. A sync word is only
+    /// accepted once PQI >= 4 * threshold, which keeps noise from starting packet reception. 0 disables the check.
+    void CC1101Device::SetPreambleQualityThreshold(byte threshold)
+    {
+        byte currentPktCtrl1 = readRegister(CC1101_CONFIG::PKTCTRL1);
+        byte result          = (byte)((currentPktCtrl1 & 0b00011111) | ((threshold & 0x07) << 5));
+
+        ESP_LOGD(TAG, "%s Setting PKTCTRL1 " HEX_FMT, __FUNCTION__, result);
+        (void)writeRegister(CC1101_CONFIG::PKTCTRL1, result);
+    }
+    /// @brief Turn PN9 data whitening (Pg 74) on or off in register PKTCTRL0. PacketCodec::Whiten() does the same in software.
+    void CC1101Device::SetWhitening(bool shouldEnable)
+    {
+        byte currentPktCtrl0 = readRegister(CC1101_CONFIG::PKTCTRL0);
+        byte result          = (byte)((currentPktCtrl0 & 0b10111111) | (shouldEnable ? 0b01000000 : 0b00000000));
+
+        ESP_LOGD(TAG, "%s Setting PKTCTRL0 " HEX_FMT, __FUNCTION__, result);
+        (void)writeRegister(CC1101_CONFIG::PKTCTRL0, result);
+    }
+    /// @brief Turn forward error correction with interleaving (Pg 78) on or off in register MDMCFG1.
+    /// Only supported in fixed packet length mode. Halves the effective data rate.
+    void CC1101Device::SetFEC(bool shouldEnable)
+    {
+        byte currentMdmcfg1 = readRegister(CC1101_CONFIG::MDMCFG1);
+        byte result         = (byte)((currentMdmcfg1 & 0b01111111) | (shouldEnable ? 0b10000000 : 0b00000000));
+
+        ESP_LOGD(TAG, "%s Setting MDMCFG1 " HEX_FMT, __FUNCTION__, result);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG1, result);
+    }
+    /// @brief Set the clear channel assessment mode (Pg 81) in register MCSM1. STX from RX only goes to TX if CCA passes.
+    void CC1101Device::SetCCAMode(CcaMode ccaMode)
+    {
+        byte currentMcsm1 = readRegister(CC1101_CONFIG::MCSM1);
+        byte result       = (byte)((currentMcsm1 & 0b11001111) | ((byte)ccaMode << 4));
+
+        ESP_LOGD(TAG, "%s Setting MCSM1 " HEX_FMT, __FUNCTION__, result);
+        (void)writeRegister(CC1101_CONFIG::MCSM1, result);
+    }
+    /// @brief Set the absolute carrier sense threshold (Pg 85) in register AGCCTRL1, in dB relative to MAGN_TARGET.
+    /// -8 disables the absolute threshold. This is also the RSSI threshold CCA uses.
+    void CC1101Device::SetCarrierSenseThreshold(int relativeDb)
+    {
+        byte currentAgcctrl1 = readRegister(CC1101_CONFIG::AGCCTRL1);
+        int  threshold       = std::clamp(relativeDb, -8, 7);
+        byte result          = (byte)((currentAgcctrl1 & 0b11110000) | (threshold & 0x0F));
+
+        ESP_LOGD(TAG, "%s Setting AGCCTRL1 " HEX_FMT, __FUNCTION__, result);
+        (void)writeRegister(CC1101_CONFIG::AGCCTRL1, result);
+    }
+    /// @brief Current RSSI in dBm, converted as in Section 17.3
+    int CC1101Device::ReadRSSIdBm()
+    {
+        return RssiToDbm(readRegister(CC1101_CONFIG::RSSI));
+    }
+    // Section 17.3, the value is in half dB steps, two's complement
+    int CC1101Device::RssiToDbm(byte rssi) const
+    {
+        int rssiDec = rssi;
+
+        if (rssiDec >= 128)
+        {
+            rssiDec -= 256;
+        }
+        return rssiDec / 2 - kRssiOffsetDb;
+    }
+    MarcState CC1101Device::ReadMarcState()
+    {
+        return (MarcState)(readRegister(CC1101_CONFIG::MARCSTATE) & 0x1F);
+    }
+    /// @brief Load a frame into the TX FIFO (unless it is already there) and strobe STX, letting the chip's CCA decide.
+    ///
+    /// The radio must be in RX for CCA to apply. If the channel is busy the chip stays in RX, the frame stays in the
+    /// TX FIFO and ChannelBusy is returned, so a retry only needs the strobe. Call FlushTxFifo() before loading a
+    /// different frame. data is the TX FIFO content, length byte included in variable length mode. timeoutMicros
+    /// covers calibration, settling and the packet itself; Sent means TX was seen and then left, and the radio is
+    /// back in RX.
+    TransmitResult CC1101Device::TryTransmit(const byte *data, int length, uint32_t timeoutMicros)
+    {
+        bool                       bRet        = true;
+        TransmitResult             result      = TransmitResult::Failed;
+        byte                       txBytes     = 0;
+        StatusByteStateMachineMode state       = StatusByteStateMachineMode::IDLE;
+        uint32_t                   startMicros = 0;
+        bool                       sawTx       = false;
+
+        CBR(txFrameFits(data, length));
+
+        txBytes = readRegister(CC1101_CONFIG::TXBYTES) & 0x7F;
+        if (txBytes == 0)
+        {
+            writeBurstRegister(CC1101_CONFIG::TXFIFO, data, length);
+        }
+
+        sendStrobe(CC1101_CONFIG::STX);
+        startMicros = micros();
+
+        // The CCA decision is made within a few us. If it passes the chip calibrates (with FS_AUTOCAL, ~720us) and
+        // settles before TX, so this waits on the deadline rather than a poll count. The status byte from SNOP tells
+        // these states apart as well as MARCSTATE does, in half the bytes.
+        do
+        {
+            CBR(micros() - startMicros < timeoutMicros);
+            delayMicroseconds(10);
+            state = ChipStatus::Decode(sendStrobe(CC1101_CONFIG::SNOP), false).State;
+        } while (state == StatusByteStateMachineMode::Calibrate || state == StatusByteStateMachineMode::Settling);
+
+        if (state == StatusByteStateMachineMode::ReceiveMode)
+        {
+            result = TransmitResult::ChannelBusy;
+            goto Error;
+        }
+
+        while (state == StatusByteStateMachineMode::TransmitMode)
+        {
+            sawTx = true;
+            CBR(micros() - startMicros < timeoutMicros);
+            delayMicroseconds(100);
+            state = ChipStatus::Decode(sendStrobe(CC1101_CONFIG::SNOP), false).State;
+        }
+        CBR(sawTx && state != StatusByteStateMachineMode::FIFOOverflowTX);
+
+        result = TransmitResult::Sent;
+        enableReceiveMode();
+
+    Error:
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed, chip state %d", __PRETTY_FUNCTION__, (int)state);
+            FlushTxFifo();
+        }
+        return result;
+    }
+    // What TryTransmit() can hand to the packet handler: the whole packet in the TX FIFO, and in variable length
+    // mode a length byte that matches what follows it and PKTLEN allows.
+    bool CC1101Device::txFrameFits(const byte *data, int length) const
+    {
+        if (data == nullptr || length <= 0 || length > kTxFifoSize)
+        {
+            return false;
+        }
+        switch (m_deviceConfig.PacketLengthCfg)
+        {
+            case PacketLengthConfig::Variable:
+                return data[0] == length - 1 && data[0] <= m_deviceConfig.PacketLength;
+            case PacketLengthConfig::Fixed:
+                return length == m_deviceConfig.PacketLength;
+            default:
+                return true;
+        }
+    }
+    void CC1101Device::FillCaptureHeader(CaptureHeader &header)
+    {
+        header.Magic               = CaptureHeader::kMagic;
+        header.Version             = CaptureHeader::kVersion;
+        header.HeaderLength        = sizeof(CaptureHeader);
+        header.ConfigHash          = m_deviceConfig.Hash();
+        header.CarrierFrequencyMHz = m_carrierFrequencyMHz;
+        header.StartMicros         = micros();
+        // Read back rather than taken from the shadow, so the capture shows what the chip really had
+        readBurstRegister(CC1101_CONFIG::IOCFG2, header.Registers, CC1101_CONFIG::kNumConfigRegisters);
+        readBurstRegister(CC1101_CONFIG::PATABLE, header.PATable, sizeof(header.PATable));
+    }
+    /// @brief Drop whatever is in the TX FIFO. SFTX is only allowed in IDLE or TXFIFO_UNDERFLOW, so this goes
+    /// through IDLE and back to RX.
+    void CC1101Device::FlushTxFifo()
+    {
+        sendStrobe(CC1101_CONFIG::SIDLE);
+        waitForChipState(StatusByteStateMachineMode::IDLE, 100);
+        sendStrobe(CC1101_CONFIG::SFTX);
+        enableReceiveMode();
+    }
+    /// @brief Enter TX for asynchronous serial transmission. In this mode GDO0 is the TX data input (Section 27.1),
+    /// so the GDO0 interrupt is detached, IOCFG0 is tri-stated and TxPin is driven low until the first pulse.
+    bool CC1101Device::BeginAsyncTransmit()
+    {
+        bool bRet = true;
+
+        CBRA(m_deviceConfig.PacketFmt == PacketFormat::AsyncSerialMode);
+        CBRA(!m_asyncTransmitting);
+
+        DetachGdoInterrupt(GdoPin::GDO0);
+        writeGdoConfig(GdoPin::GDO0, GdoRole::Unused);
+        setTxPinOutput(true);
+        do_gpio_set_level(m_deviceConfig.TxPin, 0);
+        m_asyncTransmitting = true;
+
+        // From IDLE, so CCA (which only gates RX -> TX) can't hold up a batch that has already been decided on
+        sendStrobe(CC1101_CONFIG::SIDLE);
+        CBR(waitForChipState(StatusByteStateMachineMode::IDLE, 100));
+        sendStrobe(CC1101_CONFIG::STX);
+        CBR(waitForChipState(StatusByteStateMachineMode::TransmitMode, 100));
+
+    Error:
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+            (void)EndAsyncTransmit();
+        }
+        return bRet;
+    }
+    /// @brief Drive TxPin through the pulses. Edges are scheduled against absolute times so errors don't add up.
+    /// Long lows (gaps between frames) sleep for most of their length instead of spinning.
+    void CC1101Device::TransmitPulses(std::span<const Pulse> pulses)
+    {
+        uint32_t edgeMicros = micros();
+
+        if (!m_asyncTransmitting)
+        {
+            return;
+        }
+        for (const Pulse &pulse : pulses)
+        {
+            do_gpio_set_level(m_deviceConfig.TxPin, pulse.Level ? 1 : 0);
+            edgeMicros += pulse.DurationMicros;
+            waitUntilMicros(edgeMicros);
+        }
+        do_gpio_set_level(m_deviceConfig.TxPin, 0);
+    }
+    bool CC1101Device::EndAsyncTransmit()
+    {
+        bool    bRet          = true;
+        GdoRole role;
+        bool    edgesCaptured = m_gdoContexts[(int)GdoPin::GDO2].CaptureEdges;
+
+        if (!m_asyncTransmitting)
+        {
+            return true;
+        }
+        do_gpio_set_level(m_deviceConfig.TxPin, 0);
+        setTxPinOutput(false);
+        m_asyncTransmitting = false;
+
+        // Back to whatever GDO0 was doing, and its interrupt if we are receiving
+        role = resolveGdoRole(GdoPin::GDO0);
+        writeGdoConfig(GdoPin::GDO0, role);
+        if (m_eventTask != nullptr && !attachGdoRoleInterrupt(GdoPin::GDO0, role, edgesCaptured))
+        {
+            ESP_LOGE(TAG, "%s: GDO0 interrupt not attached again", __FUNCTION__);
+            bRet = false;
+        }
+        // RX either way; the other GDOs and the FIFO still work
+        enableReceiveMode();
+        return bRet;
+    }
+    void CC1101Device::waitUntilMicros(uint32_t deadlineMicros)
+    {
+        const int32_t kSleepThresholdMicros = 3 * portTICK_PERIOD_MS * 1000;
+        int32_t       remaining             = (int32_t)(deadlineMicros - micros());
+
+        // A tick delay can be up to a tick short or long, so sleep up to two ticks before and spin the rest
+        if (remaining > kSleepThresholdMicros)
+        {
+            delayMilliseconds(remaining / 1000 - 2 * portTICK_PERIOD_MS);
+        }
+        while ((int32_t)(deadlineMicros - micros()) > 0)
+        {
+        }
+    }
+    void CC1101Device::setTxPinOutput(bool output)
+    {
+#ifndef ARDUINO
+        gpio_set_direction(m_deviceConfig.TxPin, output ? GPIO_MODE_OUTPUT : GPIO_MODE_INPUT);
+#else
+        pinMode(m_deviceConfig.TxPin, output ? OUTPUT : INPUT);
+#endif
+    }
+    // Dumps in SmartRF Studio order so we can compare
+    void CC1101Device::DumpRegisters()
+    {
+#if _DEBUG
+        ESP_LOGD(TAG, "IOCFG2:              " HEX_FMT, readRegister(CC1101_CONFIG::IOCFG2));
+        ESP_LOGD(TAG, "IOCFG1:              " HEX_FMT, readRegister(CC1101_CONFIG::IOCFG1));
+        ESP_LOGD(TAG, "IOCFG0:              " HEX_FMT, readRegister(CC1101_CONFIG::IOCFG0));
+        ESP_LOGD(TAG, "FIFOTHR:             " HEX_FMT, readRegister(CC1101_CONFIG::FIFOTHR));
+        ESP_LOGD(TAG, "SYNC1:               " HEX_FMT, readRegister(CC1101_CONFIG::SYNC1));
+        ESP_LOGD(TAG, "SYNC0:               " HEX_FMT, readRegister(CC1101_CONFIG::SYNC0));
+        ESP_LOGD(TAG, "PKTLEN:              " HEX_FMT, readRegister(CC1101_CONFIG::PKTLEN));
+        ESP_LOGD(TAG, "PKTCTRL1:            " HEX_FMT, readRegister(CC1101_CONFIG::PKTCTRL1));
+        ESP_LOGD(TAG, "PKTCTRL0:            " HEX_FMT, readRegister(CC1101_CONFIG::PKTCTRL0));
+        ESP_LOGD(TAG, "ADDR:                " HEX_FMT, readRegister(CC1101_CONFIG::ADDR));
+        ESP_LOGD(TAG, "CHANNR:              " HEX_FMT, readRegister(CC1101_CONFIG::CHANNR));
+        ESP_LOGD(TAG, "FSCTRL1              " HEX_FMT, readRegister(CC1101_CONFIG::FSCTRL1));
+        ESP_LOGD(TAG, "FSCTRL0:             " HEX_FMT, readRegister(CC1101_CONFIG::FSCTRL0));
+        ESP_LOGD(TAG, "FREQ2:               " HEX_FMT, readRegister(CC1101_CONFIG::FREQ2));
+        ESP_LOGD(TAG, "FREQ1:               " HEX_FMT, readRegister(CC1101_CONFIG::FREQ1));
+        ESP_LOGD(TAG, "FREQ0:               " HEX_FMT, readRegister(CC1101_CONFIG::FREQ0));
+        ESP_LOGD(TAG, "MDMCFG4:             " HEX_FMT, readRegister(CC1101_CONFIG::MDMCFG4));
+        ESP_LOGD(TAG, "MDMCFG3:             " HEX_FMT, readRegister(CC1101_CONFIG::MDMCFG3));
+        ESP_LOGD(TAG, "MDMCFG2:             " HEX_FMT, readRegister(CC1101_CONFIG::MDMCFG2));
+        ESP_LOGD(TAG, "MDMCFG1:             " HEX_FMT, readRegister(CC1101_CONFIG::MDMCFG1));
+        ESP_LOGD(TAG, "MDMCFG0:             " HEX_FMT, readRegister(CC1101_CONFIG::MDMCFG0));
+        ESP_LOGD(TAG, "DEVIATN:             " HEX_FMT, readRegister(CC1101_CONFIG::DEVIATN));
+        ESP_LOGD(TAG, "MCSM2:               " HEX_FMT, readRegister(CC1101_CONFIG::MCSM2));
+        ESP_LOGD(TAG, "MCSM1:               " HEX_FMT, readRegister(CC1101_CONFIG::MCSM1));
+        ESP_LOGD(TAG, "MCSM0:               " HEX_FMT, readRegister(CC1101_CONFIG::MCSM0));
+        ESP_LOGD(TAG, "FOCCFG:              " HEX_FMT, readRegister(CC1101_CONFIG::FOCCFG));
+        ESP_LOGD(TAG, "BSCFG:               " HEX_FMT, readRegister(CC1101_CONFIG::BSCFG));
+        ESP_LOGD(TAG, "AGCCTRL2:            " HEX_FMT, readRegister(CC1101_CONFIG::AGCCTRL2));
+        ESP_LOGD(TAG, "AGCCTRL1:            " HEX_FMT, readRegister(CC1101_CONFIG::AGCCTRL1));
+        ESP_LOGD(TAG, "AGCCTRL0:            " HEX_FMT, readRegister(CC1101_CONFIG::AGCCTRL0));
+        ESP_LOGD(TAG, "WOREVT1:             " HEX_FMT, readRegister(CC1101_CONFIG::WOREVT1));
         ESP_LOGD(TAG, "WOREVT0:             " HEX_FMT, readRegister(CC1101_CONFIG::WOREVT0));
         ESP_LOGD(TAG, "WORCTRL:             " HEX_FMT, readRegister(CC1101_CONFIG::WORCTRL));
         ESP_LOGD(TAG, "FREND1:              " HEX_FMT, readRegister(CC1101_CONFIG::FREND1));
@@ -802,39 +1560,669 @@ namespace TI_CC1101
         ESP_LOGD(TAG, "PA_TABLE7:           " HEX_FMT, patables[7]);
 #endif
     }
-    void CC1101Device::lowerChipSelect()
+    /// @brief Compile a configuration into a register image without touching the chip.
+    ///
+    /// regConfig() and configure() are run with all register accesses redirected to the shadow registers,
+    /// starting from the datasheet reset values. If a profile with the same name exists, it is replaced.
+    /// @return the profile id to pass to SwitchProfile()
+    int CC1101Device::RegisterProfile(const char *name, const CC110DeviceConfig &deviceConfig)
+    {
+        RadioProfile      profile;
+        CC110DeviceConfig savedConfig              = m_deviceConfig;
+        float             savedOscillatorFrequency = m_oscillatorFrequencyHz;
+        float             savedCarrierFrequency    = m_carrierFrequencyMHz;
+        PATables          savedPATableBand         = m_currentPATable;
+        byte              savedPATABLE[8];
+        byte              savedPATABLEShadow[8];
+        byte              savedShadow[CC1101_CONFIG::kNumConfigRegisters];
+
+        if (!deviceConfig.Validate())
+        {
+            ESP_LOGE(TAG, "%s: invalid config for profile %s", __FUNCTION__, name);
+            return -1;
+        }
+        memcpy(savedPATABLE, m_PATABLE, sizeof(savedPATABLE));
+        memcpy(savedPATABLEShadow, m_PATABLEShadow, sizeof(savedPATABLEShadow));
+        memcpy(savedShadow, m_registerShadow, sizeof(savedShadow));
+
+        m_compilingProfile = true;
+        m_deviceConfig     = deviceConfig;
+        if (m_deviceConfig.OscillatorFrequencyMHz != 0)
+        {
+            m_oscillatorFrequencyHz = m_deviceConfig.OscillatorFrequencyMHz * 1'000'000;
+        }
+        resetShadowRegisters();
+        regConfig();
+        configure();
+
+        profile.Name                = name;
+        profile.Config              = deviceConfig;
+        profile.CarrierFrequencyMHz = m_carrierFrequencyMHz;
+        memcpy(profile.Registers, m_registerShadow, sizeof(profile.Registers));
+        memcpy(profile.PATable, m_PATABLEShadow, sizeof(profile.PATable));
+
+        m_compilingProfile      = false;
+        m_deviceConfig          = savedConfig;
+        m_oscillatorFrequencyHz = savedOscillatorFrequency;
+        m_carrierFrequencyMHz   = savedCarrierFrequency;
+        m_currentPATable        = savedPATableBand;
+        memcpy(m_PATABLE, savedPATABLE, sizeof(m_PATABLE));
+        memcpy(m_PATABLEShadow, savedPATABLEShadow, sizeof(m_PATABLEShadow));
+        memcpy(m_registerShadow, savedShadow, sizeof(m_registerShadow));
+
+        return storeProfile(profile);
+    }
+    int CC1101Device::FindProfile(const char *name)
+    {
+        for (size_t i = 0; i < m_profiles.size(); i++)
+        {
+            if (m_profiles[i].Name == name)
+            {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+    const RadioProfile *CC1101Device::GetProfile(int profileId)
+    {
+        if (profileId < 0 || profileId >= (int)m_profiles.size())
+        {
+            return nullptr;
+        }
+        return &m_profiles[profileId];
+    }
+    /// @brief Switch the radio to a previously registered profile and re-enter RX.
+    ///
+    /// Strobes SIDLE, burst-writes only the registers that differ from what is currently in the chip,
+    /// rewrites PATABLE if needed and strobes SRX. Calibration happens on the way into RX (MCSM0.FS_AUTOCAL).
+    /// @param outLatencyMicros if not null, receives the time from SIDLE to SRX
+    bool CC1101Device::SwitchProfile(int profileId, uint32_t *outLatencyMicros)
+    {
+        bool     bRet        = true;
+        uint32_t startMicros = micros();
+        uint32_t latency     = 0;
+
+        CBRA(profileId >= 0 && profileId < (int)m_profiles.size());
+
+        // Registers should only be written in IDLE. Leaving RX takes a few clock cycles at most, so the first SNOP
+        // normally finds it there.
+        sendStrobe(CC1101_CONFIG::SIDLE);
+        CBRA(waitForChipState(StatusByteStateMachineMode::IDLE, 100));
+
+        // Whatever is left in the RX FIFO was framed by the old profile
+        sendStrobe(CC1101_CONFIG::SFRX);
+        resetRxPacket();
+        writeProfileDelta(m_profiles[profileId]);
+
+        m_deviceConfig        = m_profiles[profileId].Config;
+        m_carrierFrequencyMHz = m_profiles[profileId].CarrierFrequencyMHz;
+        memcpy(m_PATABLE, m_profiles[profileId].PATable, sizeof(m_PATABLE));
+        if (m_deviceConfig.OscillatorFrequencyMHz != 0)
+        {
+            m_oscillatorFrequencyHz = m_deviceConfig.OscillatorFrequencyMHz * 1'000'000;
+        }
+        m_activeProfile = profileId;
+        CBRA(refreshGdoRoles());
+
+        enableReceiveMode();
+
+        latency = micros() - startMicros;
+        ESP_LOGD(TAG, "%s switched to profile %d (%s) in %u us", __FUNCTION__, profileId, m_profiles[profileId].Name.c_str(), (unsigned)latency);
+        if (outLatencyMicros != nullptr)
+        {
+            *outLatencyMicros = latency;
+        }
+
+    Error:
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+        }
+        return bRet;
+    }
+    /// @brief Start collecting Set* calls for SubmitAsyncConfig(). Until then they only change the shadow registers.
+    void CC1101Device::BeginAsyncConfig()
+    {
+        m_asyncConfigBase.Config              = m_deviceConfig;
+        m_asyncConfigBase.CarrierFrequencyMHz = m_carrierFrequencyMHz;
+        m_asyncConfigPATableBand              = m_currentPATable;
+        memcpy(m_asyncConfigBase.Registers, m_registerShadow, sizeof(m_asyncConfigBase.Registers));
+        memcpy(m_asyncConfigBase.PATable, m_PATABLEShadow, sizeof(m_asyncConfigBase.PATable));
+        m_compilingProfile = true;
+    }
+    /// @brief Queue the shadow registers on radio as one ApplyRegisters() operation. Returns without touching the bus.
+    /// @return the operation. Invalid if radio had no free slot, in which case the state at BeginAsyncConfig() is back.
+    RadioFuture CC1101Device::SubmitAsyncConfig(AsyncRadio &radio, bool enterReceive, RadioOpCallback callback, void *context)
+    {
+        RadioFuture future;
+
+        if (!m_compilingProfile)
+        {
+            ESP_LOGE(TAG, "%s without BeginAsyncConfig()", __FUNCTION__);
+            return future;
+        }
+        m_compilingProfile = false;
+
+        future = radio.ApplyRegisters(m_registerShadow, m_PATABLEShadow, enterReceive, callback, context);
+        if (!future.IsValid())
+        {
+            ESP_LOGE(TAG, "%s: no free operation, configuration not applied", __FUNCTION__);
+            m_deviceConfig        = m_asyncConfigBase.Config;
+            m_carrierFrequencyMHz = m_asyncConfigBase.CarrierFrequencyMHz;
+            m_currentPATable      = m_asyncConfigPATableBand;
+            memcpy(m_registerShadow, m_asyncConfigBase.Registers, sizeof(m_registerShadow));
+            memcpy(m_PATABLEShadow, m_asyncConfigBase.PATable, sizeof(m_PATABLEShadow));
+            memcpy(m_PATABLE, m_asyncConfigBase.PATable, sizeof(m_PATABLE));
+            return future;
+        }
+        if (memcmp(m_PATABLEShadow, m_asyncConfigBase.PATable, sizeof(m_PATABLEShadow)) != 0)
+        {
+            m_PATABLEWrites++;
+        }
+        return future;
+    }
+    void CC1101Device::recordBootProfile()
+    {
+        RadioProfile bootProfile;
+
+        bootProfile.Name                = "default";
+        bootProfile.Config              = m_deviceConfig;
+        bootProfile.CarrierFrequencyMHz = m_carrierFrequencyMHz;
+        memcpy(bootProfile.Registers, m_registerShadow, sizeof(bootProfile.Registers));
+        memcpy(bootProfile.PATable, m_PATABLEShadow, sizeof(bootProfile.PATable));
+        // After a warm boot the chip may be in manual calibration; coming back to this profile later calibrates
+        bootProfile.Registers[CC1101_CONFIG::MCSM0] |= (m_registerShadow[CC1101_CONFIG::MCSM0] & kFsAutocalMask) == 0 ? kFsAutocalFromIdle : 0;
+        m_activeProfile = storeProfile(bootProfile);
+    }
+    int CC1101Device::storeProfile(const RadioProfile &profile)
+    {
+        int profileId = FindProfile(profile.Name.c_str());
+        if (profileId >= 0)
+        {
+            m_profiles[profileId] = profile;
+            return profileId;
+        }
+        m_profiles.push_back(profile);
+        return (int)m_profiles.size() - 1;
+    }
+    // Writes the registers that differ between the shadow and the profile, in as few bursts as possible.
+    // Runs separated by no more than kMaxProfileDeltaGap identical registers are merged into one burst.
+    void CC1101Device::writeProfileDelta(const RadioProfile &profile)
+    {
+        int address      = 0;
+        int burstCount   = 0;
+        int bytesWritten = 0;
+
+        while (address < CC1101_CONFIG::kNumConfigRegisters)
+        {
+            if (profile.Registers[address] == m_registerShadow[address])
+            {
+                address++;
+                continue;
+            }
+            int lastDifferent = address;
+            for (int next = address + 1; next < CC1101_CONFIG::kNumConfigRegisters && (next - lastDifferent) <= kMaxProfileDeltaGap + 1; next++)
+            {
+                if (profile.Registers[next] != m_registerShadow[next])
+                {
+                    lastDifferent = next;
+                }
+            }
+            int runLength = lastDifferent - address + 1;
+            if (runLength == 1)
+            {
+                (void)writeRegister(address, profile.Registers[address]);
+            }
+            else
+            {
+                writeBurstRegister(address, &profile.Registers[address], runLength);
+            }
+            burstCount++;
+            bytesWritten += runLength;
+            address = lastDifferent + 1;
+        }
+        if (memcmp(profile.PATable, m_PATABLEShadow, sizeof(m_PATABLEShadow)) != 0)
+        {
+            writeBurstRegister(CC1101_CONFIG::PATABLE, profile.PATable, sizeof(profile.PATable));
+            burstCount++;
+            bytesWritten += sizeof(profile.PATable);
+        }
+        ESP_LOGD(TAG, "%s: %d registers in %d accesses", __FUNCTION__, bytesWritten, burstCount);
+    }
+    /// @brief Run an FS calibration on each channel and remember FSCAL3..1 for it. Results go into the snapshot and
+    /// are reused by SetChannel(). The radio is left in IDLE on the last channel calibrated.
+    bool CC1101Device::CalibrateChannels(const byte *channels, int channelCount)
+    {
+        bool bRet = true;
+
+        CBRA(channelCount <= RadioSnapshot::kMaxCalibratedChannels);
+
+        sendStrobe(CC1101_CONFIG::SIDLE);
+        CBR(waitForChipState(StatusByteStateMachineMode::IDLE, 100));
+
+        m_calibratedChannelCount = 0;
+        for (int i = 0; i < channelCount; i++)
+        {
+            ChannelCalibration &calibration = m_channelCalibration[i];
+
+            (void)writeRegister(CC1101_CONFIG::CHANNR, channels[i]);
+            sendStrobe(CC1101_CONFIG::SCAL);
+            // Calibration takes ~720us (Table 34). The chip goes back to IDLE when done. SCAL's own status byte says
+            // IDLE, so look once before waiting for IDLE.
+            sendStrobe(CC1101_CONFIG::SNOP);
+            CBR(waitForChipState(StatusByteStateMachineMode::IDLE, 50));
+
+            calibration.Channel = channels[i];
+            calibration.FSCAL3  = readRegister(CC1101_CONFIG::FSCAL3);
+            calibration.FSCAL2  = readRegister(CC1101_CONFIG::FSCAL2);
+            calibration.FSCAL1  = readRegister(CC1101_CONFIG::FSCAL1);
+            m_registerShadow[CC1101_CONFIG::FSCAL3] = calibration.FSCAL3;
+            m_registerShadow[CC1101_CONFIG::FSCAL2] = calibration.FSCAL2;
+            m_registerShadow[CC1101_CONFIG::FSCAL1] = calibration.FSCAL1;
+            m_calibratedChannelCount++;
+
+            ESP_LOGD(TAG, "%s channel %d FSCAL3=" HEX_FMT " FSCAL2=" HEX_FMT " FSCAL1=" HEX_FMT, __FUNCTION__, channels[i], calibration.FSCAL3, calibration.FSCAL2, calibration.FSCAL1);
+        }
+    Error:
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+        }
+        return bRet;
+    }
+    /// @brief Change CHANNR. If the channel was calibrated by CalibrateChannels(), its FSCAL values are written too,
+    /// so with MCSM0.FS_AUTOCAL = 0 no calibration is needed. Otherwise automatic calibration is turned back on, since
+    /// the chip would run on the previous channel's values. Must be called in IDLE.
+    bool CC1101Device::SetChannel(byte channel)
+    {
+        (void)writeRegister(CC1101_CONFIG::CHANNR, channel);
+        for (int i = 0; i < m_calibratedChannelCount; i++)
+        {
+            if (m_channelCalibration[i].Channel == channel)
+            {
+                byte fscal[3] = {m_channelCalibration[i].FSCAL3, m_channelCalibration[i].FSCAL2, m_channelCalibration[i].FSCAL1};
+                writeBurstRegister(CC1101_CONFIG::FSCAL3, fscal, sizeof(fscal));
+                return true;
+            }
+        }
+        if ((m_registerShadow[CC1101_CONFIG::MCSM0] & kFsAutocalMask) == 0)
+        {
+            (void)writeRegister(CC1101_CONFIG::MCSM0, m_registerShadow[CC1101_CONFIG::MCSM0] | kFsAutocalFromIdle);
+        }
+        return false;
+    }
+    /// @brief Fold the frequency offset estimated on the last packet (FREQEST) into FSCTRL0, pg 81.
+    /// @return the new offset, in units of Fxosc/2^14
+    int8_t CC1101Device::LearnFrequencyOffset()
+    {
+        int8_t estimate = (int8_t)readRegister(CC1101_CONFIG::FREQEST);
+        int    offset   = (int)m_frequencyOffset + estimate;
+
+        offset            = std::clamp(offset, -128, 127);
+        m_frequencyOffset = (int8_t)offset;
+        (void)writeRegister(CC1101_CONFIG::FSCTRL0, (byte)m_frequencyOffset);
+
+        ESP_LOGD(TAG, "%s FREQEST %d, FSCTRL0 now %d", __FUNCTION__, estimate, m_frequencyOffset);
+        return m_frequencyOffset;
+    }
+    void CC1101Device::CaptureSnapshot(RadioSnapshot &snapshot)
+    {
+        memset(&snapshot, 0, sizeof(snapshot)); // padding is covered by the CRC
+        snapshot.ConfigHash          = m_deviceConfig.Hash();
+        snapshot.CarrierFrequencyMHz = m_carrierFrequencyMHz;
+        snapshot.FrequencyOffset     = m_frequencyOffset;
+        snapshot.ChannelCount        = (uint16_t)m_calibratedChannelCount;
+        memcpy(snapshot.Registers, m_registerShadow, sizeof(snapshot.Registers));
+        memcpy(snapshot.PATable, m_PATABLEShadow, sizeof(snapshot.PATable));
+        memcpy(snapshot.Channels, m_channelCalibration, sizeof(ChannelCalibration) * m_calibratedChannelCount);
+        // Saved with calibration on, as configured. RestoreSnapshot() decides again whether it can do without.
+        if ((snapshot.Registers[CC1101_CONFIG::MCSM0] & kFsAutocalMask) == 0)
+        {
+            snapshot.Registers[CC1101_CONFIG::MCSM0] |= kFsAutocalFromIdle;
+        }
+    }
+    /// @brief Reset the chip and load a snapshot with two burst writes. No float math, no read-modify-write and no
+    /// calibration: if the snapshot has FSCAL values for the current channel they are loaded and MCSM0.FS_AUTOCAL is
+    /// set to manual, otherwise SRX calibrates as usual. SetChannel() to an uncalibrated channel, a profile switch or
+    /// Reset() turn automatic calibration back on. Calibration drifts with temperature (Section 19.6); call
+    /// CalibrateChannels() again and SaveSnapshot() if the device sees large swings.
+    bool CC1101Device::RestoreSnapshot(const RadioSnapshot &snapshot)
+    {
+        bool bRet = true;
+        byte registers[CC1101_CONFIG::kNumConfigRegisters];
+
+        CBRA(snapshot.ChannelCount <= RadioSnapshot::kMaxCalibratedChannels);
+
+        memcpy(registers, snapshot.Registers, sizeof(registers));
+        for (int i = 0; i < snapshot.ChannelCount; i++)
+        {
+            const ChannelCalibration &calibration = snapshot.Channels[i];
+            if (calibration.Channel == registers[CC1101_CONFIG::CHANNR])
+            {
+                // SRX would otherwise calibrate over them
+                registers[CC1101_CONFIG::FSCAL3] = calibration.FSCAL3;
+                registers[CC1101_CONFIG::FSCAL2] = calibration.FSCAL2;
+                registers[CC1101_CONFIG::FSCAL1] = calibration.FSCAL1;
+                registers[CC1101_CONFIG::MCSM0] &= ~kFsAutocalMask;
+                break;
+            }
+        }
+
+        Reset();
+        writeBurstRegister(0, registers, sizeof(registers));
+        writeBurstRegister(CC1101_CONFIG::PATABLE, snapshot.PATable, sizeof(snapshot.PATable));
+
+        m_carrierFrequencyMHz    = snapshot.CarrierFrequencyMHz;
+        m_frequencyOffset        = snapshot.FrequencyOffset;
+        m_calibratedChannelCount = snapshot.ChannelCount;
+        memcpy(m_PATABLE, snapshot.PATable, sizeof(m_PATABLE));
+        memcpy(m_channelCalibration, snapshot.Channels, sizeof(ChannelCalibration) * snapshot.ChannelCount);
+        CBR(refreshGdoRoles());
+
+    Error:
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+        }
+        return bRet;
+    }
+    /// @brief Persist the current register image and calibration to NVS. Calibrates the current channel first
+    /// if nothing has been calibrated yet. nvs_flash_init() must have been called. Nothing is saved if that
+    /// calibration fails, so a warm boot never loads FSCAL values that didn't come from one.
+    bool CC1101Device::SaveSnapshot()
     {
-        digitalWrite(m_spiMaster->ChipSelectPin(), 0);
+        bool          bRet    = true;
+        byte          channel = m_registerShadow[CC1101_CONFIG::CHANNR];
+        RadioSnapshot snapshot;
+
+        if (m_calibratedChannelCount == 0)
+        {
+            CBR(CalibrateChannels(&channel, 1));
+        }
+        CaptureSnapshot(snapshot);
+        CBR(RadioSnapshotStore::Save(snapshot));
+
+    Error:
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+        }
+        return bRet;
     }
+    bool CC1101Device::tryWarmBoot()
+    {
+        RadioSnapshot snapshot;
+        uint32_t      startMicros = micros();
 
-    void CC1101Device::raiseChipSelect()
+        if (!RadioSnapshotStore::Load(snapshot) || !snapshot.IsValid(m_deviceConfig.Hash()))
+        {
+            return false;
+        }
+        if (!RestoreSnapshot(snapshot))
+        {
+            return false;
+        }
+        ESP_LOGI(TAG, "Warm boot from snapshot took %u us", (unsigned)(micros() - startMicros));
+        return true;
+    }
+    void CC1101Device::resetShadowRegisters()
     {
-        digitalWrite(m_spiMaster->ChipSelectPin(), 1);
+        memcpy(m_registerShadow, ConfigValues::CONFIG_REGISTER_RESET_VALUES, sizeof(m_registerShadow));
+        memset(m_PATABLEShadow, 0, sizeof(m_PATABLEShadow)); // PATABLE is 0xC6,0,0... after reset but we always overwrite it
     }
-
-    void CC1101Device::waitForMisoLow()
+    // Bounded like SpiMaster::waitForMisoLow(). This one is used around reset, where the chip may take a few ms.
+    bool CC1101Device::waitForMisoLow()
     {
-        while (do_gpio_get_level(m_spiMaster->MisoPin()) == 1)
+        for (int waited = 0; do_gpio_get_level(m_spiMaster->MisoPin()) == 1; waited++)
+        {
+            if (waited == 10)
+            {
+                recordError(RadioError::ChipNotReady);
+                return false;
+            }
             delayMilliseconds(1);
+        }
+        return true;
     }
-    void CC1101Device::enableReceiveMode()
+    void CC1101Device::recordError(RadioError error)
     {
-        byte outData;
-        for (int tries = 0; tries < 3; tries++) // Sometimes SRX fails to put chip in receive mode.
+        if (m_pendingError == RadioError::None)
         {
-            byte chipState = 0;
+            ESP_LOGW(TAG, "radio error: %s", RadioErrorName(error));
+            m_pendingError = error;
+        }
+    }
+    RadioError CC1101Device::TakeError()
+    {
+        RadioError error = m_pendingError;
 
-            outData = sendStrobe(CC1101_CONFIG::SRX);
-            ESP_LOGD(TAG, "SRX strobe returned status " HEX_FMT, outData);
-            handleCommonStatusCodes(outData, true);
+        m_pendingError = RadioError::None;
+        return error;
+    }
+    /// @brief Get the radio back into RX after an error. Escalates through the RecoveryStage steps, cheapest first,
+    /// and stops at the first one that leaves the chip in RX without a new error.
+    Result<void> CC1101Device::Recover(RadioError error)
+    {
+        uint32_t      startMicros = micros();
+        RecoveryStage firstStage  = RecoveryStage::FlushAndRestart;
+        bool          recovered   = false;
+
+        ESP_LOGW(TAG, "%s: %s", __FUNCTION__, RadioErrorName(error));
+        m_recoveryStats.Errors++;
+        m_recoveryStats.LastError = error;
+        (void)TakeError();
+
+        // SRX would happily bring a chip that lost its registers up on the reset frequency, and there is no point
+        // flushing FIFOs on a chip that doesn't answer
+        if (error == RadioError::RegistersLost || error == RadioError::UnknownChip || error == RadioError::ChipNotReady || error == RadioError::SpiFailure)
+        {
+            firstStage = RecoveryStage::RewriteRegisters;
+        }
+        for (int stage = (int)firstStage; !recovered && stage < (int)RecoveryStage::Count; stage++)
+        {
+            recovered = recoveryStage((RecoveryStage)stage, error);
+        }
 
-            chipState = outData & 0b11110000; // check chip state (pg 31)
-            if (chipState == 0b0001)
-            {
+        m_stuckHealthChecks        = 0;
+        m_lastActivityMicros       = micros();
+        m_recoveryStats.LastMicros = m_lastActivityMicros - startMicros;
+        if (m_recoveryStats.LastMicros > m_recoveryStats.MaxMicros)
+        {
+            m_recoveryStats.MaxMicros = m_recoveryStats.LastMicros;
+        }
+        if (!recovered)
+        {
+            m_recoveryStats.Failures++;
+            ESP_LOGE(TAG, "%s: radio did not come back after %s", __FUNCTION__, RadioErrorName(error));
+            return error;
+        }
+        ESP_LOGI(TAG, "%s: back in RX after %u us", __FUNCTION__, (unsigned)m_recoveryStats.LastMicros);
+        return {};
+    }
+    bool CC1101Device::recoveryStage(RecoveryStage stage, RadioError error)
+    {
+        RecoveryStageStats &stats       = m_recoveryStats.Stages[(int)stage];
+        uint32_t            startMicros = micros();
+        bool                ready       = false;
+        byte                savedShadow[CC1101_CONFIG::kNumConfigRegisters];
+        byte                savedPATABLEShadow[8];
+        byte                partNumber;
+        byte                chipVersion;
+
+        stats.Attempts++;
+        // writeBurstRegister() updates the shadow, and Reset() clears it, so write back from a copy
+        memcpy(savedShadow, m_registerShadow, sizeof(savedShadow));
+        memcpy(savedPATABLEShadow, m_PATABLEShadow, sizeof(savedPATABLEShadow));
+
+        switch (stage)
+        {
+            case RecoveryStage::FlushAndRestart:
+                sendStrobe(CC1101_CONFIG::SIDLE);
+                ready = waitForChipState(StatusByteStateMachineMode::IDLE, kReceiveStatePolls);
+                if (ready)
+                {
+                    sendStrobe(CC1101_CONFIG::SFRX);
+                    resetRxPacket();
+                    if (error == RadioError::TxFifoUnderflow)
+                    {
+                        sendStrobe(CC1101_CONFIG::SFTX);
+                    }
+                }
+                break;
+            case RecoveryStage::RewriteRegisters:
+                for (int attempt = 0; !ready && attempt < kRecoveryRetries; attempt++)
+                {
+                    partNumber  = readRegister(CC1101_CONFIG::PARTNUM);
+                    chipVersion = readRegister(CC1101_CONFIG::VERSION);
+                    ready       = TakeError() == RadioError::None && partNumber == kPartNumber && chipVersion == kChipVersion;
+                    if (!ready)
+                    {
+                        delayMilliseconds(1 << attempt);
+                    }
+                }
+                if (ready)
+                {
+                    sendStrobe(CC1101_CONFIG::SIDLE);
+                    writeBurstRegister(0, savedShadow, sizeof(savedShadow));
+                    writeBurstRegister(CC1101_CONFIG::PATABLE, savedPATABLEShadow, sizeof(savedPATABLEShadow));
+                }
+                break;
+            default:
+                Reset();
+                writeBurstRegister(0, savedShadow, sizeof(savedShadow));
+                writeBurstRegister(CC1101_CONFIG::PATABLE, savedPATABLEShadow, sizeof(savedPATABLEShadow));
+                ready = true;
+                break;
+        }
+        if (ready)
+        {
+            enableReceiveMode();
+        }
+        // Anything recorded along the way, including not reaching RX, means this stage didn't do it
+        ready = (TakeError() == RadioError::None) && ready;
+
+        stats.LastMicros = micros() - startMicros;
+        if (stats.LastMicros > stats.MaxMicros)
+        {
+            stats.MaxMicros = stats.LastMicros;
+        }
+        if (ready)
+        {
+            stats.Successes++;
+        }
+        ESP_LOGI(TAG, "%s: stage %d %s in %u us", __FUNCTION__, (int)stage, ready ? "worked" : "failed", (unsigned)stats.LastMicros);
+        return ready;
+    }
+    /// @brief Look for the ways a receiver gets stuck: the chip reset itself or stopped answering, the RX FIFO
+    /// overflowed and nothing flushed it, the chip sits in IDLE or calibration, or (optionally) nothing has been
+    /// received for too long. Costs one SPI transaction.
+    RadioError CC1101Device::CheckHealth()
+    {
+        byte      addresses[5] = {CC1101_CONFIG::PARTNUM, CC1101_CONFIG::VERSION, CC1101_CONFIG::MARCSTATE, CC1101_CONFIG::RXBYTES, 0};
+        byte      values[5]    = {};
+        byte      sentinel     = 0;
+        MarcState state;
+
+        m_recoveryStats.HealthChecks++;
+        // A configured register that differs from its reset value tells a brownout reset apart from an idle chip.
+        // FSCAL3 and up change with calibration.
+        while (sentinel < CC1101_CONFIG::FSCAL3 && m_registerShadow[sentinel] == ConfigValues::CONFIG_REGISTER_RESET_VALUES[sentinel])
+        {
+            sentinel++;
+        }
+        addresses[4] = sentinel;
+
+        static_assert(ARRAYSIZE(addresses) <= kMaxChainedReads);
+        if (!readRegisters(addresses, values, ARRAYSIZE(addresses)))
+        {
+            return TakeError();
+        }
+        if (values[0] != kPartNumber || values[1] != kChipVersion)
+        {
+            return RadioError::UnknownChip;
+        }
+        if (sentinel < CC1101_CONFIG::FSCAL3 && values[4] != m_registerShadow[sentinel])
+        {
+            ESP_LOGW(TAG, "%s: register " HEX_FMT " reads " HEX_FMT ", expected " HEX_FMT, __FUNCTION__, sentinel, values[4], m_registerShadow[sentinel]);
+            return RadioError::RegistersLost;
+        }
+        state = (MarcState)(values[2] & 0x1F);
+        if (state == MarcState::RXFIFO_OVERFLOW || (values[3] & ~kRxFifoByteCountMask) != 0)
+        {
+            return RadioError::RxFifoOverflow;
+        }
+        if (state == MarcState::TXFIFO_UNDERFLOW)
+        {
+            return RadioError::TxFifoUnderflow;
+        }
+        switch (state)
+        {
+            case MarcState::RX:
+            case MarcState::RX_END:
+            case MarcState::RX_RST:
+            case MarcState::TXRX_SWITCH:
+            case MarcState::RXTX_SWITCH:
+            case MarcState::FSTXON:
+            case MarcState::TX:
+            case MarcState::TX_END:
+                m_stuckHealthChecks = 0;
                 break;
+            default:
+                // IDLE, calibration and settling are fine on the way somewhere, not twice in a row
+                if (++m_stuckHealthChecks >= kStuckHealthChecks)
+                {
+                    ESP_LOGW(TAG, "%s: stuck in MARCSTATE " HEX_FMT, __FUNCTION__, (int)state);
+                    return RadioError::UnexpectedState;
+                }
+                break;
+        }
+        if (m_silenceLimitMicros != 0 && micros() - m_lastActivityMicros > m_silenceLimitMicros)
+        {
+            return RadioError::NoActivity;
+        }
+        return RadioError::None;
+    }
+    void CC1101Device::SetHealthWatchdog(uint32_t intervalMillis, uint32_t silenceMillis)
+    {
+        m_healthIntervalMicros  = intervalMillis * 1000;
+        m_silenceLimitMicros    = silenceMillis * 1000;
+        m_lastHealthCheckMicros = micros();
+        m_lastActivityMicros    = m_lastHealthCheckMicros;
+        m_stuckHealthChecks     = 0;
+    }
+    void CC1101Device::enableReceiveMode()
+    {
+        int strobes = 1;
+        int polls   = 0;
+
+        // SRX's own status byte shows where the chip was. From IDLE it calibrates (FS_AUTOCAL) and settles before RX,
+        // and the status byte shows that too, so only a chip still in IDLE after a poll missed the strobe.
+        sendStrobe(CC1101_CONFIG::SRX);
+        while (m_chipStatus.State != StatusByteStateMachineMode::ReceiveMode && polls++ < kReceiveStatePolls)
+        {
+            if (m_chipStatus.State == StatusByteStateMachineMode::FIFOOverflowRX)
+            {
+                // SRX does nothing here, the FIFO has to be flushed first
+                recordError(RadioError::RxFifoOverflow);
+                return;
             }
-            delayMicroseconds(40);
-        };
+            if (polls > 1)
+            {
+                delayMicroseconds(20);
+            }
+            sendStrobe(CC1101_CONFIG::SNOP);
+            if (m_chipStatus.State == StatusByteStateMachineMode::IDLE && strobes < kReceiveStrobes)
+            {
+                ESP_LOGD(TAG, "%s: still IDLE, repeating SRX", __FUNCTION__);
+                sendStrobe(CC1101_CONFIG::SRX);
+                strobes++;
+            }
+        }
+        if (m_chipStatus.State != StatusByteStateMachineMode::ReceiveMode)
+        {
+            ESP_LOGW(TAG, "%s: chip state %d, MARCSTATE " HEX_FMT " after SRX", __FUNCTION__, (int)m_chipStatus.State, (int)ReadMarcState());
+            recordError(RadioError::UnexpectedState);
+        }
     }
 #ifndef ARDUINO
     bool CC1101Device::digitalWrite(gpio_num_t pin, uint32_t value)
@@ -857,18 +2245,24 @@ namespace TI_CC1101
         bool bRet  = true;
         byte value = 0;
         address &= 0b00111111; // clear R/W and burst bit
+        if (m_compilingProfile)
+        {
+            return (address < CC1101_CONFIG::kNumConfigRegisters) ? m_registerShadow[address] : 0;
+        }
         if (address >= CC1101_CONFIG::PARTNUM && address <= CC1101_CONFIG::RCCTRL0_STATUS)
         {
             address |= kSpiBurstAccessBit;
         }
         address |= kSpiHeaderReadBit;
 
-        CBRA(m_spiMaster->ReadRegister(address,value));
+        CBR(m_spiMaster->ReadRegister(address,value));
+        noteChipStatus(m_spiMaster->LastStatus(), true);
 
     Error:
         if (!bRet)
         {
             ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+            recordError(m_spiMaster->LastError());
         }
         return value;
     }
@@ -881,41 +2275,144 @@ namespace TI_CC1101
             ESP_LOGE(TAG, "Control registers cannot be read with burst access");
             return false;
         }
+        if (m_compilingProfile)
+        {
+            for (int i = 0; i < len; i++)
+            {
+                if (address == CC1101_CONFIG::PATABLE)
+                {
+                    buffer[i] = m_PATABLEShadow[i % sizeof(m_PATABLEShadow)];
+                }
+                else
+                {
+                    buffer[i] = (address + i < CC1101_CONFIG::kNumConfigRegisters) ? m_registerShadow[address + i] : 0;
+                }
+            }
+            return true;
+        }
         address |= (kSpiBurstAccessBit | kSpiHeaderReadBit);
 
-        CBRA(m_spiMaster->ReadBurstRegister(address,buffer,len));
+        CBR(m_spiMaster->ReadBurstRegister(address,buffer,len));
+        noteChipStatus(m_spiMaster->LastStatus(), true);
     Error:
         if (!bRet)
         {
             ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+            recordError(m_spiMaster->LastError());
         }
         return bRet;
     }
-    void CC1101Device::readRXFIFO(byte *buffer, int expectedCount)
+    // Single reads sharing one CSn low. Status registers get the burst bit, as in readRegister().
+    bool CC1101Device::readRegisters(const byte *addresses, byte *values, int count)
     {
-        byte status[2];
-        byte scratch[255]; // absolute max of RXFIFO
-        byte regVal = readRegister(CC1101_CONFIG::RXBYTES);
-
-        byte avail = (regVal & kRxFifoByteCountMask);
+        bool bRet = true;
+        byte headers[kMaxChainedReads];
 
-        ESP_LOGD(TAG, "%s, expected %d, avail %d", __FUNCTION__, expectedCount, avail);
-        readBurstRegister(CC1101_CONFIG::RXFIFO, scratch, avail);
-        for (int i = 0; i < avail; i++)
+        CBRA(count > 0 && count <= kMaxChainedReads);
+        for (int i = 0; i < count; i++)
+        {
+            headers[i] = addresses[i] & 0b00111111;
+            if (headers[i] >= CC1101_CONFIG::PARTNUM && headers[i] <= CC1101_CONFIG::RCCTRL0_STATUS)
+            {
+                headers[i] |= kSpiBurstAccessBit;
+            }
+            headers[i] |= kSpiHeaderReadBit;
+        }
+        CBR(m_spiMaster->ReadRegisters(headers, values, count));
+        noteChipStatus(m_spiMaster->LastStatus(), true);
+    Error:
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+            recordError(m_spiMaster->LastError());
+        }
+        return bRet;
+    }
+    // Reads what RXBYTES said is there. In infinite length mode that is one block with no status bytes. Fixed and
+    // variable length packets are collected until complete and go to the capture streamer whole, with RSSI and
+    // LQI/CRC_OK from the two appended status bytes (which RXBYTES counts as part of the packet).
+    void CC1101Device::drainRxFifo(byte rxBytes)
+    {
+        int  avail       = rxBytes & kRxFifoByteCountMask;
+        int  statusBytes = m_deviceConfig.EnableAppendStatusBytes ? 2 : 0;
+        int  want        = 0;
+        int  take        = 0;
+        int  payloadLength;
+        byte block[kRxFifoSize];
+
+        if ((rxBytes & ~kRxFifoByteCountMask) != 0)
         {
-            ESP_LOGD(TAG, "%s buffer[%d]= " HEX_FMT, __FUNCTION__, i, scratch[i]);
+            // SFRX takes the chip to IDLE, so leave the flush to Recover(), which also goes back to RX
+            ESP_LOGW(TAG, "RX_FIFO overflow");
+            recordError(RadioError::RxFifoOverflow);
+            resetRxPacket();
+            return;
         }
-        if (m_deviceConfig.EnableAppendStatusBytes)
+        if (m_deviceConfig.PacketLengthCfg == PacketLengthConfig::Infinite)
         {
-            readBurstRegister(CC1101_CONFIG::RXFIFO, status, 2);
-            ESP_LOGD(TAG, "%s status= {" HEX_FMT "," HEX_FMT "}", __FUNCTION__, status[0], status[1]);
+            if (avail > 0 && readBurstRegister(CC1101_CONFIG::RXFIFO, block, avail) && m_captureStreamer != nullptr)
+            {
+                m_captureStreamer->AddFifoBlock(block, avail, 0, 0);
+            }
+            return;
         }
-        if ((regVal & ~kRxFifoByteCountMask) != 0)
+        while (avail > 0)
         {
-            byte resetStatus;
-            ESP_LOGW(TAG, "RX_FIFO overflow, sending reset");
-            m_spiMaster->WriteByte(CC1101_CONFIG::SFRX, resetStatus);
-            ESP_LOGW(TAG, "RX_FIFO overflow, new status " HEX_FMT, resetStatus);
+            if (m_rxPacketExpected == 0)
+            {
+                if (m_deviceConfig.PacketLengthCfg == PacketLengthConfig::Variable)
+                {
+                    // The length byte alone would empty the FIFO mid-packet (see below)
+                    if (avail < 2 || !readBurstRegister(CC1101_CONFIG::RXFIFO, m_rxPacket, 1))
+                    {
+                        return;
+                    }
+                    avail--;
+                    m_rxPacketLength   = 1;
+                    m_rxPacketExpected = 1 + m_rxPacket[0] + statusBytes;
+                    if (m_rxPacket[0] > m_deviceConfig.PacketLength)
+                    {
+                        // The chip drops packets longer than PKTLEN, so nothing more of this one is coming
+                        resetRxPacket();
+                        continue;
+                    }
+                }
+                else
+                {
+                    m_rxPacketExpected = m_deviceConfig.PacketLength + statusBytes;
+                }
+            }
+            want = m_rxPacketExpected - m_rxPacketLength;
+            take = std::min(avail, want);
+            if (take < want)
+            {
+                // A packet that fits in the FIFO is read once it is all there, so CRC autoflush can't pull it out
+                // from under a partial read. Longer ones are read as they come, but the FIFO is never emptied while
+                // the packet is still arriving (errata: the last byte can be read twice).
+                if (m_rxPacketExpected <= kRxFifoSize)
+                {
+                    return;
+                }
+                take--;
+            }
+            if (take <= 0 || !readBurstRegister(CC1101_CONFIG::RXFIFO, m_rxPacket + m_rxPacketLength, take))
+            {
+                return;
+            }
+            avail -= take;
+            m_rxPacketLength += take;
+            if (m_rxPacketLength < m_rxPacketExpected)
+            {
+                return;
+            }
+
+            payloadLength = m_rxPacketExpected - statusBytes;
+            ESP_LOGD(TAG, "%s, %d byte packet", __FUNCTION__, payloadLength);
+            if (m_captureStreamer != nullptr)
+            {
+                m_captureStreamer->AddFifoBlock(m_rxPacket, payloadLength, statusBytes ? m_rxPacket[payloadLength] : 0, statusBytes ? m_rxPacket[payloadLength + 1] : 0);
+            }
+            resetRxPacket();
         }
     }
 
@@ -931,141 +2428,170 @@ namespace TI_CC1101
     {
         byte statusCode = 0;
 
-        m_spiMaster->WriteByteToAddress(address, value, statusCode);
-        return statusCode;
-    }
-
-    void CC1101Device::writeBurstRegister(byte address, byte *values, int valueLen)
-    {
-        byte statusCode = 0;
-        m_spiMaster->WriteBytesToAddress(address | kSpiBurstAccessBit,values, valueLen, statusCode);
-        ESP_LOGD(TAG, "Write values to address " HEX_FMT " statusCode " HEX_FMT, address, statusCode);
-    }
-
-    byte CC1101Device::sendStrobe(byte strobeCmd)
-    {
-        byte outStatus = 0;
-        m_spiMaster->WriteByte(strobeCmd, outStatus);
-
-        return outStatus;
-    }
-
-    byte CC1101Device::getMultiLayerInductorPower(int outputPower, const byte *currentTable, int currentTableLen)
-    {
-        byte paSetting;
-
-        assert(currentTableLen == 8);
-        if (outputPower <= -30)
+        if (address < CC1101_CONFIG::kNumConfigRegisters)
         {
-            paSetting = currentTable[0];
+            m_registerShadow[address] = value;
         }
-        else if (outputPower <= -20)
+        if (m_compilingProfile)
         {
-            paSetting = currentTable[1];
+            return statusCode;
         }
-        else if (outputPower <= -15)
+        if (!m_spiMaster->WriteByteToAddress(address, value, statusCode))
         {
-            paSetting = currentTable[2];
+            recordError(m_spiMaster->LastError());
+            return statusCode;
         }
-        else if (outputPower <= -10)
+        noteChipStatus(statusCode, false);
+        return statusCode;
+    }
+
+    void CC1101Device::writeBurstRegister(byte address, const byte *values, int valueLen)
+    {
+        byte statusCode = 0;
+
+        if (address == CC1101_CONFIG::PATABLE)
         {
-            paSetting = currentTable[3];
+            memcpy(m_PATABLEShadow, values, std::min(valueLen, (int)sizeof(m_PATABLEShadow)));
         }
-        else if (outputPower <= 0)
+        else
         {
-            paSetting = currentTable[4];
+            for (int i = 0; i < valueLen && address + i < CC1101_CONFIG::kNumConfigRegisters; i++)
+            {
+                m_registerShadow[address + i] = values[i];
+            }
         }
-        else if (outputPower <= 5)
+        if (m_compilingProfile)
         {
-            paSetting = currentTable[5];
+            return;
         }
-        else if (outputPower <= 7)
+        if (address == CC1101_CONFIG::PATABLE)
         {
-            paSetting = currentTable[6];
+            m_PATABLEWrites++;
         }
-        else
+        if (!m_spiMaster->WriteBytesToAddress(address | kSpiBurstAccessBit,values, valueLen, statusCode))
         {
-            paSetting = currentTable[7];
+            recordError(m_spiMaster->LastError());
+            return;
         }
-        return paSetting;
+        noteChipStatus(statusCode, false);
+        ESP_LOGD(TAG, "Write values to address " HEX_FMT " statusCode " HEX_FMT, address, statusCode);
     }
 
-    byte CC1101Device::getWireWoundInductorPower(int outputPower, const byte *currentTable, int currentTableLen)
+    byte CC1101Device::sendStrobe(byte strobeCmd)
     {
-        byte paSetting;
-        assert(currentTableLen == 10);
-        if (outputPower <= -30)
-        {
-            paSetting = currentTable[0];
-        }
-        else if (outputPower <= -20)
-        {
-            paSetting = currentTable[1];
-        }
-        else if (outputPower <= -15)
-        {
-            paSetting = currentTable[2];
-        }
-        else if (outputPower <= -10)
-        {
-            paSetting = currentTable[3];
-        }
-        else if (outputPower <= -6)
+        byte outStatus = 0;
+        if (m_compilingProfile)
         {
-            paSetting = currentTable[4];
+            return outStatus;
         }
-        else if (outputPower <= 0)
+        if (!m_spiMaster->WriteByte(strobeCmd, outStatus))
         {
-            paSetting = currentTable[5];
+            recordError(m_spiMaster->LastError());
+            return outStatus;
         }
-        else if (outputPower <= 5)
+        noteChipStatus(outStatus, (strobeCmd & kSpiHeaderReadBit) != 0);
+
+        return outStatus;
+    }
+    void CC1101Device::noteChipStatus(byte status, bool readAccess)
+    {
+        m_chipStatus = ChipStatus::Decode(status, readAccess);
+    }
+    // Polls with SNOP, a one byte transaction, instead of reading MARCSTATE. Meant to follow the strobe that leads to
+    // state: that strobe's status byte shows the state the chip was in, and if that already was state the strobe
+    // didn't move it, so no poll is needed.
+    bool CC1101Device::waitForChipState(StatusByteStateMachineMode state, int maxPolls)
+    {
+        for (int polls = 0; m_chipStatus.State != state; polls++)
         {
-            paSetting = currentTable[6];
+            if (polls == maxPolls)
+            {
+                return false;
+            }
+            if (polls > 0)
+            {
+                delayMicroseconds(20);
+            }
+            sendStrobe(CC1101_CONFIG::SNOP);
         }
-        else if (outputPower <= 7)
+        return true;
+    }
+
+    // Fills m_PATABLE for the requested power from one band's table. Without a ramp only the entry PA_POWER points
+    // at matters; with one, entries 0..7 go from off to the output power following the ramp shape.
+    template <size_t N>
+    void CC1101Device::fillPATable(const ConfigValues::PaPowerSetting (&table)[N], int outputPower)
+    {
+        byte          paSetting = ConfigValues::PaSettingAtLeast(table, outputPower);
+        const int8_t *rampDb    = nullptr;
+
+        switch (m_deviceConfig.PowerRamp)
         {
-            paSetting = currentTable[7];
+            case PaRampShape::None:
+                // ASK always uses index 0 PATABLE to transmit a 0;
+                if (m_deviceConfig.Modulation == ModulationType::ASK_OOK)
+                {
+                    m_PATABLE[0] = 0;
+                    m_PATABLE[1] = paSetting;
+                }
+                else
+                {
+                    m_PATABLE[0] = paSetting;
+                    m_PATABLE[1] = 0;
+                }
+                return;
+            case PaRampShape::Linear:
+                rampDb = ConfigValues::PA_RAMP_LINEAR_DB;
+                break;
+            case PaRampShape::RaisedCosine:
+                rampDb = ConfigValues::PA_RAMP_RAISED_COSINE_DB;
+                break;
         }
-        else if (outputPower <= 10)
+        // The top entry is exactly what the unshaped setting would be, the steps below it are the nearest rows
+        m_PATABLE[0] = 0;
+        for (int i = 1; i < 7; i++)
         {
-            paSetting = currentTable[8];
+            m_PATABLE[i] = ConfigValues::PaSettingNearest(table, std::min(outputPower, (int)table[N - 1].Dbm) + rampDb[i]);
         }
-        else
+        m_PATABLE[7] = paSetting;
+    }
+
+    byte CC1101Device::paPowerIndex(ModulationType modulationType) const
+    {
+        if (m_deviceConfig.PowerRamp != PaRampShape::None)
         {
-            paSetting = currentTable[9];
+            return 7;
         }
-        return paSetting;
+        // For ASK_OOK we point to PATABLE[1], because ASK always uses PATABLE[0] for transmitting '0'
+        return modulationType == ModulationType::ASK_OOK ? 1 : 0;
     }
 
     void CC1101Device::configure()
     {
-        byte statusCode = 0;
         byte pktctrlVal = (byte)(((int)m_deviceConfig.PacketFmt << 4 | (int)m_deviceConfig.PacketLengthCfg));
 
+        // IOCFG0..2
+        writeGdoConfig(GdoPin::GDO0, resolveGdoRole(GdoPin::GDO0));
+        writeGdoConfig(GdoPin::GDO2, resolveGdoRole(GdoPin::GDO2));
+        if (m_deviceConfig.Gdo1Role != GdoRole::Auto)
+        {
+            writeGdoConfig(GdoPin::GDO1, m_deviceConfig.Gdo1Role);
+        }
+
         // Set PKTCTRL0
         switch (m_deviceConfig.PacketFmt)
         {
             case PacketFormat::Normal:
-                handleCommonStatusCodes(statusCode, false);
-                statusCode = writeRegister(CC1101_CONFIG::IOCFG0, (byte)ConfigValues::GDx_CFG_LowerSixBits::RX_FIFO_ABOVE_THRESHOLD);
-                handleCommonStatusCodes(statusCode, false);
-                statusCode = writeRegister(CC1101_CONFIG::IOCFG2, (byte)ConfigValues::GDx_CFG_LowerSixBits::CHIP_RDY_N);
-                handleCommonStatusCodes(statusCode, false);
                 ESP_LOGD(TAG, "%s: Writing PKTCTRL0 " HEX_FMT " for Packet format %d", __FUNCTION__, pktctrlVal, (int)m_deviceConfig.PacketFmt);
-                statusCode = writeRegister(CC1101_CONFIG::PKTCTRL0, pktctrlVal);
+                (void)writeRegister(CC1101_CONFIG::PKTCTRL0, pktctrlVal);
 
                 // why?
                 SetDataRate(11, 0xF8);
                 break;
             case PacketFormat::AsyncSerialMode:
                 {
-                    statusCode = writeRegister(CC1101_CONFIG::IOCFG0, (byte)ConfigValues::GDx_CFG_LowerSixBits::SERIAL_DATA_OUTPUT);
-                    handleCommonStatusCodes(statusCode, false);
-                    statusCode = writeRegister(CC1101_CONFIG::IOCFG2, (byte)ConfigValues::GDx_CFG_LowerSixBits::SERIAL_DATA_OUTPUT);
-                    handleCommonStatusCodes(statusCode, false);
                     ESP_LOGD(TAG, "%s: Writing PKTCTRL0 " HEX_FMT " for Packet format " HEX_FMT " length cfg " HEX_FMT, __FUNCTION__, pktctrlVal, (int)m_deviceConfig.PacketFmt, (int)m_deviceConfig.PacketLengthCfg);
-                    statusCode = writeRegister(CC1101_CONFIG::PKTCTRL0, pktctrlVal);
-                    handleCommonStatusCodes(statusCode, false);
+                    (void)writeRegister(CC1101_CONFIG::PKTCTRL0, pktctrlVal);
 
                     // from SmartRF Studio
                     SetDataRate(5, 0x83);
@@ -1093,117 +2619,88 @@ namespace TI_CC1101
         SetCRCAutoFlush(m_deviceConfig.EnableCRCAutoflush);
         SetAddressCheck(m_deviceConfig.AddressCheck);
         SetAppendStatus(m_deviceConfig.EnableAppendStatusBytes);
+        SetCRC(m_deviceConfig.EnableCRC);
+        SetSyncWord(m_deviceConfig.SyncWord);
+        SetPreambleLength(m_deviceConfig.Preamble);
+        SetDeviceAddress(m_deviceConfig.DeviceAddress);
+        SetPreambleQualityThreshold(m_deviceConfig.PreambleQualityThreshold);
+        SetWhitening(m_deviceConfig.EnableWhitening);
+        SetFEC(m_deviceConfig.EnableFEC);
+        (void)writeRegister(CC1101_CONFIG::PKTLEN, m_deviceConfig.PacketLength);
+        SetCCAMode(m_deviceConfig.ClearChannelMode);
+        SetCarrierSenseThreshold(m_deviceConfig.CarrierSenseThresholdDb);
 
     }
     // Below are from SmartRF Studio
     void CC1101Device::regConfig()
     {
-        byte returnValue = 0;
-
-        returnValue = writeRegister(CC1101_CONFIG::FSCTRL1, 0x06);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::MDMCFG0, 0xF8);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::MDMCFG1, 0x0);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::CHANNR, 0);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::DEVIATN, 0x15);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::FREND1, 0x56);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::MCSM0, 0x18);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::FOCCFG, 0x16);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::WORCTRL, 0xFB);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::BSCFG, 0x6C);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::AGCCTRL2, 0x03);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::AGCCTRL1, 0x40);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::AGCCTRL0, 0x91);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::FSCAL3, 0xE9);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::FSCAL2, 0x2A);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::FSCAL1, 0x00);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::FSCAL0, 0x1F);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::FSTEST, 0x59);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::TEST2, 0x88);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::TEST1, 0x31);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::FIFOTHR, 0x07);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::TEST0, 0x09);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::PKTCTRL1, 0x04);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::ADDR, 0x00);
-        handleCommonStatusCodes(returnValue, false);
-        returnValue = writeRegister(CC1101_CONFIG::PKTLEN, 0xFF);
-        handleCommonStatusCodes(returnValue, false);
-    }
-    void CC1101Device::handleCommonStatusCodes(byte status, bool wasReadOperation)
-    {
-        byte                       fifoBytesAvail = status & 0x0F;
-        byte                       statusBits     = status & 0b01110000;
-        StatusByteStateMachineMode machineState   = static_cast<StatusByteStateMachineMode>(statusBits >> 4);
-
-        if ((machineState == StatusByteStateMachineMode::FIFOOverflowRX) && (fifoBytesAvail > 0))
-        {
-            ESP_LOGD(TAG, "%s statusCode " HEX_FMT ", fifo bytes available " HEX_FMT , __FUNCTION__, status, fifoBytesAvail);
-        }
-        switch (machineState)
-        {
-            // RX_FIFO overflow
-            case StatusByteStateMachineMode::FIFOOverflowRX:
-                {
-                    byte fifoBytes[fifoBytesAvail];
-                    readRXFIFO(fifoBytes, fifoBytesAvail);
-                }
-                break;
-            case StatusByteStateMachineMode::FIFOOverflowTX:
-                break;
-            case StatusByteStateMachineMode::ReceiveMode:
-                {
-                    if ((fifoBytesAvail > 0) && wasReadOperation)
-                    {
-                        byte fifoBytes[fifoBytesAvail];
-                        readRXFIFO(fifoBytes, fifoBytesAvail);
-                    }
-                }
-                break;
-            case StatusByteStateMachineMode::IDLE:
-                break;
-            default:
-                ESP_LOGD(TAG, "%s status code not handled was " HEX_FMT, __FUNCTION__, status);
-                break;
-        }
+
+        (void)writeRegister(CC1101_CONFIG::FSCTRL1, 0x06);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG0, 0xF8);
+        (void)writeRegister(CC1101_CONFIG::MDMCFG1, 0x0);
+        (void)writeRegister(CC1101_CONFIG::CHANNR, 0);
+        (void)writeRegister(CC1101_CONFIG::DEVIATN, 0x15);
+        (void)writeRegister(CC1101_CONFIG::FREND1, 0x56);
+        (void)writeRegister(CC1101_CONFIG::MCSM0, 0x18);
+        (void)writeRegister(CC1101_CONFIG::FOCCFG, 0x16);
+        (void)writeRegister(CC1101_CONFIG::WORCTRL, 0xFB);
+        (void)writeRegister(CC1101_CONFIG::BSCFG, 0x6C);
+        (void)writeRegister(CC1101_CONFIG::AGCCTRL2, 0x03);
+        (void)writeRegister(CC1101_CONFIG::AGCCTRL1, 0x40);
+        (void)writeRegister(CC1101_CONFIG::AGCCTRL0, 0x91);
+        (void)writeRegister(CC1101_CONFIG::FSCAL3, 0xE9);
+        (void)writeRegister(CC1101_CONFIG::FSCAL2, 0x2A);
+        (void)writeRegister(CC1101_CONFIG::FSCAL1, 0x00);
+        (void)writeRegister(CC1101_CONFIG::FSCAL0, 0x1F);
+        (void)writeRegister(CC1101_CONFIG::FSTEST, 0x59);
+        (void)writeRegister(CC1101_CONFIG::TEST2, 0x88);
+        (void)writeRegister(CC1101_CONFIG::TEST1, 0x31);
+        (void)writeRegister(CC1101_CONFIG::FIFOTHR, 0x07);
+        (void)writeRegister(CC1101_CONFIG::TEST0, 0x09);
+        (void)writeRegister(CC1101_CONFIG::PKTCTRL1, 0x04);
+        (void)writeRegister(CC1101_CONFIG::ADDR, 0x00);
+        (void)writeRegister(CC1101_CONFIG::PKTLEN, 0xFF);
     }
-#ifndef ARDUINO
-    void IRAM_ATTR CC1101Device::gpioISR(void *thisPtr)
+    void IRAM_ATTR CC1101Device::gdoISR(void *context)
     {
-        CC1101Device *That   = static_cast<CC1101Device *>(thisPtr);
-        uint32_t      ignore = 0;
-        xQueueSendFromISR(That->m_ISRQueueHandle, (void *)&ignore, NULL);
-    }
+        GdoInterruptContext *gdoContext              = static_cast<GdoInterruptContext *>(context);
+        CC1101Device        *device                  = gdoContext->Device;
+        BaseType_t           higherPriorityTaskWoken = pdFALSE;
+        uint32_t             nowMicros               = micros();
+#ifndef ARDUINO
+        uint8_t level = (uint8_t)gpio_get_level(gdoContext->Pin);
 #else
-    void IRAM_ATTR CC1101Device::gpioISR()
-    {
-        if(snm_thisPtr != nullptr)
+        uint8_t level = (uint8_t)digitalRead(gdoContext->Pin);
+#endif
+        uint32_t events = level ? gdoContext->RisingEvents : gdoContext->FallingEvents;
+
+        if (device == nullptr)
+        {
+            return;
+        }
+        gdoContext->EdgeCount++;
+        if (gdoContext->CaptureEdges)
+        {
+            device->m_edgeRing.PushFromISR({nowMicros, level}, &higherPriorityTaskWoken);
+        }
+        if (events & GdoEvents::SyncWordDetected)
+        {
+            device->m_syncTimestampMicros.store(nowMicros, std::memory_order_relaxed);
+        }
+        if (events != 0)
+        {
+            // Only the first event after the task drained the mask needs a wakeup, the rest coalesce
+            uint32_t previous = device->m_pendingEvents.fetch_or(events, std::memory_order_release);
+            if (previous == 0 && device->m_eventTask != nullptr)
+            {
+                vTaskNotifyGiveFromISR(device->m_eventTask, &higherPriorityTaskWoken);
+            }
+        }
+        if (higherPriorityTaskWoken == pdTRUE)
         {
-            snm_thisPtr->m_dataReceived = true;
+            portYIELD_FROM_ISR();
         }
     }
-#endif
 
 
 } // namespace TI_CC1101
\ No newline at end of file
@@ -17,41 +17,167 @@
 #include <driver/spi_master.h>
 #include <driver/gpio.h>
 #endif
+#include <atomic>
 #include <vector>
 #include <memory>
+#include <string>
 #include "CC1101Lib.h"
+#include "RadioSnapshot.h"
+#include "PacketCodec.h"
+#include "RfCapture.h"
+#include "PulseDecoder.h"
+#include "PulseFilter.h"
+#include "RadioResult.h"
+#include "SpscRing.h"
+#include "AsyncRadio.h"
 
 
 namespace TI_CC1101
 {
     class SpiMaster;
-#ifdef ARDUINO
-    typedef void* QueueHandle_t;
-#endif
+    class CC1101Device;
+    class CaptureStreamer;
 
     struct CC110DeviceConfig
     {
-        gpio_num_t                TxPin;
-        gpio_num_t                RxPin;
+        gpio_num_t                TxPin; // wired to GDO0
+        gpio_num_t                RxPin; // wired to GDO2
         float                     OscillatorFrequencyMHz{26};
         float                     CarrierFrequencyMHz{433.62};
         float                     ReceiveFilterBandwidthKHz{812.5};
         float                     FrequencyDeviationKhz{47.6};
         int                       TxPower{10}; // Also called Output Power in the datasheet
+        PaRampShape               PowerRamp{PaRampShape::None}; // shaped ASK / FSK ramp-up and ramp-down through all 8 PATABLE entries
         ModulationType            Modulation{ModulationType::ASK_OOK};
         bool                      ManchesterEnabled{true};
         PacketFormat              PacketFmt{PacketFormat::AsyncSerialMode};      // this field and PacketlengthCfg go into the PKTCTRL0 register, pg 74
         PacketLengthConfig        PacketLengthCfg{PacketLengthConfig::Infinite}; // Currently, there are some harcoded side-effects in configure(). TODO figure out why
         bool                      DisableDCFilter{true};
         bool                      EnableCRC{false};
-        bool                      EnableCRCAutoflush{false};
+        bool                      EnableCRCAutoflush{false}; // needs CRC and a packet that fits in the RX FIFO
         SyncWordQualifierMode     SyncMode{SyncWordQualifierMode::NoPreambleOrSync_CarrierSenseAboveThreshold};
-        AddressCheckConfiguration AddressCheck{AddressCheckConfiguration::None};
+        AddressCheckConfiguration AddressCheck{AddressCheckConfiguration::None}; // also selects the broadcast addresses
+        // Packet framing. Only used by the packet handler, i.e. PacketFormat::Normal
+        uint16_t                  SyncWord{0xD391};                        // SYNC1:SYNC0
+        PreambleLength            Preamble{PreambleLength::Bytes2};        // regConfig() has always written 0 to MDMCFG1
+        byte                      DeviceAddress{0};                        // ADDR, compared against the first byte after the length byte
+        byte                      PreambleQualityThreshold{0};             // PKTCTRL1.PQT, 0..7. Sync word is only accepted when PQI >= 4 * PQT
+        byte                      PacketLength{0xFF};                      // PKTLEN. Fixed length, or maximum length in variable mode
+        bool                      EnableWhitening{false};                  // PKTCTRL0.WHITE_DATA, PN9 whitening
+        bool                      EnableFEC{false};                        // MDMCFG1.FEC_EN, convolutional FEC + interleaving. Fixed length only
         bool                      EnableAppendStatusBytes{false};
+        bool                      UseWarmBootSnapshot{false}; // restore registers and calibration from NVS in Init() when the config hash matches
+        GdoRole                   Gdo0Role{GdoRole::Auto};
+        GdoRole                   Gdo1Role{GdoRole::Auto};
+        GdoRole                   Gdo2Role{GdoRole::Auto};
+        CcaMode                   ClearChannelMode{CcaMode::RssiBelowThresholdUnlessReceivingPacket};
+        int                       CarrierSenseThresholdDb{0}; // AGCCTRL1.CARRIER_SENSE_ABS_THR, relative to MAGN_TARGET, -7..7
+
+        void     DebugDump();
+        uint32_t Hash() const;
+        bool     Validate() const;
+
+        // How to encode/decode frames in software the same way the packet handler does
+        PacketCodecOptions CodecOptions() const { return {PacketLengthCfg, EnableCRC, EnableWhitening, EnableFEC}; }
+    };
+
+    // A fully resolved register image for one radio configuration. Built once by RegisterProfile()
+    // so that switching between protocols does not need to go through Reset/regConfig/configure again.
+    struct RadioProfile
+    {
+        std::string       Name;
+        CC110DeviceConfig Config;
+        float             CarrierFrequencyMHz; // after clamping by SetFrequencyMHz()
+        byte              Registers[CC1101_CONFIG::kNumConfigRegisters];
+        byte              PATable[8];
+    };
+
+    enum class GdoPin : uint8_t
+    {
+        GDO0 = 0,
+        GDO1 = 1, // shared with SO, so it can only signal while CSn is high
+        GDO2 = 2
+    };
+
+    // Bits set by the GDO interrupt handlers and handed to the task by TakeEvents().
+    // The raw per-pin bits are for AttachGdoInterrupt() callers. SetGdoRole() uses the role bits.
+    namespace GdoEvents
+    {
+        const uint32_t Gdo0Rising  = 1 << 0;
+        const uint32_t Gdo0Falling = 1 << 1;
+        const uint32_t Gdo1Rising  = 1 << 2;
+        const uint32_t Gdo1Falling = 1 << 3;
+        const uint32_t Gdo2Rising  = 1 << 4;
+        const uint32_t Gdo2Falling = 1 << 5;
+
+        const uint32_t SyncWordDetected     = 1 << 8;
+        const uint32_t PacketEnd            = 1 << 9;
+        const uint32_t CrcOk                = 1 << 10;
+        const uint32_t ChannelClear         = 1 << 11;
+        const uint32_t ChannelBusy          = 1 << 12;
+        const uint32_t CarrierSensed        = 1 << 13;
+        const uint32_t CarrierLost          = 1 << 14;
+        const uint32_t RxFifoThreshold      = 1 << 15;
+        const uint32_t TxFifoBelowThreshold = 1 << 16;
+        const uint32_t PreambleQuality      = 1 << 17;
+
+        // Any of these means there are bytes to drain from the RX FIFO
+        const uint32_t RxDataReady = PacketEnd | CrcOk | RxFifoThreshold;
+    } // namespace GdoEvents
+
+    // Per-pin state handed to the GPIO ISR, so the ISR never needs a global device pointer
+    struct GdoInterruptContext
+    {
+        CC1101Device *Device        = nullptr;
+        gpio_num_t    Pin           = (gpio_num_t)-1;
+        uint32_t      RisingEvents  = 0;
+        uint32_t      FallingEvents = 0;
+        bool          CaptureEdges  = false; // also push a PulseEdge for every edge (data line in async serial mode)
+        uint32_t      EdgeCount     = 0;
+    };
+
+    // The steps Recover() escalates through, cheapest first
+    enum class RecoveryStage : byte
+    {
+        FlushAndRestart = 0, // SIDLE, SFRX (SFTX after an underflow), SRX
+        RewriteRegisters,    // once PARTNUM/VERSION read back: SIDLE, register image and PATABLE from the shadow, SRX
+        Reset,               // SRES, register image, SRX
+        Count
+    };
+
+    struct RecoveryStageStats
+    {
+        uint32_t Attempts;
+        uint32_t Successes;
+        uint32_t LastMicros;
+        uint32_t MaxMicros;
+    };
 
-        QueueHandle_t InterruptQueue;
+    // What the health watchdog and Recover() have seen so far. Each recovery stops at the first stage that gets the
+    // chip back into RX, so the per-stage counters show how deep errors go.
+    struct RecoveryStats
+    {
+        uint32_t           HealthChecks;
+        uint32_t           Errors;     // errors handed to Recover(), from the watchdog or otherwise
+        uint32_t           Failures;   // no stage worked
+        uint32_t           LastMicros; // how long the last recovery took, all stages
+        uint32_t           MaxMicros;
+        RadioError         LastError;
+        RecoveryStageStats Stages[(int)RecoveryStage::Count];
+    };
+
+    enum class TransmitResult
+    {
+        Sent,
+        ChannelBusy, // CCA kept the chip in RX. The frame is still in the TX FIFO.
+        Failed
+    };
 
-        void DebugDump();
+    // One edge on the RX data line, as seen by the GPIO ISR
+    struct PulseEdge
+    {
+        uint32_t TimestampMicros;
+        uint8_t  Level; // level after the edge
     };
     class CC1101Device final
     {
@@ -73,28 +199,113 @@ namespace TI_CC1101
         const byte kSpiNoBurstAccessMask   = 0b10111111; // No. 2 MSB is burst bit
         const byte kSpiBurstAccessBit      = 0b01000000; // OR this to set burst bit on
         const byte kRxFifoByteCountMask    = 0b01111111; // High bit is overflow, pg 94
+        const byte kPktStatusCarrierSense  = 0b01000000; // PKTSTATUS.CS, pg 94
 
         // Pg 92 of datasheet
         const byte kPartNumber  = 0x0;
         const byte kChipVersion = 0x14;
 
-        QueueHandle_t m_ISRQueueHandle;
-        volatile bool m_dataReceived = true;
+        // Sized for a few hundred ms of OOK edges between Update() calls
+        static const size_t                kEdgeRingSize = 256;
+        SpscRing<PulseEdge, kEdgeRingSize> m_edgeRing;
+
+        GdoInterruptContext   m_gdoContexts[3];
+        std::atomic<uint32_t> m_pendingEvents{0};
+        std::atomic<uint32_t> m_syncTimestampMicros{0};
+        TaskHandle_t          m_eventTask = nullptr;
+        GdoRole               m_gdoRoles[3] = {GdoRole::Auto, GdoRole::Auto, GdoRole::Auto};
+        CaptureStreamer      *m_captureStreamer = nullptr;
+        PulseDecoderBank     *m_pulseDecoders   = nullptr;
+        PulseFilter          *m_pulseFilter     = nullptr;
+        PulseEdge             m_lastEdge{};
+        bool                  m_haveEdge = false;
+        bool                  m_asyncTransmitting = false;
+
+        // Fixed or variable length packet being drained from the RX FIFO. The FIFO threshold fires mid-packet too, so a
+        // packet can take several Update() rounds. Appended status bytes are the last two bytes of the packet.
+        static const int kMaxRxPacketLength = 1 + 255 + 2;
+        byte             m_rxPacket[kMaxRxPacketLength];
+        int              m_rxPacketLength   = 0; // bytes read so far
+        int              m_rxPacketExpected = 0; // length byte, payload and status bytes. 0 until known
+
+        // Shadow of what we last wrote to the configuration registers and PATABLE. Used to compute the delta
+        // when switching profiles, and as the target of writes while a profile is being compiled.
+        byte                      m_registerShadow[CC1101_CONFIG::kNumConfigRegisters];
+        byte                      m_PATABLEShadow[8]  = {0, 0, 0, 0, 0, 0, 0, 0};
+        uint32_t                  m_PATABLEWrites     = 0; // see PATableGeneration()
+        bool                      m_compilingProfile  = false;
+        std::vector<RadioProfile> m_profiles;
+        int                       m_activeProfile     = -1;
+        // State at BeginAsyncConfig(), put back if SubmitAsyncConfig() couldn't queue anything
+        RadioProfile              m_asyncConfigBase;
+        PATables                  m_asyncConfigPATableBand = PATables::PA_433;
+
+        // Calibration results, saved with the snapshot. See CalibrateChannels()
+        ChannelCalibration m_channelCalibration[RadioSnapshot::kMaxCalibratedChannels];
+        int                m_calibratedChannelCount = 0;
+        int8_t             m_frequencyOffset        = 0;
+        // MCSM0.FS_AUTOCAL. After a warm boot with saved calibration it is 0 (manual), see RestoreSnapshot()
+        static const byte kFsAutocalMask     = 0b00110000;
+        static const byte kFsAutocalFromIdle = 0b00010000; // what regConfig() writes
+
+        // RSSI offset for 433 MHz, Table 31 (pg 44)
+        const int kRssiOffsetDb = 74;
+        // TX FIFO is 64 bytes, one goes to the length byte in variable length mode
+        static constexpr int kTxFifoSize = 64;
+        static constexpr int kRxFifoSize = 64;
+        // Most registers readRegisters() chains under one CSn low. CheckHealth() reads 5.
+        static constexpr int kMaxChainedReads = 8;
+
+        // Writing a couple of unchanged registers is cheaper than starting a new burst (header byte + CS toggle)
+        const int kMaxProfileDeltaGap = 2;
 
-        static CC1101Device* snm_thisPtr;
+        // Recover(): how often to check that the chip answers before resetting it, and how long RX may take to come up
+        const int kRecoveryRetries   = 3;
+        const int kReceiveStatePolls = 100; // of 20us, calibration on the way into RX takes ~800us
+        const int kReceiveStrobes    = 3;   // SRX is only repeated while the chip still shows IDLE
+        // CheckHealth(): a state that isn't RX or TX has to be seen this many checks in a row to count as stuck
+        const int kStuckHealthChecks = 2;
+
+        RadioError    m_pendingError          = RadioError::None;
+        RecoveryStats m_recoveryStats         = {};
+        ChipStatus    m_chipStatus            = {}; // from the last SPI transaction
+        uint32_t      m_healthIntervalMicros  = 1'000'000;
+        uint32_t      m_silenceLimitMicros    = 0; // 0: a quiet band is not an error
+        uint32_t      m_lastHealthCheckMicros = 0;
+        uint32_t      m_lastActivityMicros    = 0;
+        int           m_stuckHealthChecks     = 0;
 
       public:
         CC1101Device();
         ~CC1101Device();
-        bool Init(std::shared_ptr<SpiMaster> &spiMaster, CC110DeviceConfig &deviceConfig);
-        void Reset();
-        bool BeginReceive();
-        void Update();
+        Result<void> Init(std::shared_ptr<SpiMaster> &spiMaster, CC110DeviceConfig &deviceConfig);
+        void         Reset();
+        Result<void> BeginReceive();
+        void         Update();
+
+        // SPI and chip errors are remembered (the first one wins) rather than asserted on. Update() hands them to
+        // Recover(); code driving the radio by other means can do the same.
+        RadioError           TakeError();
+        Result<void>         Recover(RadioError error);
+        const RecoveryStats &GetRecoveryStats() { return m_recoveryStats; }
+        // Update() calls CheckHealth() every intervalMillis (0 turns it off) and hands what it finds to Recover().
+        // silenceMillis > 0 also treats that long without an edge or FIFO byte as a stuck receiver.
+        void                 SetHealthWatchdog(uint32_t intervalMillis, uint32_t silenceMillis = 0);
+        RadioError           CheckHealth();
+
+        bool     AttachGdoInterrupt(GdoPin gdo, gpio_num_t pin, uint32_t risingEvents, uint32_t fallingEvents, bool captureEdges);
+        void     DetachGdoInterrupt(GdoPin gdo);
+        uint32_t TakeEvents() { return m_pendingEvents.exchange(0, std::memory_order_acquire); }
+        bool     WaitForEvents(TickType_t timeoutTicks);
+        bool     SetGdoRole(GdoPin gdo, GdoRole role);
+        GdoRole  GetGdoRole(GdoPin gdo) { return m_gdoRoles[(int)gdo]; }
+        uint32_t LastSyncMicros() { return m_syncTimestampMicros.load(std::memory_order_relaxed); }
         void SetFrequencyMHz(float frequencyMHz);
         void SetReceiveChannelFilterBandwidth(float bandwidthKHz);
         void SetDataRate(byte Exponent, byte Mantissa);
         void SetModemDeviation(float deviationKHz);
         void SetOutputPower(int outputPower);
+        void SetPowerRamp(PaRampShape shape);
         void SetModulation(ModulationType modulationType);
         void SetDigitalDCFilter(bool shouldDisable);
         void SetManchesterEncoding(bool shouldEnable);
@@ -104,13 +315,72 @@ namespace TI_CC1101
         void SetCRCAutoFlush(bool shouldEnable);
         void SetAddressCheck(AddressCheckConfiguration addressCheckConfig);
         void SetAppendStatus(bool shouldEnable);
+        void SetSyncWord(uint16_t syncWord);
+        void SetPreambleLength(PreambleLength preambleLength);
+        void SetDeviceAddress(byte address);
+        void SetPreambleQualityThreshold(byte threshold);
+        void SetWhitening(bool shouldEnable);
+        void SetFEC(bool shouldEnable);
 
         void DumpRegisters();
 
+        int                 RegisterProfile(const char *name, const CC110DeviceConfig &deviceConfig);
+        int                 FindProfile(const char *name);
+        bool                SwitchProfile(int profileId, uint32_t *outLatencyMicros = nullptr);
+        int                 ActiveProfile() { return m_activeProfile; }
+        const RadioProfile *GetProfile(int profileId);
+
+        // Set-style configuration without waiting on the bus. Between BeginAsyncConfig() and SubmitAsyncConfig() the
+        // Set* calls only change the shadow registers, the way RegisterProfile() compiles a profile; don't call
+        // anything else on the device in between. SubmitAsyncConfig() hands the result to radio.ApplyRegisters():
+        // SIDLE, the registers the chip doesn't hold yet, SRX if enterReceive. An invalid future means nothing was
+        // queued and the Set* calls are undone. If the operation fails the shadow is ahead of the chip, and
+        // Recover(radio.Error(future)) writes it.
+        //
+        // Everything else stays blocking: Init(), Reset(), BeginReceive() (it attaches the GDO interrupts),
+        // SetGdoRole(), SwitchProfile(), calibration and snapshots, transmitting, Recover() and CheckHealth(). Don't
+        // run them while radio has operations queued. DumpRegisters() has radio.DumpRegisters() instead.
+        void        BeginAsyncConfig();
+        RadioFuture SubmitAsyncConfig(AsyncRadio &radio, bool enterReceive, RadioOpCallback callback = nullptr, void *context = nullptr);
+
+        bool   CalibrateChannels(const byte *channels, int channelCount);
+        bool   SetChannel(byte channel);
+        int8_t LearnFrequencyOffset();
+        void   CaptureSnapshot(RadioSnapshot &snapshot);
+        bool   RestoreSnapshot(const RadioSnapshot &snapshot);
+        bool   SaveSnapshot();
+
+        void           SetCCAMode(CcaMode ccaMode);
+        void           SetCarrierSenseThreshold(int relativeDb);
+        int            ReadRSSIdBm();
+        int            RssiToDbm(byte rssi) const; // RSSI register or appended status byte
+        MarcState      ReadMarcState();
+        // Decoded status byte from the last SPI transaction. Costs nothing to look at; the driver's own state
+        // decisions use it instead of reading MARCSTATE.
+        ChipStatus     LastChipStatus() const { return m_chipStatus; }
+        // Changes whenever PATABLE in the chip is rewritten or reset, whoever did it
+        uint32_t       PATableGeneration() const { return m_PATABLEWrites; }
+        TransmitResult TryTransmit(const byte *data, int length, uint32_t timeoutMicros);
+        void           FlushTxFifo();
+        // Asynchronous serial TX: in PacketFormat::AsyncSerialMode the chip modulates whatever is on GDO0. The chip
+        // stays in TX from BeginAsyncTransmit() to EndAsyncTransmit(), and TxPin belongs to TransmitPulses() meanwhile.
+        // EndAsyncTransmit() returns false if GDO0's interrupt couldn't be attached again, RX is then deaf to it.
+        bool           BeginAsyncTransmit();
+        void           TransmitPulses(std::span<const Pulse> pulses);
+        bool           EndAsyncTransmit();
+
+        // Everything a capture needs to be replayed with the same settings: register image, PATABLE, frequency
+        void FillCaptureHeader(CaptureHeader &header);
+        // Update() feeds received edges and FIFO contents to this streamer. nullptr to stop.
+        void SetCaptureStreamer(CaptureStreamer *streamer) { m_captureStreamer = streamer; }
+        // Update() runs received pulses through these decoders. nullptr to stop.
+        void SetPulseDecoders(PulseDecoderBank *decoders) { m_pulseDecoders = decoders; }
+        // Pulses go through this filter on their way to the decoders. The capture streamer still gets them raw.
+        void SetPulseFilter(PulseFilter *filter) { m_pulseFilter = filter; }
+
       protected:
-        void               lowerChipSelect();
-        void               raiseChipSelect();
-        void               waitForMisoLow();
+        bool               waitForMisoLow();
+        void               recordError(RadioError error);
         void               enableReceiveMode();
 #ifndef ARDUINO
         bool               digitalWrite(gpio_num_t pin, uint32_t value);
@@ -121,26 +391,41 @@ namespace TI_CC1101
         int                do_gpio_get_level(int pin) {return digitalRead(pin);}
 #endif
         void               delayMilliseconds(int millis);
+        void               setTxPinOutput(bool output);
+        void               waitUntilMicros(uint32_t deadlineMicros);
         [[nodiscard]] byte readRegister(byte address);
         bool               readBurstRegister(byte address, byte *buffer, int len);
         [[nodiscard]] byte writeRegister(byte address, byte value);
-        void               writeBurstRegister(byte address, byte *values, int valueLen);
+        void               writeBurstRegister(byte address, const byte *values, int valueLen);
         byte               sendStrobe(byte strobeCmd);
-        byte               getMultiLayerInductorPower(int outPower, const byte *currentTable, int currentTableLen);
-        byte               getWireWoundInductorPower(int outPower, const byte *currentTable, int currentTableLen);
+        template <size_t N>
+        void               fillPATable(const ConfigValues::PaPowerSetting (&table)[N], int outputPower);
+        byte               paPowerIndex(ModulationType modulationType) const;
 
         void               configure();
         void               regConfig();
 
-        void handleCommonStatusCodes(byte status, bool wasReadOperation);
-        void readRXFIFO(byte *buffer, int expectedCount); // will reset FIFO if overflowed.
+        void noteChipStatus(byte status, bool readAccess);
+        bool waitForChipState(StatusByteStateMachineMode state, int maxPolls);
+        bool txFrameFits(const byte *data, int length) const;
+        void drainRxFifo(byte rxBytes); // rxBytes is the RXBYTES register. Records RxFifoOverflow
+        void resetRxPacket() { m_rxPacketLength = m_rxPacketExpected = 0; }
 
         void setMDMCFG2();
+        void resetShadowRegisters();
+        GdoRole    resolveGdoRole(GdoPin gdo);
+        gpio_num_t gdoPinNumber(GdoPin gdo);
+        void       writeGdoConfig(GdoPin gdo, GdoRole role);
+        bool       attachGdoRoleInterrupt(GdoPin gdo, GdoRole role, bool &edgesCaptured);
+        bool       refreshGdoRoles();
+        size_t     edgesToPulses(const PulseEdge *edges, size_t edgeCount, Pulse *pulses, uint32_t &startMicros);
+        int  storeProfile(const RadioProfile &profile);
+        void recordBootProfile();
+        bool readRegisters(const byte *addresses, byte *values, int count);
+        bool recoveryStage(RecoveryStage stage, RadioError error);
+        bool tryWarmBoot();
+        void writeProfileDelta(const RadioProfile &profile);
 
-#ifndef ARDUINO
-        static void IRAM_ATTR gpioISR(void *);
-#else
-        static void IRAM_ATTR gpioISR();
-#endif
+        static void IRAM_ATTR gdoISR(void *context);
     };
 } // namespace TI_CC1101
\ No newline at end of file
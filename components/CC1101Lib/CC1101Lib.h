@@ -93,6 +93,9 @@ namespace TI_CC1101
         const byte TEST1    = 0x2D; // Various test settings
         const byte TEST0    = 0x2E; // Various test settings
 
+        // Number of configuration registers (IOCFG2 through TEST0). These can be written in a single burst
+        const byte kNumConfigRegisters = TEST0 + 1;
+
         // Table 44:Status Registers
         const byte PARTNUM        = 0x30; // Part number for CC1101
         const byte VERSION        = 0x31; // Current version number
@@ -185,14 +188,70 @@ namespace TI_CC1101
           CLK_XOSC_BY_192                               = 0x3F,//CLK_XOSC/192
       };
 
-      // Below correspond to power levels of -30,-20,-15,-10,0,5,7,10
+      // Table 39, optimum PATABLE settings per output power, in increasing dBm
+      struct PaPowerSetting
+      {
+          int8_t Dbm;
+          byte   Value;
+      };
       // Multi-layer inductors are used in the OEM reference design for 315 and 433 MHz
-      const byte PATABLE_315_SETTINGS[] = { 0x12, 0x0D, 0x1C, 0x34, 0x51, 0x85, 0xCB, 0xC2 };
-      const byte PATABLE_433_SETTINGS[] = { 0x12, 0x0E, 0x1D, 0x34, 0x60, 0x84, 0xC8, 0xC0 };
-      // Below correspond to power levels of -30,-20,-15,-10,-6,0,5,7,10,11
+      constexpr PaPowerSetting PATABLE_315_SETTINGS[] = { {-30, 0x12}, {-20, 0x0D}, {-15, 0x1C}, {-10, 0x34}, {0, 0x51}, {5, 0x85}, {7, 0xCB}, {10, 0xC2} };
+      constexpr PaPowerSetting PATABLE_433_SETTINGS[] = { {-30, 0x12}, {-20, 0x0E}, {-15, 0x1D}, {-10, 0x34}, {0, 0x60}, {5, 0x84}, {7, 0xC8}, {10, 0xC0} };
       // Wire-wound inductors are used in the OEM reference design for 868 and 915 MHz
-      const byte PATABLE_868_SETTINGS[] = { 0x03, 0x17, 0x1D, 0x26, 0x37, 0x50, 0x86, 0xCD, 0xC5, 0xC0 };
-      const byte PATABLE_915_SETTINGS[] = { 0x03, 0x0E, 0x1E, 0x27, 0x38, 0x8E, 0x84, 0xCC, 0xC3, 0xC0 };
+      constexpr PaPowerSetting PATABLE_868_SETTINGS[] = { {-30, 0x03}, {-20, 0x17}, {-15, 0x1D}, {-10, 0x26}, {-6, 0x37}, {0, 0x50}, {5, 0x86}, {7, 0xCD}, {10, 0xC5}, {11, 0xC0} };
+      constexpr PaPowerSetting PATABLE_915_SETTINGS[] = { {-30, 0x03}, {-20, 0x0E}, {-15, 0x1E}, {-10, 0x27}, {-6, 0x38}, {0, 0x8E}, {5, 0x84}, {7, 0xCC}, {10, 0xC3}, {11, 0xC0} };
+
+      // The register values aren't monotonic in power (0xC5 vs 0xC0, 0x8E vs 0x84), so a dBm value between two rows
+      // is resolved to one of the rows rather than to a value in between.
+      // The lowest row at or above the requested power, which is what SetOutputPower() has always picked.
+      template <size_t N>
+      constexpr byte PaSettingAtLeast(const PaPowerSetting (&table)[N], int dBm)
+      {
+          for (const PaPowerSetting &row : table)
+          {
+              if (dBm <= row.Dbm)
+              {
+                  return row.Value;
+              }
+          }
+          return table[N - 1].Value;
+      }
+      // The row closest in dBm, used for the intermediate steps of a ramp. Ties go to the lower power.
+      template <size_t N>
+      constexpr byte PaSettingNearest(const PaPowerSetting (&table)[N], int dBm)
+      {
+          size_t nearest = 0;
+          for (size_t i = 1; i < N; i++)
+          {
+              int distance        = table[i].Dbm > dBm ? table[i].Dbm - dBm : dBm - table[i].Dbm;
+              int nearestDistance = table[nearest].Dbm > dBm ? table[nearest].Dbm - dBm : dBm - table[nearest].Dbm;
+              if (distance < nearestDistance)
+              {
+                  nearest = i;
+              }
+          }
+          return table[nearest].Value;
+      }
+      static_assert(PaSettingAtLeast(PATABLE_433_SETTINGS, 10) == 0xC0 && PaSettingAtLeast(PATABLE_433_SETTINGS, 3) == 0x84 && PaSettingAtLeast(PATABLE_433_SETTINGS, 20) == 0xC0);
+      static_assert(PaSettingNearest(PATABLE_868_SETTINGS, -8) == 0x26 && PaSettingNearest(PATABLE_868_SETTINGS, -50) == 0x03);
+
+      // PA ramp profiles for the 8 PATABLE entries (section 24), in dB relative to the requested output power.
+      // Entry 0 is always the PA switched off: it is the '0' level in ASK and where an FSK ramp starts and ends.
+      // The amplitude follows the shape, i.e. entry i is 20*log10(a(i/7)).
+      const int8_t     PA_RAMP_OFF                 = INT8_MIN;
+      constexpr int8_t PA_RAMP_LINEAR_DB[8]        = { PA_RAMP_OFF, -17, -11, -7, -5, -3, -1, 0 };
+      constexpr int8_t PA_RAMP_RAISED_COSINE_DB[8] = { PA_RAMP_OFF, -26, -15, -8, -4, -2, 0, 0 };
+
+      // Table 43, reset values of the configuration registers IOCFG2 through TEST0, in address order.
+      // This is what the chip holds right after SRES.
+      const byte CONFIG_REGISTER_RESET_VALUES[CC1101_CONFIG::kNumConfigRegisters] = {
+          0x29, 0x2E, 0x3F, 0x07, 0xD3, 0x91, 0xFF, 0x04, // IOCFG2 .. PKTCTRL1
+          0x45, 0x00, 0x00, 0x0F, 0x00, 0x1E, 0xC4, 0xEC, // PKTCTRL0 .. FREQ0
+          0x8C, 0x22, 0x02, 0x22, 0xF8, 0x47, 0x07, 0x30, // MDMCFG4 .. MCSM1
+          0x04, 0x36, 0x6C, 0x03, 0x40, 0x91, 0x87, 0x6B, // MCSM0 .. WOREVT0
+          0xF8, 0x56, 0x10, 0xA9, 0x0A, 0x20, 0x0D, 0x41, // WORCTRL .. RCCTRL1
+          0x00, 0x59, 0x7F, 0x3F, 0x88, 0x31, 0x0B        // RCCTRL0 .. TEST0
+      };
 
   }
 
@@ -220,6 +279,16 @@ namespace TI_CC1101
       PA_915
   };
 
+  // How the PA is brought up to, and back down from, the output power. With anything but None all 8 PATABLE
+  // entries hold a ramp and FREND0.PA_POWER is 7, so the chip steps through them on every ASK bit edge and at the
+  // start and end of an FSK transmission. That keeps the spectrum narrower than switching the PA hard.
+  enum class PaRampShape : byte
+  {
+      None,        // PATABLE[0] (FSK) or PATABLE[0]=off/PATABLE[1] (ASK), as before
+      Linear,      // amplitude rises linearly
+      RaisedCosine // amplitude follows half a cosine, gentlest at both ends
+  };
+
   enum class ModulationType
   {
       FSK_2     = 0, // 2FSK
@@ -250,6 +319,73 @@ namespace TI_CC1101
       AdressCheck_Zero_And_FF_BroadCast = 3  // Address check and 0 (0x00) and 255 (0xFF) broadcast
   };
 
+  // MDMCFG1.NUM_PREAMBLE, bits 6:4 (pg 78). Minimum number of preamble bytes to be transmitted
+  enum class PreambleLength : byte
+  {
+      Bytes2  = 0,
+      Bytes3  = 1,
+      Bytes4  = 2, // reset value
+      Bytes6  = 3,
+      Bytes8  = 4,
+      Bytes12 = 5,
+      Bytes16 = 6,
+      Bytes24 = 7
+  };
+
+  // What a GDO pin is used for. Each role maps to a GDx_CFG value and to the events its edges raise, see CC1101Device::SetGdoRole()
+  enum class GdoRole : byte
+  {
+      Auto,             // whatever configure() picks for the packet format
+      Unused,           // high impedance
+      SerialData,       // async serial data out, every edge is captured as a pulse boundary
+      SyncWordDetected, // rises on sync word, falls at end of packet (or when the packet is discarded)
+      PacketEnd,        // rises when the RX FIFO reaches its threshold or the packet ends
+      CrcOk,            // rises when a packet with a good CRC is in the RX FIFO
+      ChannelClear,     // high while RSSI is below the CCA threshold
+      CarrierSense,     // high while RSSI is above the carrier sense threshold
+      RxFifoThreshold,  // rises when the RX FIFO is at or above FIFOTHR
+      TxFifoThreshold,  // falls when the TX FIFO drains below FIFOTHR
+      PreambleQuality,  // rises when PQI is above PQT
+      ChipReady         // CHIP_RDYn, no interrupt
+  };
+
+  // MCSM1.CCA_MODE, bits 5:4 (pg 81). Decides whether STX in RX actually goes to TX.
+  enum class CcaMode : byte
+  {
+      Always                                  = 0, // Always
+      RssiBelowThreshold                      = 1, // If RSSI below threshold
+      UnlessReceivingPacket                   = 2, // Unless currently receiving a packet
+      RssiBelowThresholdUnlessReceivingPacket = 3  // If RSSI below threshold unless currently receiving a packet (reset value)
+  };
+
+  // Table 32, MARCSTATE values (pg 93)
+  enum class MarcState : byte
+  {
+      SLEEP            = 0x00,
+      IDLE             = 0x01,
+      XOFF             = 0x02,
+      VCOON_MC         = 0x03,
+      REGON_MC         = 0x04,
+      MANCAL           = 0x05,
+      VCOON            = 0x06,
+      REGON            = 0x07,
+      STARTCAL         = 0x08,
+      BWBOOST          = 0x09,
+      FS_LOCK          = 0x0A,
+      IFADCON          = 0x0B,
+      ENDCAL           = 0x0C,
+      RX               = 0x0D,
+      RX_END           = 0x0E,
+      RX_RST           = 0x0F,
+      TXRX_SWITCH      = 0x10,
+      RXFIFO_OVERFLOW  = 0x11,
+      FSTXON           = 0x12,
+      TX               = 0x13,
+      TX_END           = 0x14,
+      RXTX_SWITCH      = 0x15,
+      TXFIFO_UNDERFLOW = 0x16
+  };
+
   enum class StatusByteStateMachineMode
   {
     IDLE = 0,
@@ -261,4 +397,25 @@ namespace TI_CC1101
     FIFOOverflowRX = 6,
     FIFOOverflowTX = 7
   };
+
+  // The chip status byte, clocked out on SO with every header byte (Section 10.1, Table 23). It shows the state
+  // before the header takes effect, so the byte that comes back with a strobe says where the chip was, not where
+  // the strobe sent it.
+  struct ChipStatus
+  {
+      bool                       ChipReady; // CHIP_RDYn, bit 7 low
+      StatusByteStateMachineMode State;     // bits 6:4
+      // Bits 3:0: bytes available in the RX FIFO when the header had the R/W bit set, bytes free in the TX FIFO
+      // otherwise. Both saturate at 15.
+      byte                       FifoBytes;
+      bool                       FifoIsRx;
+
+      static constexpr ChipStatus Decode(byte status, bool readAccess)
+      {
+          return {(status & 0x80) == 0, static_cast<StatusByteStateMachineMode>((status >> 4) & 0x07), (byte)(status & 0x0F), readAccess};
+      }
+  };
+  static_assert(ChipStatus::Decode(0x1F, true).State == StatusByteStateMachineMode::ReceiveMode, "state is in bits 6:4");
+  static_assert(ChipStatus::Decode(0x6F, false).State == StatusByteStateMachineMode::FIFOOverflowRX, "state is in bits 6:4");
+  static_assert(!ChipStatus::Decode(0x80, true).ChipReady && ChipStatus::Decode(0x1F, true).FifoBytes == 15, "CHIP_RDYn, FIFO bytes");
 } // namespace TI_CC1101
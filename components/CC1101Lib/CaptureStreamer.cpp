@@ -0,0 +1,156 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstring>
+#include "CaptureStreamer.h"
+
+static const char *TAG = "CaptureStreamer";
+
+namespace TI_CC1101
+{
+    bool CaptureStreamer::Start(CC1101Device &device, UBaseType_t taskPriority)
+    {
+        bool          bRet   = true;
+        CaptureHeader header = {};
+        size_t        length = 0;
+        TaskHandle_t  task   = nullptr;
+
+        CBRA(m_task == nullptr);
+
+        device.FillCaptureHeader(header);
+        m_lastRecordMicros = header.StartMicros;
+
+        length = CaptureEncoder::EncodeHeader(header, m_record);
+        length = CaptureFraming::Frame(m_record, length, m_frame);
+        CBRA(m_ring.PushBatch(std::span<const byte>(m_frame, length)));
+
+        m_running = true;
+        CBRA(xTaskCreate(streamTask, "cc1101capture", 3072, this, taskPriority, &task) == pdPASS);
+        m_task = task;
+        ESP_LOGI(TAG, "capture started");
+
+    Error:
+        if (!bRet)
+        {
+            m_running = false;
+        }
+        return bRet;
+    }
+
+    void CaptureStreamer::Stop()
+    {
+        if (m_task == nullptr)
+        {
+            return;
+        }
+        // The task drains what is left and clears m_task on its way out
+        m_running = false;
+        xTaskNotifyGive(m_task.load());
+        while (m_task != nullptr)
+        {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        ESP_LOGI(TAG, "capture stopped, %u records dropped", (unsigned)DroppedRecords());
+    }
+
+    void CaptureStreamer::AddPulses(uint32_t startMicros, std::span<const Pulse> pulses)
+    {
+        size_t length = 0;
+
+        if (m_task == nullptr)
+        {
+            return;
+        }
+        while (!pulses.empty())
+        {
+            std::span<const Pulse> chunk = pulses.first(std::min(pulses.size(), kMaxPulsesPerRecord));
+
+            length = CaptureEncoder::EncodePulses(startMicros - m_lastRecordMicros, chunk.data(), chunk.size(), m_record);
+            pushRecord(m_record, length, startMicros);
+            for (const Pulse &pulse : chunk)
+            {
+                startMicros += pulse.DurationMicros;
+            }
+            pulses = pulses.subspan(chunk.size());
+        }
+    }
+
+    void CaptureStreamer::AddFifoBlock(const byte *data, size_t length, byte rssi, byte lqiCrcOk)
+    {
+        uint32_t now = micros();
+
+        if (m_task == nullptr || length > 255)
+        {
+            return;
+        }
+        length = CaptureEncoder::EncodeFifoBlock(now - m_lastRecordMicros, data, length, rssi, lqiCrcOk, m_record);
+        pushRecord(m_record, length, now);
+    }
+
+    void CaptureStreamer::KeepAlive()
+    {
+        uint32_t now    = micros();
+        size_t   length = 0;
+
+        if (m_task == nullptr || now - m_lastRecordMicros < kKeepAliveMicros)
+        {
+            return;
+        }
+        length = CaptureEncoder::EncodePulses(now - m_lastRecordMicros, nullptr, 0, m_record);
+        pushRecord(m_record, length, now);
+    }
+
+    // Record deltas are relative to the last record that made it into the ring, so dropping one doesn't skew the
+    // timestamps of the ones after it
+    bool CaptureStreamer::pushRecord(const byte *record, size_t length, uint32_t timestampMicros)
+    {
+        size_t frameLength = CaptureFraming::Frame(record, length, m_frame);
+
+        if (!m_ring.PushBatch(std::span<const byte>(m_frame, frameLength)))
+        {
+            return false;
+        }
+        m_lastRecordMicros = timestampMicros;
+        return true;
+    }
+
+    void CaptureStreamer::streamTask(void *context)
+    {
+        CaptureStreamer *streamer = static_cast<CaptureStreamer *>(context);
+        byte             chunk[256];
+        size_t           length = 0;
+
+        streamer->m_ring.SetConsumerTask(xTaskGetCurrentTaskHandle());
+        while (streamer->m_running || !streamer->m_ring.Empty())
+        {
+            streamer->m_ring.WaitForData(pdMS_TO_TICKS(100));
+            while ((length = streamer->m_ring.PopBatch(chunk)) > 0)
+            {
+#ifdef ARDUINO
+                Serial.write(chunk, length);
+#else
+                fwrite(chunk, 1, length, stdout);
+#endif
+            }
+#ifndef ARDUINO
+            fflush(stdout);
+#endif
+        }
+        streamer->m_ring.SetConsumerTask(nullptr);
+        streamer->m_task = nullptr;
+        vTaskDelete(nullptr);
+    }
+} // namespace TI_CC1101
@@ -0,0 +1,65 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <span>
+#include "CC1101Device.h"
+#include "RfCapture.h"
+#include "SpscRing.h"
+
+namespace TI_CC1101
+{
+    // Streams what the radio sees, in the .cc1 capture format, over the serial console.
+    //
+    // The radio task (CC1101Device::Update()) encodes records and pushes them whole into a bounded ring. A low
+    // priority task drains the ring to stdout/Serial. When the link can't keep up, new records are dropped whole
+    // (DroppedRecords()) instead of blocking the radio task. Each record goes out in its own CaptureFraming frame so
+    // host/capture_replay can pull it out of the log output around it.
+    class CaptureStreamer
+    {
+      public:
+        static constexpr size_t   kBufferSize         = 8192;
+        static constexpr size_t   kMaxPulsesPerRecord = 64;
+        // Well inside the 71 minutes a 32 bit microsecond delta can hold
+        static constexpr uint32_t kKeepAliveMicros    = 60'000'000;
+        static constexpr size_t   kMaxRecordLength    = std::max(CaptureEncoder::MaxPulsesRecordLength(kMaxPulsesPerRecord), CaptureEncoder::MaxFifoRecordLength(255));
+
+        ~CaptureStreamer() { Stop(); }
+
+        // Reads the register image from the device for the header, then starts the output task
+        bool Start(CC1101Device &device, UBaseType_t taskPriority = 1);
+        void Stop();
+
+        // Producer side, called from the task that owns the radio
+        void AddPulses(uint32_t startMicros, std::span<const Pulse> pulses);
+        void AddFifoBlock(const byte *data, size_t length, byte rssi, byte lqiCrcOk);
+        // Writes an empty record when nothing has been written for kKeepAliveMicros, so record deltas never wrap
+        void KeepAlive();
+
+        uint32_t DroppedRecords() const { return m_ring.Overflows(); }
+
+      protected:
+        bool        pushRecord(const byte *record, size_t length, uint32_t timestampMicros);
+        static void streamTask(void *context);
+
+        SpscRing<byte, kBufferSize> m_ring;
+        std::atomic<TaskHandle_t>   m_task{nullptr};
+        std::atomic<bool>           m_running{false};
+        uint32_t                    m_lastRecordMicros = 0;
+        byte                        m_record[kMaxRecordLength];
+        byte                        m_frame[kMaxRecordLength + CaptureFraming::kOverhead];
+    };
+} // namespace TI_CC1101
@@ -1,5 +1,8 @@
 #pragma once
-#ifndef ARDUINO
+#if defined(CC1101_HOST)
+#include <stdio.h>
+#include <assert.h>
+#elif !defined(ARDUINO)
 #include <esp_log.h>
 #else
 #include <ArduinoLog.h>
@@ -12,7 +15,18 @@
 #define _DEBUG 1
 #endif
 
-#ifdef ARDUINO
+#if defined(CC1101_HOST)
+// Building the host side (codecs, replay tools) on a PC. Only the pieces that don't touch the radio compile here.
+#define ESP_LOGD(tg,fmt,...)    fprintf(stderr, "D %s: " fmt "\n", tg __VA_OPT__(,) __VA_ARGS__)
+#define ESP_LOGI(tg,fmt,...)    fprintf(stderr, "I %s: " fmt "\n", tg __VA_OPT__(,) __VA_ARGS__)
+#define ESP_LOGW(tg,fmt,...)    fprintf(stderr, "W %s: " fmt "\n", tg __VA_OPT__(,) __VA_ARGS__)
+#define ESP_LOGE(tg,fmt,...)    fprintf(stderr, "E %s: " fmt "\n", tg __VA_OPT__(,) __VA_ARGS__)
+#define ESP_OK 0
+
+#define IRAM_ATTR
+#define FLOAT_FMT "%g"
+#define HEX_FMT "0x%X"
+#elif defined(ARDUINO)
 #define ESP_LOGD(tg,fmt,...)    Log.traceln(fmt __VA_OPT__(,) __VA_ARGS__)
 #define ESP_LOGI(tg,fmt,...)    Log.noticeln(fmt __VA_OPT__(,) __VA_ARGS__)
 #define ESP_LOGW(tg,fmt,...)    Log.warningln(fmt __VA_OPT__(,) __VA_ARGS__) 
@@ -25,7 +39,9 @@
 #define FLOAT_FMT "%F"
 #define HEX_FMT "%X"
 #else
+#include <esp_timer.h>
 #define delayMicroseconds(micros) { esp_rom_delay_us(micros); }
+#define micros() ((uint32_t)esp_timer_get_time())
 #define FLOAT_FMT "%g"
 #define HEX_FMT "0x%X"
 #endif
@@ -0,0 +1,249 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include "PacketCodec.h"
+#include "PacketKernels.h"
+
+namespace TI_CC1101
+{
+    namespace
+    {
+        // DN504. Indexed by (3 bits of encoder state << 1) | input bit, gives the 2-bit output symbol
+        const byte kFecEncodeTable[16] = {0, 3, 1, 2, 3, 0, 2, 1, 3, 0, 2, 1, 0, 3, 1, 2};
+        const byte kFecTerminator      = 0x0B;
+
+        int bitCount2(byte symbol) { return (symbol & 1) + ((symbol >> 1) & 1); }
+    } // namespace
+
+    size_t PacketCodec::EncodedLength(size_t payloadLength) const
+    {
+        size_t length = payloadLength + (m_options.LengthCfg == PacketLengthConfig::Variable ? 1 : 0) + (m_options.Crc ? 2 : 0);
+        return m_options.Fec ? FecEncodedLength(length) : length;
+    }
+
+    size_t PacketCodec::Encode(const byte *payload, size_t payloadLength, byte *out, size_t outCapacity)
+    {
+        byte  *frame  = m_options.Fec ? m_frame : out;
+        size_t length = 0;
+
+        if (payloadLength > kMaxPayloadLength || EncodedLength(payloadLength) > outCapacity)
+        {
+            return 0;
+        }
+        if (m_options.LengthCfg == PacketLengthConfig::Variable)
+        {
+            frame[length++] = (byte)payloadLength;
+        }
+        memcpy(frame + length, payload, payloadLength);
+        length += payloadLength;
+        // CRC covers the length byte and the payload, and is computed before whitening
+        if (m_options.Crc)
+        {
+            uint16_t crc    = Crc16(frame, length);
+            frame[length++] = (byte)(crc >> 8);
+            frame[length++] = (byte)(crc & 0xFF);
+        }
+        if (m_options.Whitening)
+        {
+            Whiten(frame, length);
+        }
+        if (m_options.Fec)
+        {
+            length = FecEncode(frame, length, out);
+        }
+        return length;
+    }
+
+    int PacketCodec::Decode(const byte *encoded, size_t encodedLength, size_t payloadLength, byte *out, size_t outCapacity, bool &crcOk)
+    {
+        byte  *frame       = m_frame;
+        size_t frameLength = encodedLength;
+        size_t headerBytes = m_options.LengthCfg == PacketLengthConfig::Variable ? 1 : 0;
+        size_t crcBytes    = m_options.Crc ? 2 : 0;
+
+        crcOk = !m_options.Crc;
+        if (encodedLength > (m_options.Fec ? kMaxEncodedLength : kMaxFecInputLength))
+        {
+            return -1;
+        }
+        if (m_options.Fec)
+        {
+            // The chip only does FEC with fixed length, so the length is known up front
+            if (encodedLength < FecEncodedLength(payloadLength + crcBytes) || (encodedLength % 4) != 0)
+            {
+                return -1;
+            }
+            FecDecode(encoded, encodedLength, frame);
+            frameLength = encodedLength / 2;
+        }
+        else
+        {
+            memcpy(frame, encoded, encodedLength);
+        }
+        if (m_options.Whitening)
+        {
+            Whiten(frame, frameLength);
+        }
+        if (headerBytes != 0)
+        {
+            if (frameLength < 1)
+            {
+                return -1;
+            }
+            payloadLength = frame[0];
+        }
+        if (headerBytes + payloadLength + crcBytes > frameLength || payloadLength > outCapacity)
+        {
+            return -1;
+        }
+        if (m_options.Crc)
+        {
+            uint16_t crc      = Crc16(frame, headerBytes + payloadLength);
+            uint16_t received = (uint16_t)((frame[headerBytes + payloadLength] << 8) | frame[headerBytes + payloadLength + 1]);
+            crcOk             = crc == received;
+        }
+        memcpy(out, frame + headerBytes, payloadLength);
+        return (int)payloadLength;
+    }
+
+    void PacketCodec::Whiten(byte *data, size_t length)
+    {
+        PacketKernels::Pn9Whiten(data, length);
+    }
+
+    uint16_t PacketCodec::Crc16(const byte *data, size_t length, uint16_t crc)
+    {
+        return PacketKernels::Crc16(data, length, crc);
+    }
+
+    size_t PacketCodec::FecEncode(const byte *in, size_t length, byte *out)
+    {
+        size_t   inputLength = fecInputLength(length);
+        uint16_t fecReg      = 0;
+
+        for (size_t i = 0; i < inputLength; i++)
+        {
+            uint16_t fecOutput = 0;
+            byte     inputByte = i < length ? in[i] : kFecTerminator;
+
+            fecReg = (uint16_t)((fecReg & 0x700) | inputByte);
+            for (int bit = 0; bit < 8; bit++)
+            {
+                fecOutput = (uint16_t)((fecOutput << 2) | kFecEncodeTable[fecReg >> 7]);
+                fecReg    = (uint16_t)((fecReg << 1) & 0x7FF);
+            }
+            out[i * 2]     = (byte)(fecOutput >> 8);
+            out[i * 2 + 1] = (byte)(fecOutput & 0xFF);
+        }
+        for (size_t i = 0; i < inputLength * 2; i += 4)
+        {
+            interleave(out + i);
+        }
+        return inputLength * 2;
+    }
+
+    int PacketCodec::FecDecode(const byte *in, size_t encodedLength, byte *out)
+    {
+        size_t bits = encodedLength * 4; // one decoded bit per 2-bit symbol
+        int    metrics[kFecStates];
+        int    nextMetrics[kFecStates];
+        int    state      = 0;
+        int    bestMetric = 0;
+
+        memcpy(m_scratch, in, encodedLength);
+        for (size_t i = 0; i < encodedLength; i += 4)
+        {
+            deinterleave(m_scratch + i);
+        }
+
+        // The encoder starts in state 0
+        for (int s = 0; s < kFecStates; s++)
+        {
+            metrics[s] = s == 0 ? 0 : encodedLength * 8;
+        }
+        for (size_t n = 0; n < bits; n++)
+        {
+            byte symbol    = (m_scratch[n / 4] >> (6 - 2 * (n % 4))) & 0x03;
+            byte survivors = 0;
+
+            // State s is reached from (s >> 1) and (s >> 1) | 4, with input bit s & 1
+            for (int s = 0; s < kFecStates; s++)
+            {
+                int from0   = s >> 1;
+                int from1   = from0 | 4;
+                int metric0 = metrics[from0] + bitCount2(symbol ^ kFecEncodeTable[(from0 << 1) | (s & 1)]);
+                int metric1 = metrics[from1] + bitCount2(symbol ^ kFecEncodeTable[(from1 << 1) | (s & 1)]);
+
+                if (metric1 < metric0)
+                {
+                    nextMetrics[s] = metric1;
+                    survivors |= (byte)(1 << s);
+                }
+                else
+                {
+                    nextMetrics[s] = metric0;
+                }
+            }
+            m_survivors[n] = survivors;
+            memcpy(metrics, nextMetrics, sizeof(metrics));
+        }
+
+        // The terminator doesn't force a known end state, take the best one
+        for (int s = 1; s < kFecStates; s++)
+        {
+            if (metrics[s] < metrics[state])
+            {
+                state = s;
+            }
+        }
+        bestMetric = metrics[state];
+
+        memset(out, 0, encodedLength / 2);
+        for (size_t n = bits; n-- > 0;)
+        {
+            out[n / 8] |= (byte)((state & 1) << (7 - (n % 8)));
+            state = (state >> 1) | (((m_survivors[n] >> state) & 1) << 2);
+        }
+        return bestMetric;
+    }
+
+    // DN504: 4 bytes = 16 symbols, written column-wise into a 4x4 matrix and read out row-wise
+    void PacketCodec::interleave(byte *block)
+    {
+        uint32_t interleaved = 0;
+
+        for (int j = 0; j < 16; j++)
+        {
+            interleaved = (interleaved << 2) | ((block[~j & 0x03] >> (2 * ((j & 0x0C) >> 2))) & 0x03);
+        }
+        block[0] = (byte)(interleaved >> 24);
+        block[1] = (byte)(interleaved >> 16);
+        block[2] = (byte)(interleaved >> 8);
+        block[3] = (byte)(interleaved & 0xFF);
+    }
+
+    void PacketCodec::deinterleave(byte *block)
+    {
+        uint32_t interleaved = ((uint32_t)block[0] << 24) | ((uint32_t)block[1] << 16) | ((uint32_t)block[2] << 8) | block[3];
+
+        memset(block, 0, 4);
+        for (int j = 0; j < 16; j++)
+        {
+            byte symbol = (interleaved >> (2 * (15 - j))) & 0x03;
+            block[~j & 0x03] |= (byte)(symbol << (2 * ((j & 0x0C) >> 2)));
+        }
+    }
+} // namespace TI_CC1101
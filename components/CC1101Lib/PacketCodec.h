@@ -0,0 +1,84 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <stddef.h>
+#include "CC1101Lib.h"
+
+namespace TI_CC1101
+{
+    // What the packet handler does to a frame, mirrored from CC110DeviceConfig (PacketLengthCfg, EnableCRC,
+    // EnableWhitening, EnableFEC).
+    struct PacketCodecOptions
+    {
+        PacketLengthConfig LengthCfg{PacketLengthConfig::Fixed};
+        bool               Crc{true};
+        bool               Whitening{false};
+        bool               Fec{false};
+    };
+
+    // Software version of the CC1101 packet handler coding (Section 15), bit-exact with the chip:
+    //
+    //   TX: [length byte] payload [CRC16] -> PN9 whitening -> FEC encode + interleave
+    //   RX: the reverse.
+    //
+    // Used in the serial modes, where the chip hands over raw demodulated bits, and on the host to check captures
+    // against what the chip produced. Everything here is plain C++ and builds with CC1101_HOST.
+    //
+    // FEC follows TI design note DN504: rate 1/2, K = 4 convolutional code, a trellis terminator padding the input
+    // to an even number of bytes, and 4x4 interleaving of 2-bit symbols. Decoding is hard decision Viterbi.
+    class PacketCodec
+    {
+      public:
+        static const size_t kMaxPayloadLength = 255;
+        // length byte + payload + CRC, padded to even with the trellis terminator
+        static const size_t kMaxFecInputLength = kMaxPayloadLength + 5;
+        static const size_t kMaxEncodedLength  = kMaxFecInputLength * 2;
+
+        PacketCodec(const PacketCodecOptions &options) : m_options(options) {}
+
+        // Bytes on air (after the sync word) for a payload of this length
+        size_t EncodedLength(size_t payloadLength) const;
+        // Returns the number of bytes written to out, 0 if the payload doesn't fit
+        size_t Encode(const byte *payload, size_t payloadLength, byte *out, size_t outCapacity);
+        // encodedLength is what came in after the sync word. For fixed length, payloadLength is PKTLEN; it is
+        // ignored in variable length mode. Returns the payload length, or -1 if the frame is malformed.
+        // crcOk is set when CRC is enabled, true otherwise.
+        int Decode(const byte *encoded, size_t encodedLength, size_t payloadLength, byte *out, size_t outCapacity, bool &crcOk);
+
+        // PN9 whitening, x^9 + x^5 + 1 seeded with all ones. XORs in place, so it also dewhitens.
+        static void Whiten(byte *data, size_t length);
+        // CRC16 as computed by the chip: polynomial 0x8005, initial value 0xFFFF, MSB first, not reflected.
+        static uint16_t Crc16(const byte *data, size_t length, uint16_t crc = 0xFFFF);
+        // Appends the trellis terminator, encodes and interleaves. Returns FecEncodedLength(length).
+        static size_t FecEncode(const byte *in, size_t length, byte *out);
+        static size_t FecEncodedLength(size_t length) { return 2 * fecInputLength(length); }
+        // Deinterleaves and Viterbi decodes encodedLength bytes (a multiple of 4), writing encodedLength / 2 bytes,
+        // terminator included. Returns the number of bit errors corrected on the best path.
+        int FecDecode(const byte *in, size_t encodedLength, byte *out);
+
+      protected:
+        static size_t fecInputLength(size_t length) { return 2 * (length / 2 + 1); }
+        static void   interleave(byte *block);
+        static void   deinterleave(byte *block);
+
+        static const int kFecStates = 8;
+
+        PacketCodecOptions m_options;
+        byte               m_frame[kMaxFecInputLength]; // frame before FEC encoding / after FEC decoding
+        byte               m_scratch[kMaxEncodedLength]; // deinterleaved symbols
+        // one bit per state per decoded bit: which predecessor won
+        byte               m_survivors[kMaxFecInputLength * 8];
+    };
+} // namespace TI_CC1101
@@ -0,0 +1,311 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#define CC1101_HAVE_CLMUL 1
+#include <immintrin.h>
+#endif
+#if !defined(CC1101_HOST) && !defined(ARDUINO)
+#include <esp_cpu.h>
+#endif
+#include "PacketKernels.h"
+
+#if !defined(CC1101_HOST)
+static const char *TAG = "PacketKernels";
+#endif
+
+namespace TI_CC1101
+{
+    namespace
+    {
+        const uint32_t kCrc16Polynomial = 0x8005;
+
+        // x^n mod P, for the folding constants
+        constexpr uint32_t xPowModP(int n)
+        {
+            uint32_t remainder = 1;
+            for (int i = 0; i < n; i++)
+            {
+                remainder <<= 1;
+                if (remainder & 0x10000)
+                {
+                    remainder ^= 0x10000 | kCrc16Polynomial;
+                }
+            }
+            return remainder;
+        }
+
+        // kCrcTables[k][b] is the CRC (init 0) of byte b followed by k zero bytes
+        constexpr std::array<std::array<uint16_t, 256>, 8> makeCrcTables()
+        {
+            std::array<std::array<uint16_t, 256>, 8> tables{};
+            for (int b = 0; b < 256; b++)
+            {
+                uint16_t crc = (uint16_t)(b << 8);
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (uint16_t)((crc & 0x8000) ? ((crc << 1) ^ kCrc16Polynomial) : (crc << 1));
+                }
+                tables[0][b] = crc;
+            }
+            for (int k = 1; k < 8; k++)
+            {
+                for (int b = 0; b < 256; b++)
+                {
+                    uint16_t previous = tables[k - 1][b];
+                    tables[k][b]      = (uint16_t)((previous << 8) ^ tables[0][previous >> 8]);
+                }
+            }
+            return tables;
+        }
+        constexpr auto kCrcTables = makeCrcTables();
+
+        // One full period of the whitening sequence, plus 7 bytes so 8-byte reads never wrap
+        constexpr std::array<byte, PacketKernels::kPn9PeriodBytes + 7> makePn9Sequence()
+        {
+            std::array<byte, PacketKernels::kPn9PeriodBytes + 7> sequence{};
+            uint16_t                                             pn9 = 0x1FF;
+            for (size_t i = 0; i < sequence.size(); i++)
+            {
+                sequence[i] = (byte)(pn9 & 0xFF);
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    pn9 = (uint16_t)((pn9 >> 1) | (((pn9 ^ (pn9 >> 5)) & 1) << 8));
+                }
+            }
+            return sequence;
+        }
+        constexpr auto kPn9Sequence = makePn9Sequence();
+        static_assert(kPn9Sequence[PacketKernels::kPn9PeriodBytes] == kPn9Sequence[0], "PN9 period");
+
+        typedef uint16_t (*Crc16Function)(const byte *, size_t, uint16_t);
+        std::atomic<Crc16Function> s_crc16{nullptr};
+
+#if defined(CC1101_HAVE_CLMUL)
+        // x * x^F mod P split in 64-bit halves: folding a 128-bit remainder R = H.x^64 + L forward by F bits gives
+        // H.(x^(F+64) mod P) + L.(x^F mod P), which is again < 2^80.
+        __attribute__((target("pclmul,ssse3"))) inline __m128i fold(__m128i remainder, __m128i constants)
+        {
+            return _mm_xor_si128(_mm_clmulepi64_si128(remainder, constants, 0x11), _mm_clmulepi64_si128(remainder, constants, 0x00));
+        }
+
+        __attribute__((target("pclmul,ssse3"))) uint16_t crc16Clmul(const byte *data, size_t length, uint16_t crc)
+        {
+            const __m128i byteSwap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+            const __m128i fold4    = _mm_set_epi64x(xPowModP(512 + 64), xPowModP(512));
+            const __m128i fold1    = _mm_set_epi64x(xPowModP(128 + 64), xPowModP(128));
+            __m128i       acc[4];
+            byte          remainder[16];
+
+            if (length < 128)
+            {
+                return PacketKernels::Crc16SliceBy8(data, length, crc);
+            }
+            // Message bytes are big endian polynomials. The running CRC is the same as XORing it into the first
+            // two message bytes.
+            for (int i = 0; i < 4; i++)
+            {
+                acc[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), byteSwap);
+            }
+            acc[0] = _mm_xor_si128(acc[0], _mm_set_epi64x((int64_t)((uint64_t)crc << 48), 0));
+            data += 64;
+            length -= 64;
+
+            while (length >= 64)
+            {
+                for (int i = 0; i < 4; i++)
+                {
+                    __m128i block = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), byteSwap);
+                    acc[i]        = _mm_xor_si128(fold(acc[i], fold4), block);
+                }
+                data += 64;
+                length -= 64;
+            }
+            acc[1] = _mm_xor_si128(fold(acc[0], fold1), acc[1]);
+            acc[2] = _mm_xor_si128(fold(acc[1], fold1), acc[2]);
+            acc[3] = _mm_xor_si128(fold(acc[2], fold1), acc[3]);
+
+            // acc[3] is congruent to everything so far mod P. Its CRC (init 0) followed by the tail is the answer.
+            _mm_storeu_si128((__m128i *)remainder, _mm_shuffle_epi8(acc[3], byteSwap));
+            crc = PacketKernels::Crc16SliceBy8(remainder, sizeof(remainder), 0);
+            return PacketKernels::Crc16SliceBy8(data, length, crc);
+        }
+#endif
+
+        Crc16Function selectCrc16()
+        {
+#if defined(CC1101_HAVE_CLMUL)
+            if (PacketKernels::ClmulSupported())
+            {
+                return crc16Clmul;
+            }
+#endif
+            return PacketKernels::Crc16SliceBy8;
+        }
+    } // namespace
+
+    uint16_t PacketKernels::Crc16(const byte *data, size_t length, uint16_t crc)
+    {
+        Crc16Function function = s_crc16.load(std::memory_order_relaxed);
+        if (function == nullptr)
+        {
+            function = selectCrc16();
+            s_crc16.store(function, std::memory_order_relaxed);
+        }
+        return function(data, length, crc);
+    }
+
+    uint16_t PacketKernels::Crc16Reference(const byte *data, size_t length, uint16_t crc)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            crc ^= (uint16_t)(data[i] << 8);
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (uint16_t)((crc & 0x8000) ? ((crc << 1) ^ kCrc16Polynomial) : (crc << 1));
+            }
+        }
+        return crc;
+    }
+
+    uint16_t PacketKernels::Crc16SliceBy8(const byte *data, size_t length, uint16_t crc)
+    {
+        while (length >= 8)
+        {
+            crc = (uint16_t)(kCrcTables[7][data[0] ^ (crc >> 8)] ^ kCrcTables[6][data[1] ^ (crc & 0xFF)] ^
+                             kCrcTables[5][data[2]] ^ kCrcTables[4][data[3]] ^ kCrcTables[3][data[4]] ^
+                             kCrcTables[2][data[5]] ^ kCrcTables[1][data[6]] ^ kCrcTables[0][data[7]]);
+            data += 8;
+            length -= 8;
+        }
+        while (length-- > 0)
+        {
+            crc = (uint16_t)((crc << 8) ^ kCrcTables[0][(crc >> 8) ^ *data++]);
+        }
+        return crc;
+    }
+
+    uint16_t PacketKernels::Crc16Clmul(const byte *data, size_t length, uint16_t crc)
+    {
+#if defined(CC1101_HAVE_CLMUL)
+        if (ClmulSupported())
+        {
+            return crc16Clmul(data, length, crc);
+        }
+#endif
+        return Crc16SliceBy8(data, length, crc);
+    }
+
+    bool PacketKernels::ClmulSupported()
+    {
+#if defined(CC1101_HAVE_CLMUL)
+        return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+#else
+        return false;
+#endif
+    }
+
+    PacketKernels::Crc16Impl PacketKernels::SelectedCrc16Impl()
+    {
+        return ClmulSupported() ? Crc16Impl::Clmul : Crc16Impl::SliceBy8;
+    }
+
+    void PacketKernels::Pn9Whiten(byte *data, size_t length, size_t offset)
+    {
+        offset %= kPn9PeriodBytes;
+        while (length >= 8)
+        {
+            uint64_t block;
+            uint64_t key;
+
+            memcpy(&block, data, sizeof(block));
+            memcpy(&key, &kPn9Sequence[offset], sizeof(key));
+            block ^= key;
+            memcpy(data, &block, sizeof(block));
+
+            data += 8;
+            length -= 8;
+            offset += 8;
+            if (offset >= kPn9PeriodBytes)
+            {
+                offset -= kPn9PeriodBytes;
+            }
+        }
+        while (length-- > 0)
+        {
+            *data++ ^= kPn9Sequence[offset++];
+        }
+    }
+
+    void PacketKernels::Pn9WhitenReference(byte *data, size_t length)
+    {
+        uint16_t pn9 = 0x1FF;
+
+        for (size_t i = 0; i < length; i++)
+        {
+            data[i] ^= (byte)(pn9 & 0xFF);
+            for (int bit = 0; bit < 8; bit++)
+            {
+                pn9 = (uint16_t)((pn9 >> 1) | (((pn9 ^ (pn9 >> 5)) & 1) << 8));
+            }
+        }
+    }
+
+#if !defined(CC1101_HOST)
+    void PacketKernels::Benchmark(size_t bufferLength)
+    {
+        byte    *buffer = new byte[bufferLength];
+        uint32_t start  = 0;
+        uint32_t cycles = 0;
+        uint16_t crc    = 0;
+
+        for (size_t i = 0; i < bufferLength; i++)
+        {
+            buffer[i] = (byte)(i * 31 + 7);
+        }
+
+#ifdef ARDUINO
+#define CYCLE_COUNT() ESP.getCycleCount()
+#else
+#define CYCLE_COUNT() esp_cpu_get_cycle_count()
+#endif
+        start  = CYCLE_COUNT();
+        crc    = Crc16Reference(buffer, bufferLength);
+        cycles = CYCLE_COUNT() - start;
+        ESP_LOGI(TAG, "CRC16 reference:  " FLOAT_FMT " cycles/byte (" HEX_FMT ")", (float)cycles / bufferLength, crc);
+
+        start  = CYCLE_COUNT();
+        crc    = Crc16SliceBy8(buffer, bufferLength);
+        cycles = CYCLE_COUNT() - start;
+        ESP_LOGI(TAG, "CRC16 slice-by-8: " FLOAT_FMT " cycles/byte (" HEX_FMT ")", (float)cycles / bufferLength, crc);
+
+        start  = CYCLE_COUNT();
+        Pn9WhitenReference(buffer, bufferLength);
+        cycles = CYCLE_COUNT() - start;
+        ESP_LOGI(TAG, "PN9 reference:    " FLOAT_FMT " cycles/byte", (float)cycles / bufferLength);
+
+        start  = CYCLE_COUNT();
+        Pn9Whiten(buffer, bufferLength);
+        cycles = CYCLE_COUNT() - start;
+        ESP_LOGI(TAG, "PN9 table:        " FLOAT_FMT " cycles/byte", (float)cycles / bufferLength);
+#undef CYCLE_COUNT
+
+        delete[] buffer;
+    }
+#endif
+} // namespace TI_CC1101
@@ -0,0 +1,59 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <stddef.h>
+#include "LocalTypes.h"
+
+namespace TI_CC1101
+{
+    // CRC16 and PN9 loops shared by PacketCodec and the capture tools, where they are the bulk of the work.
+    //
+    // Crc16() and Pn9Whiten() pick the fastest implementation the CPU has the first time they run:
+    // carry-less multiply folding on x86 hosts with PCLMULQDQ, slice-by-8 everywhere else (ESP32 included).
+    // The byte/bit-at-a-time reference versions stay for checking the fast ones.
+    class PacketKernels
+    {
+      public:
+        enum class Crc16Impl
+        {
+            Reference,
+            SliceBy8,
+            Clmul
+        };
+
+        // CRC16 as computed by the chip: polynomial 0x8005, initial value 0xFFFF, MSB first, not reflected.
+        // Pass the previous result as crc to continue over more data.
+        static uint16_t Crc16(const byte *data, size_t length, uint16_t crc = 0xFFFF);
+        static uint16_t Crc16Reference(const byte *data, size_t length, uint16_t crc = 0xFFFF);
+        static uint16_t Crc16SliceBy8(const byte *data, size_t length, uint16_t crc = 0xFFFF);
+        // Falls back to slice-by-8 when not supported
+        static uint16_t Crc16Clmul(const byte *data, size_t length, uint16_t crc = 0xFFFF);
+        static bool     ClmulSupported();
+        static Crc16Impl SelectedCrc16Impl();
+
+        // XOR with the PN9 sequence (x^9 + x^5 + 1, seeded with all ones) starting at byte offset of the sequence.
+        // Whitening and dewhitening are the same operation.
+        static void Pn9Whiten(byte *data, size_t length, size_t offset = 0);
+        static void Pn9WhitenReference(byte *data, size_t length);
+
+        // The PN9 byte sequence repeats every 511 bytes (2^9 - 1 bits, and 8 is coprime with 511)
+        static const size_t kPn9PeriodBytes = 511;
+
+#if !defined(CC1101_HOST)
+        // Logs cycles per byte for each implementation, measured on a buffer of bufferLength bytes
+        static void Benchmark(size_t bufferLength = 4096);
+#endif
+    };
+} // namespace TI_CC1101
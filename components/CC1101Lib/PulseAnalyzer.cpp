@@ -0,0 +1,457 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include "PulseAnalyzer.h"
+
+namespace TI_CC1101
+{
+    namespace
+    {
+        const int  kMinPulses        = 32;
+        const int  kMaxKMeansRounds  = 8;
+        const int  kMergePercent     = 130; // clusters closer than this ratio are one width with jitter
+        const int  kDataShareDivisor = 5;   // a data width has at least 1/5 of its level's pulses
+        const int  kDataMaxRatio     = 8;   // and is at most 8x the shortest width
+        const int  kMinFrames        = 2;   // needs a repeat to tell a frame from noise
+        const int  kMaxFrameBits     = 64;
+        const char kLearnedName[]    = "Learned";
+
+        bool within(uint32_t a, uint32_t b, int percent)
+        {
+            uint32_t difference = a > b ? a - b : b - a;
+            return difference * 100 <= (uint64_t)percent * (a > b ? a : b);
+        }
+    } // namespace
+
+    // Piecewise linear log2: the octave from the leading one, then the next three bits pick one of 8 bins
+    int PulseAnalyzer::durationBin(uint32_t durationMicros)
+    {
+        if (durationMicros < (1u << kMinOctave))
+        {
+            return 0;
+        }
+        int octave = 31 - __builtin_clz(durationMicros);
+        if (octave >= kMinOctave + kOctaves)
+        {
+            return kBins - 1;
+        }
+        return (octave - kMinOctave) * kBinsPerOctave + ((durationMicros >> (octave - 3)) & 7);
+    }
+
+    uint32_t PulseAnalyzer::binCenterMicros(int bin)
+    {
+        int      octave = bin / kBinsPerOctave + kMinOctave;
+        uint32_t width  = 1u << (octave - 3);
+
+        return (uint32_t)(kBinsPerOctave + bin % kBinsPerOctave) * width + width / 2;
+    }
+
+    void PulseAnalyzer::Add(const Pulse &pulse)
+    {
+        if (m_count == kWindowSize)
+        {
+            return;
+        }
+        m_window[m_count++] = pulse;
+        m_histogram[pulse.Level ? 1 : 0][durationBin(pulse.DurationMicros)]++;
+    }
+
+    void PulseAnalyzer::Reset()
+    {
+        m_count = 0;
+        memset(m_histogram, 0, sizeof(m_histogram));
+    }
+
+    int PulseAnalyzer::nearestCluster(const PulseCluster *clusters, int clusterCount, uint32_t durationMicros)
+    {
+        int      nearest   = 0;
+        uint64_t bestRatio = UINT64_MAX;
+
+        // Distance is the ratio, i.e. distance in log(duration), so 300 vs 600 is as far apart as 3000 vs 6000
+        for (int i = 0; i < clusterCount; i++)
+        {
+            uint64_t center = clusters[i].CenterMicros;
+            uint64_t ratio  = durationMicros > center ? ((uint64_t)durationMicros << 10) / center
+                                                      : (center << 10) / (durationMicros | 1);
+            if (ratio < bestRatio)
+            {
+                bestRatio = ratio;
+                nearest   = i;
+            }
+        }
+        return nearest;
+    }
+
+    int PulseAnalyzer::findClusters(byte level, PulseCluster *clusters)
+    {
+        const uint16_t *histogram  = m_histogram[level];
+        uint32_t        levelCount = 0;
+        uint32_t        smoothed[kBins];
+        uint32_t        minPeak;
+        int             count = 0;
+
+        for (int i = 0; i < kBins; i++)
+        {
+            levelCount += histogram[i];
+        }
+        minPeak = levelCount / 100 > 2 ? levelCount / 100 : 2;
+
+        // Peaks of the [1 2 1] smoothed histogram seed the clusters. When there are more than fit, the weakest go.
+        for (int i = 0; i < kBins; i++)
+        {
+            smoothed[i] = (i > 0 ? histogram[i - 1] : 0) + 2 * histogram[i] + (i < kBins - 1 ? histogram[i + 1] : 0);
+        }
+        for (int i = 0; i < kBins; i++)
+        {
+            if ((i > 0 && smoothed[i] <= smoothed[i - 1]) || (i < kBins - 1 && smoothed[i] < smoothed[i + 1]) ||
+                smoothed[i] < 2 * minPeak)
+            {
+                continue;
+            }
+            if (count == PulseAnalysis::kMaxClusters)
+            {
+                int weakest = 0;
+                for (int k = 1; k < count; k++)
+                {
+                    weakest = clusters[k].Count < clusters[weakest].Count ? k : weakest;
+                }
+                if (clusters[weakest].Count >= smoothed[i])
+                {
+                    continue;
+                }
+                memmove(&clusters[weakest], &clusters[weakest + 1], (count - weakest - 1) * sizeof(PulseCluster));
+                count--;
+            }
+            clusters[count++] = {binCenterMicros(i), smoothed[i]};
+        }
+
+        // Refine in the time domain. Seeds are in ascending order and 1-D k-means keeps them that way.
+        for (int round = 0; round < kMaxKMeansRounds && count > 0; round++)
+        {
+            uint64_t sums[PulseAnalysis::kMaxClusters]   = {};
+            uint32_t counts[PulseAnalysis::kMaxClusters] = {};
+            bool     changed                             = false;
+            int      kept                                = 0;
+
+            for (size_t i = 0; i < m_count; i++)
+            {
+                if ((m_window[i].Level ? 1 : 0) == level)
+                {
+                    int k = nearestCluster(clusters, count, m_window[i].DurationMicros);
+                    // Widths too rare to get a seed would otherwise drag their neighbour's center away
+                    if (!within(m_window[i].DurationMicros, clusters[k].CenterMicros, 35))
+                    {
+                        continue;
+                    }
+                    sums[k] += m_window[i].DurationMicros;
+                    counts[k]++;
+                }
+            }
+            for (int k = 0; k < count; k++)
+            {
+                if (counts[k] == 0)
+                {
+                    changed = true;
+                    continue;
+                }
+                uint32_t center = (uint32_t)(sums[k] / counts[k]);
+                // Neighbours that ended up on the same width become one
+                if (kept > 0 && (uint64_t)center * 100 < (uint64_t)clusters[kept - 1].CenterMicros * kMergePercent)
+                {
+                    uint32_t total = clusters[kept - 1].Count + counts[k];
+                    clusters[kept - 1].CenterMicros =
+                        (uint32_t)(((uint64_t)clusters[kept - 1].CenterMicros * clusters[kept - 1].Count + sums[k]) / total);
+                    clusters[kept - 1].Count = total;
+                    changed                  = true;
+                    continue;
+                }
+                changed |= center != clusters[k].CenterMicros || counts[k] != clusters[k].Count;
+                clusters[kept++] = {center, counts[k]};
+            }
+            count = kept;
+            if (!changed)
+            {
+                break;
+            }
+        }
+        return count;
+    }
+
+    bool PulseAnalyzer::isDataCluster(const PulseCluster *clusters, int index, uint32_t levelCount)
+    {
+        return clusters[index].Count * kDataShareDivisor >= levelCount &&
+               clusters[index].CenterMicros <= clusters[0].CenterMicros * kDataMaxRatio;
+    }
+
+    // Half-bits are paired from the start of the run. If that gives a pair of equal levels, the first half-bit
+    // belongs to the sync instead. The last half-bit may have merged into the gap, so odd counts round up.
+    uint32_t PulseAnalyzer::manchesterBits(size_t start, size_t end, uint32_t longHigh, uint32_t longLow, bool &leadingHalfBit)
+    {
+        uint32_t halfBits  = 0;
+        byte     lastLevel = 0;
+
+        leadingHalfBit = false;
+        for (size_t i = start; i < end; i++)
+        {
+            const Pulse &pulse = m_window[i];
+            int count = within(pulse.DurationMicros, pulse.Level ? longHigh : longLow, 25) ? 2 : 1;
+            for (int k = 0; k < count; k++, halfBits++)
+            {
+                leadingHalfBit |= (halfBits & 1) != 0 && pulse.Level == lastLevel;
+                lastLevel = pulse.Level;
+            }
+        }
+        return (halfBits - (leadingHalfBit ? 1 : 0) + 1) / 2;
+    }
+
+    bool PulseAnalyzer::Analyze(PulseAnalysis &analysis)
+    {
+        int      dataHigh[2];
+        int      dataLow[2];
+        int      dataHighCount = 0;
+        int      dataLowCount  = 0;
+        bool     isDataHigh[PulseAnalysis::kMaxClusters] = {};
+        bool     isDataLow[PulseAnalysis::kMaxClusters]  = {};
+        uint32_t highCount = 0;
+        uint32_t lowCount  = 0;
+        uint16_t frameBits[kMaxFrameBits + 2] = {};
+        uint32_t shortHigh, longHigh, shortLow, longLow;
+        size_t   runStart = 0;
+        uint32_t bits;
+        int      syncLength = 0;
+        uint64_t syncSums[2] = {};
+        uint32_t syncFrames  = 0;
+        uint32_t shortestGap = UINT32_MAX;
+        uint32_t leadingHalfBits = 0;
+        bool     leadingHalfBit  = false;
+
+        memset(&analysis, 0, sizeof(analysis));
+        if (m_count < kMinPulses)
+        {
+            return false;
+        }
+        analysis.HighClusters = findClusters(1, analysis.High);
+        analysis.LowClusters  = findClusters(0, analysis.Low);
+        if (analysis.HighClusters == 0 || analysis.LowClusters == 0)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < analysis.HighClusters; i++)
+        {
+            highCount += analysis.High[i].Count;
+        }
+        for (int i = 0; i < analysis.LowClusters; i++)
+        {
+            lowCount += analysis.Low[i].Count;
+        }
+        for (int i = 0; i < analysis.HighClusters; i++)
+        {
+            if (isDataCluster(analysis.High, i, highCount))
+            {
+                if (dataHighCount == 2)
+                {
+                    return false;
+                }
+                isDataHigh[i]             = true;
+                dataHigh[dataHighCount++] = i;
+            }
+        }
+        for (int i = 0; i < analysis.LowClusters; i++)
+        {
+            if (isDataCluster(analysis.Low, i, lowCount))
+            {
+                if (dataLowCount == 2)
+                {
+                    return false;
+                }
+                isDataLow[i]            = true;
+                dataLow[dataLowCount++] = i;
+            }
+        }
+        if (dataLowCount != 2 || dataHighCount == 0)
+        {
+            return false;
+        }
+
+        shortHigh = analysis.High[dataHigh[0]].CenterMicros;
+        longHigh  = analysis.High[dataHigh[dataHighCount - 1]].CenterMicros;
+        shortLow  = analysis.Low[dataLow[0]].CenterMicros;
+        longLow   = analysis.Low[dataLow[1]].CenterMicros;
+
+        if (dataHighCount == 1)
+        {
+            analysis.Encoding           = InferredEncoding::PulsePosition;
+            analysis.SymbolPeriodMicros = shortHigh + (shortLow + longLow) / 2;
+        }
+        else
+        {
+            // PWM only ever pairs a short high with a long low or the other way round. Manchester has runs of
+            // short half-bits, so equal pairs are common. That's what tells 1:2 PWM from Manchester.
+            uint32_t pairs      = 0;
+            uint32_t equalPairs = 0;
+            for (size_t i = 0; i + 1 < m_count; i++)
+            {
+                const Pulse &high = m_window[i];
+                const Pulse &low  = m_window[i + 1];
+                if (!high.Level || low.Level)
+                {
+                    continue;
+                }
+                int h = nearestCluster(analysis.High, analysis.HighClusters, high.DurationMicros);
+                int l = nearestCluster(analysis.Low, analysis.LowClusters, low.DurationMicros);
+                if (isDataHigh[h] && isDataLow[l])
+                {
+                    pairs++;
+                    equalPairs += (h == dataHigh[0]) == (l == dataLow[0]) ? 1 : 0;
+                }
+            }
+            if (equalPairs * 5 > pairs && within(shortHigh, shortLow, 35) && within(longHigh, 2 * shortHigh, 25) &&
+                within(longLow, 2 * shortLow, 25))
+            {
+                analysis.Encoding           = InferredEncoding::Manchester;
+                analysis.SymbolPeriodMicros = shortHigh + shortLow;
+            }
+            else if (within(shortHigh + longLow, longHigh + shortLow, 25))
+            {
+                analysis.Encoding           = InferredEncoding::PulseWidth;
+                analysis.SymbolPeriodMicros = (shortHigh + longLow + longHigh + shortLow) / 2;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        // Frames are the runs of data pulses between the long, rare ones. Count bits per run, keep the commonest.
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (size_t i = 0; i <= m_count; i++)
+            {
+                bool isData = false;
+                if (i < m_count)
+                {
+                    const Pulse        &pulse    = m_window[i];
+                    const PulseCluster *clusters = pulse.Level ? analysis.High : analysis.Low;
+                    int k = nearestCluster(clusters, pulse.Level ? analysis.HighClusters : analysis.LowClusters, pulse.DurationMicros);
+                    // Rare widths may not have a cluster of their own, don't let them pass for their neighbour
+                    isData = (pulse.Level ? isDataHigh[k] : isDataLow[k]) && within(pulse.DurationMicros, clusters[k].CenterMicros, 35);
+                }
+                if (isData)
+                {
+                    continue;
+                }
+                bits = 0;
+                if (analysis.Encoding == InferredEncoding::Manchester)
+                {
+                    bits = manchesterBits(runStart, i, longHigh, longLow, leadingHalfBit);
+                }
+                else
+                {
+                    bits = (i - runStart) / 2;
+                }
+                if (pass == 0)
+                {
+                    frameBits[bits <= kMaxFrameBits ? bits : kMaxFrameBits + 1]++;
+                }
+                // The first frame in the window may have lost its start, it counts but doesn't provide a sync.
+                else if ((int)bits == analysis.BitsPerFrame && runStart >= 2)
+                {
+                    const Pulse &last = m_window[runStart - 1];
+                    if (syncFrames == 0)
+                    {
+                        syncLength = last.Level ? 1 : 2;
+                    }
+                    if (syncLength == (last.Level ? 1 : 2))
+                    {
+                        syncSums[0] += syncLength == 1 ? last.DurationMicros : m_window[runStart - 2].DurationMicros;
+                        syncSums[1] += syncLength == 1 ? 0 : last.DurationMicros;
+                        syncFrames++;
+                        leadingHalfBits += leadingHalfBit ? 1 : 0;
+                    }
+                    // The last frame of a burst runs into the silence after it, the shortest gap is the repeat gap
+                    if (i < m_count && m_window[i].DurationMicros < shortestGap)
+                    {
+                        shortestGap = m_window[i].DurationMicros;
+                    }
+                }
+                runStart = i + 1;
+            }
+            if (pass == 0)
+            {
+                // Runs of a few bits are noise or the gap structure between frames, not frames
+                for (int k = 8; k <= kMaxFrameBits; k++)
+                {
+                    if (frameBits[k] > analysis.Frames)
+                    {
+                        analysis.Frames       = frameBits[k];
+                        analysis.BitsPerFrame = k;
+                    }
+                }
+                if (analysis.Frames < kMinFrames)
+                {
+                    return false;
+                }
+                runStart = 0;
+            }
+        }
+        if (syncFrames == 0)
+        {
+            return false;
+        }
+        // The sync ends in a high and the low half-bit after it is part of the sync, not the first bit (Somfy)
+        if (syncLength == 1 && leadingHalfBits * 2 > syncFrames)
+        {
+            syncLength   = 2;
+            syncSums[1] = (uint64_t)shortLow * syncFrames;
+        }
+        analysis.FrameGapMicros = shortestGap != UINT32_MAX ? shortestGap : 0;
+
+        ProtocolTiming &timing  = analysis.Timing;
+        timing.Name             = kLearnedName;
+        timing.TolerancePercent = analysis.Encoding == InferredEncoding::Manchester ? 25 : 30;
+        timing.MinBits          = (byte)analysis.BitsPerFrame;
+        timing.MaxBits          = (byte)analysis.BitsPerFrame;
+        timing.SyncLength       = (byte)syncLength;
+        timing.Sync[0]          = (uint16_t)(syncSums[0] / syncFrames);
+        timing.Sync[1]          = (uint16_t)(syncSums[1] / syncFrames);
+        switch (analysis.Encoding)
+        {
+        case InferredEncoding::Manchester:
+            timing.Encoding      = PulseEncoding::Manchester;
+            timing.HalfBitMicros = (uint16_t)(analysis.SymbolPeriodMicros / 2);
+            timing.RisingIsOne   = true;
+            break;
+        case InferredEncoding::PulseWidth:
+            timing.Encoding     = PulseEncoding::PulseWidth;
+            timing.SymbolLength = 2;
+            timing.Zero[0]      = (uint16_t)shortHigh;
+            timing.Zero[1]      = (uint16_t)longLow;
+            timing.One[0]       = (uint16_t)longHigh;
+            timing.One[1]       = (uint16_t)shortLow;
+            break;
+        default:
+            timing.Encoding     = PulseEncoding::PulseWidth;
+            timing.SymbolLength = 2;
+            timing.Zero[0]      = (uint16_t)shortHigh;
+            timing.Zero[1]      = (uint16_t)shortLow;
+            timing.One[0]       = (uint16_t)shortHigh;
+            timing.One[1]       = (uint16_t)longLow;
+            break;
+        }
+        return true;
+    }
+} // namespace TI_CC1101
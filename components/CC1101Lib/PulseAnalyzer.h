@@ -0,0 +1,89 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include "PulseDecoder.h"
+
+namespace TI_CC1101
+{
+    struct PulseCluster
+    {
+        uint32_t CenterMicros;
+        uint32_t Count;
+    };
+
+    enum class InferredEncoding : byte
+    {
+        Unknown,
+        PulseWidth,    // two high widths and two low widths, constant bit period (EV1527, PT2262)
+        PulsePosition, // one high width, the low width carries the bit (Nexa symbols)
+        Manchester     // T and 2T on both levels (Somfy)
+    };
+
+    struct PulseAnalysis
+    {
+        static const int kMaxClusters = 6;
+
+        PulseCluster     High[kMaxClusters];
+        int              HighClusters;
+        PulseCluster     Low[kMaxClusters];
+        int              LowClusters;
+        InferredEncoding Encoding;
+        uint32_t         SymbolPeriodMicros; // one bit
+        uint32_t         FrameGapMicros;     // low that ends each frame
+        int              BitsPerFrame;
+        int              Frames;             // frames in the window with BitsPerFrame bits, i.e. repeats + 1
+        ProtocolTiming   Timing;             // ready for PulseDecoderBank::Register(). Bit polarity is a guess.
+    };
+
+    // Works out the timing of an unknown OOK protocol from a window of pulses.
+    //
+    // Durations are binned on a log scale (8 bins per octave) as they arrive. Analyze() takes the histogram peaks of
+    // each level as seeds for a few rounds of k-means over the window, keeps the clusters that carry data (frequent,
+    // not much longer than the shortest), and infers the encoding from their count and ratios. Frames are whatever
+    // lies between the long, rare pulses; the most common frame length gives the bit count.
+    //
+    // Memory is fixed (kWindowSize pulses + the histogram, about 4.5 KB), Add() is O(1) and Analyze() is linear in
+    // the window, so it runs on the device as well as over whole capture files on the host.
+    class PulseAnalyzer
+    {
+      public:
+        static const size_t kWindowSize    = 512;
+        static const int    kBinsPerOctave = 8;
+        static const int    kMinOctave     = 5;  // 32 us
+        static const int    kOctaves       = 12; // up to ~130 ms
+        static const int    kBins          = kBinsPerOctave * kOctaves;
+
+        void   Add(const Pulse &pulse);
+        void   Reset();
+        size_t Count() const { return m_count; }
+        bool   Full() const { return m_count == kWindowSize; }
+
+        // False when the window doesn't look like a protocol (too few pulses, no consistent frames)
+        bool Analyze(PulseAnalysis &analysis);
+
+      protected:
+        static int      durationBin(uint32_t durationMicros);
+        static uint32_t binCenterMicros(int bin);
+        static bool     isDataCluster(const PulseCluster *clusters, int index, uint32_t levelCount);
+        static int      nearestCluster(const PulseCluster *clusters, int clusterCount, uint32_t durationMicros);
+
+        int      findClusters(byte level, PulseCluster *clusters);
+        uint32_t manchesterBits(size_t start, size_t end, uint32_t longHigh, uint32_t longLow, bool &leadingHalfBit);
+
+        Pulse    m_window[kWindowSize];
+        size_t   m_count = 0;
+        uint16_t m_histogram[2][kBins] = {};
+    };
+} // namespace TI_CC1101
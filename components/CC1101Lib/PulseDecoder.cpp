@@ -0,0 +1,296 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "PulseDecoder.h"
+
+namespace TI_CC1101
+{
+    namespace
+    {
+        // PT2262 sends 12 trits as pairs of pulse-width bits: 00 = 0, 11 = 1, 01 = floating. 10 never appears.
+        bool validatePT2262(uint64_t bits, byte bitCount)
+        {
+            for (int i = 0; i < bitCount; i += 2)
+            {
+                if (((bits >> (bitCount - 2 - i)) & 0b11) == 0b10)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    } // namespace
+
+    namespace KnownProtocols
+    {
+        // Learning code remotes. 20 bit address + 4 data bits, sync 1:31, T ~ 320 us
+        const ProtocolTiming EV1527 = {
+            .Name = "EV1527", .Encoding = PulseEncoding::PulseWidth, .TolerancePercent = 30, .MinBits = 24, .MaxBits = 24,
+            .SyncLength = 2, .Sync = {320, 9920},
+            .SymbolLength = 2, .Zero = {320, 960}, .One = {960, 320},
+            .HalfBitMicros = 0, .RisingIsOne = false, .Validate = nullptr};
+
+        // Fixed code remotes. 12 trits, each as two bits, sync 1:31, T ~ 350 us
+        const ProtocolTiming PT2262 = {
+            .Name = "PT2262", .Encoding = PulseEncoding::PulseWidth, .TolerancePercent = 30, .MinBits = 24, .MaxBits = 24,
+            .SyncLength = 2, .Sync = {350, 10850},
+            .SymbolLength = 2, .Zero = {350, 1050}, .One = {1050, 350},
+            .HalfBitMicros = 0, .RisingIsOne = false, .Validate = validatePT2262};
+
+        // Nexa / HomeEasy / KlikAanKlikUit "self learning": 26 bit id, group, on/off, 4 bit unit. Each bit is a pair
+        // of PPM symbols, 0 = T,T then T,5T and 1 = T,5T then T,T. T ~ 250 us
+        const ProtocolTiming NexaHomeEasy = {
+            .Name = "NexaHomeEasy", .Encoding = PulseEncoding::PulseWidth, .TolerancePercent = 30, .MinBits = 32, .MaxBits = 32,
+            .SyncLength = 2, .Sync = {250, 2500},
+            .SymbolLength = 4, .Zero = {250, 250, 250, 1250}, .One = {250, 1250, 250, 250},
+            .HalfBitMicros = 0, .RisingIsOne = false, .Validate = nullptr};
+
+        // Somfy RTS: hardware sync 2416/2416 (repeated), software sync 4550 high, then 56 bits Manchester with
+        // 640 us half-bits, rising edge = 1
+        const ProtocolTiming Somfy = {
+            .Name = "Somfy", .Encoding = PulseEncoding::Manchester, .TolerancePercent = 25, .MinBits = 56, .MaxBits = 56,
+            .SyncLength = 4, .Sync = {2416, 2416, 4550, 640},
+            .SymbolLength = 0, .Zero = {}, .One = {},
+            .HalfBitMicros = 640, .RisingIsOne = true, .Validate = nullptr};
+    } // namespace KnownProtocols
+
+    void PulseDecoderBank::SetCallback(DecodedFrameCallback callback, void *context)
+    {
+        m_callback = callback;
+        m_context  = context;
+    }
+
+    bool PulseDecoderBank::Register(const ProtocolTiming &protocol)
+    {
+        if (m_count == kMaxProtocols || protocol.MaxBits > 64 || protocol.SyncLength > ProtocolTiming::kMaxPattern ||
+            protocol.SymbolLength > ProtocolTiming::kMaxPattern)
+        {
+            return false;
+        }
+        m_states[m_count].Protocol = &protocol;
+        restart(m_states[m_count]);
+        m_count++;
+        return true;
+    }
+
+    void PulseDecoderBank::Feed(uint32_t timestampMicros, std::span<const Pulse> pulses)
+    {
+        for (const Pulse &pulse : pulses)
+        {
+            Feed(timestampMicros, pulse);
+            timestampMicros += pulse.DurationMicros;
+        }
+    }
+
+    void PulseDecoderBank::Feed(uint32_t timestampMicros, const Pulse &pulse)
+    {
+        for (int i = 0; i < m_count; i++)
+        {
+            DecoderState &state = m_states[i];
+
+            if (state.CurrentPhase == Phase::Sync)
+            {
+                feedSync(state, timestampMicros, pulse);
+            }
+            else if (state.Protocol->Encoding == PulseEncoding::PulseWidth)
+            {
+                feedPulseWidth(state, timestampMicros, pulse);
+            }
+            else
+            {
+                feedManchester(state, timestampMicros, pulse);
+            }
+        }
+    }
+
+    void PulseDecoderBank::Reset()
+    {
+        for (int i = 0; i < m_count; i++)
+        {
+            restart(m_states[i]);
+        }
+    }
+
+    bool PulseDecoderBank::matches(uint32_t duration, uint16_t expected, byte tolerancePercent)
+    {
+        uint32_t difference = duration > expected ? duration - expected : expected - duration;
+        return difference * 100 <= (uint32_t)expected * tolerancePercent;
+    }
+
+    void PulseDecoderBank::feedSync(DecoderState &state, uint32_t timestampMicros, const Pulse &pulse)
+    {
+        const ProtocolTiming &protocol      = *state.Protocol;
+        byte                  expectedLevel = (state.SyncIndex % 2) == 0 ? 1 : 0;
+        bool                  lastSync      = state.SyncIndex == protocol.SyncLength - 1;
+
+        if (pulse.Level == expectedLevel && matches(pulse.DurationMicros, protocol.Sync[state.SyncIndex], protocol.TolerancePercent))
+        {
+            if (state.SyncIndex == 0)
+            {
+                state.StartMicros = timestampMicros;
+            }
+            if (++state.SyncIndex == protocol.SyncLength)
+            {
+                state.CurrentPhase = Phase::Data;
+            }
+            return;
+        }
+        // In Manchester the first half-bit can have the same level as the end of the sync and merge with it
+        if (lastSync && protocol.Encoding == PulseEncoding::Manchester && pulse.Level == expectedLevel &&
+            matches(pulse.DurationMicros, protocol.Sync[state.SyncIndex] + protocol.HalfBitMicros, protocol.TolerancePercent))
+        {
+            state.CurrentPhase = Phase::Data;
+            addHalfBit(state, pulse.Level);
+            return;
+        }
+        // Not this sync. The pulse may still be the start of the next one.
+        if (state.SyncIndex != 0)
+        {
+            state.SyncIndex = 0;
+            feedSync(state, timestampMicros, pulse);
+        }
+    }
+
+    void PulseDecoderBank::feedPulseWidth(DecoderState &state, uint32_t timestampMicros, const Pulse &pulse)
+    {
+        const ProtocolTiming &protocol      = *state.Protocol;
+        byte                  expectedLevel = (state.SymbolIndex % 2) == 0 ? 1 : 0;
+
+        if (pulse.Level != expectedLevel)
+        {
+            endFrame(state, timestampMicros, pulse);
+            return;
+        }
+        // The last low of the last bit runs into the gap after the frame when no sync follows it
+        if (state.SymbolIndex == protocol.SymbolLength - 1 && pulse.Level == 0 && state.BitCount + 1 >= protocol.MinBits &&
+            state.ZeroMatches != state.OneMatches && pulse.DurationMicros > protocol.Zero[state.SymbolIndex] &&
+            pulse.DurationMicros > protocol.One[state.SymbolIndex])
+        {
+            state.Bits = (state.Bits << 1) | (state.ZeroMatches ? 0 : 1);
+            state.BitCount++;
+            endFrame(state, timestampMicros, pulse);
+            return;
+        }
+        state.ZeroMatches = state.ZeroMatches && matches(pulse.DurationMicros, protocol.Zero[state.SymbolIndex], protocol.TolerancePercent);
+        state.OneMatches  = state.OneMatches && matches(pulse.DurationMicros, protocol.One[state.SymbolIndex], protocol.TolerancePercent);
+        if (!state.ZeroMatches && !state.OneMatches)
+        {
+            endFrame(state, timestampMicros, pulse);
+            return;
+        }
+        if (++state.SymbolIndex < protocol.SymbolLength)
+        {
+            return;
+        }
+        state.Bits        = (state.Bits << 1) | (state.ZeroMatches ? 0 : 1);
+        state.SymbolIndex = 0;
+        state.ZeroMatches = true;
+        state.OneMatches  = true;
+        if (++state.BitCount == protocol.MaxBits)
+        {
+            endFrame(state, timestampMicros, Pulse{0, 0});
+        }
+    }
+
+    void PulseDecoderBank::feedManchester(DecoderState &state, uint32_t timestampMicros, const Pulse &pulse)
+    {
+        const ProtocolTiming &protocol = *state.Protocol;
+        int                   halves   = 0;
+
+        if (matches(pulse.DurationMicros, protocol.HalfBitMicros, protocol.TolerancePercent))
+        {
+            halves = 1;
+        }
+        else if (matches(pulse.DurationMicros, 2 * protocol.HalfBitMicros, protocol.TolerancePercent))
+        {
+            halves = 2;
+        }
+        else
+        {
+            // The gap after the frame swallows the last half-bit when it has the same level
+            if (state.HaveHalfBit && pulse.Level != state.HalfBitLevel)
+            {
+                addHalfBit(state, pulse.Level);
+            }
+            if (state.CurrentPhase == Phase::Data)
+            {
+                endFrame(state, timestampMicros, pulse);
+            }
+            return;
+        }
+        for (int i = 0; i < halves && state.CurrentPhase == Phase::Data; i++)
+        {
+            if (!addHalfBit(state, pulse.Level))
+            {
+                endFrame(state, timestampMicros, pulse);
+                return;
+            }
+        }
+    }
+
+    // Returns false on two half-bits of the same level, which isn't Manchester
+    bool PulseDecoderBank::addHalfBit(DecoderState &state, byte level)
+    {
+        if (!state.HaveHalfBit)
+        {
+            state.HaveHalfBit  = true;
+            state.HalfBitLevel = level;
+            return true;
+        }
+        if (level == state.HalfBitLevel)
+        {
+            return false;
+        }
+        state.HaveHalfBit = false;
+        state.Bits        = (state.Bits << 1) | ((level == 1) == state.Protocol->RisingIsOne ? 1 : 0);
+        if (++state.BitCount == state.Protocol->MaxBits)
+        {
+            endFrame(state, 0, Pulse{0, 0});
+        }
+        return true;
+    }
+
+    // Emits the frame if it is long enough, then resyncs. pulse is the one that broke the frame, it gets a chance
+    // to start the next sync. A zero length pulse means the frame ended by reaching MaxBits.
+    void PulseDecoderBank::endFrame(DecoderState &state, uint32_t timestampMicros, const Pulse &pulse)
+    {
+        const ProtocolTiming &protocol = *state.Protocol;
+
+        if (state.BitCount >= protocol.MinBits && (protocol.Validate == nullptr || protocol.Validate(state.Bits, state.BitCount)) &&
+            m_callback != nullptr)
+        {
+            DecodedFrame frame = {&protocol, state.Bits, state.BitCount, state.StartMicros};
+            m_callback(frame, m_context);
+        }
+        restart(state);
+        if (pulse.DurationMicros != 0)
+        {
+            feedSync(state, timestampMicros, pulse);
+        }
+    }
+
+    void PulseDecoderBank::restart(DecoderState &state)
+    {
+        state.CurrentPhase = Phase::Sync;
+        state.SyncIndex    = 0;
+        state.SymbolIndex  = 0;
+        state.ZeroMatches  = true;
+        state.OneMatches   = true;
+        state.HaveHalfBit  = false;
+        state.HalfBitLevel = 0;
+        state.BitCount     = 0;
+        state.Bits         = 0;
+    }
+} // namespace TI_CC1101
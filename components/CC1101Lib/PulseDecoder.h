@@ -0,0 +1,126 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <span>
+#include <stddef.h>
+#include "RfCapture.h"
+
+namespace TI_CC1101
+{
+    enum class PulseEncoding : byte
+    {
+        // Each bit is a fixed sequence of high/low durations (EV1527, PT2262, Nexa). Covers PPM too, where only the
+        // low durations differ.
+        PulseWidth,
+        // Each bit is two half-bits of opposite level, HalfBitMicros each (Somfy RTS)
+        Manchester
+    };
+
+    // A protocol as a timing table, all durations in microseconds. Patterns alternate high/low starting with high.
+    struct ProtocolTiming
+    {
+        static const int kMaxPattern = 4;
+
+        const char   *Name;
+        PulseEncoding Encoding;
+        byte          TolerancePercent;
+        byte          MinBits;
+        byte          MaxBits; // up to 64
+        byte          SyncLength;
+        uint16_t      Sync[kMaxPattern];
+        // PulseWidth
+        byte          SymbolLength;
+        uint16_t      Zero[kMaxPattern];
+        uint16_t      One[kMaxPattern];
+        // Manchester
+        uint16_t      HalfBitMicros;
+        bool          RisingIsOne; // low then high half-bit decodes as 1
+        // Optional extra check on a complete frame, e.g. PT2262 trit pairs
+        bool (*Validate)(uint64_t bits, byte bitCount);
+    };
+
+    namespace KnownProtocols
+    {
+        extern const ProtocolTiming EV1527;
+        extern const ProtocolTiming PT2262;
+        extern const ProtocolTiming NexaHomeEasy;
+        extern const ProtocolTiming Somfy;
+    } // namespace KnownProtocols
+
+    struct DecodedFrame
+    {
+        const ProtocolTiming *Protocol;
+        uint64_t              Bits; // first received bit is the most significant of BitCount
+        byte                  BitCount;
+        uint32_t              TimestampMicros; // start of the sync
+    };
+
+    typedef void (*DecodedFrameCallback)(const DecodedFrame &frame, void *context);
+
+    // Runs every registered protocol over the same pulse stream in one pass. Each protocol gets its own small state
+    // machine in a fixed array, so feeding a pulse is a loop over kMaxProtocols states and never allocates.
+    class PulseDecoderBank
+    {
+      public:
+        static const int kMaxProtocols = 16;
+
+        void SetCallback(DecodedFrameCallback callback, void *context);
+        // The table must outlive the bank, the built-in ones are static
+        bool Register(const ProtocolTiming &protocol);
+        int  ProtocolCount() const { return m_count; }
+        const ProtocolTiming &Protocol(int index) const { return *m_states[index].Protocol; }
+
+        // timestampMicros is when the first pulse started
+        void Feed(uint32_t timestampMicros, std::span<const Pulse> pulses);
+        void Feed(uint32_t timestampMicros, const Pulse &pulse);
+        void Reset();
+
+      protected:
+        enum class Phase : byte
+        {
+            Sync,
+            Data
+        };
+
+        struct DecoderState
+        {
+            const ProtocolTiming *Protocol;
+            Phase                 CurrentPhase;
+            byte                  SyncIndex;
+            byte                  SymbolIndex;
+            bool                  ZeroMatches;
+            bool                  OneMatches;
+            bool                  HaveHalfBit;
+            byte                  HalfBitLevel;
+            byte                  BitCount;
+            uint64_t              Bits;
+            uint32_t              StartMicros;
+        };
+
+        static bool matches(uint32_t duration, uint16_t expected, byte tolerancePercent);
+
+        void feedSync(DecoderState &state, uint32_t timestampMicros, const Pulse &pulse);
+        void feedPulseWidth(DecoderState &state, uint32_t timestampMicros, const Pulse &pulse);
+        void feedManchester(DecoderState &state, uint32_t timestampMicros, const Pulse &pulse);
+        bool addHalfBit(DecoderState &state, byte level);
+        void endFrame(DecoderState &state, uint32_t timestampMicros, const Pulse &pulse);
+        void restart(DecoderState &state);
+
+        DecoderState         m_states[kMaxProtocols];
+        int                  m_count    = 0;
+        DecodedFrameCallback m_callback = nullptr;
+        void                *m_context  = nullptr;
+    };
+} // namespace TI_CC1101
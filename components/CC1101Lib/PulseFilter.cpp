@@ -0,0 +1,263 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <string.h>
+#include "PulseFilter.h"
+
+namespace TI_CC1101
+{
+    namespace
+    {
+        // Merged lows are flushed before they get anywhere near wrapping
+        const uint32_t kMaxMergedMicros = 1u << 30;
+    } // namespace
+
+    void PulseFilter::Configure(const PulseFilterConfig &config)
+    {
+        m_config = config;
+        if (m_config.MinBurstPulses > kMaxHeldPulses)
+        {
+            m_config.MinBurstPulses = kMaxHeldPulses;
+        }
+    }
+
+    bool PulseFilter::SetProtocols(const PulseDecoderBank &decoders)
+    {
+        bool bRet = true;
+
+        m_intervalCount  = 0;
+        m_envelopeMicros = 0;
+        for (int i = 0; i < decoders.ProtocolCount(); i++)
+        {
+            const ProtocolTiming &protocol  = decoders.Protocol(i);
+            byte                  tolerance = protocol.TolerancePercent;
+
+            for (int k = 0; k < protocol.SyncLength; k++)
+            {
+                CBR(addInterval(protocol.Sync[k], tolerance));
+            }
+            if (protocol.Encoding == PulseEncoding::PulseWidth)
+            {
+                for (int k = 0; k < protocol.SymbolLength; k++)
+                {
+                    CBR(addInterval(protocol.Zero[k], tolerance));
+                    CBR(addInterval(protocol.One[k], tolerance));
+                }
+            }
+            else
+            {
+                // Runs of one or two half-bits, and the first half-bit merged into the end of the sync
+                CBR(addInterval(protocol.HalfBitMicros, tolerance));
+                CBR(addInterval(2 * protocol.HalfBitMicros, tolerance));
+                if (protocol.SyncLength > 0)
+                {
+                    CBR(addInterval(protocol.Sync[protocol.SyncLength - 1] + protocol.HalfBitMicros, tolerance));
+                }
+            }
+        }
+
+    Error:
+        if (!bRet)
+        {
+            m_intervalCount  = 0;
+            m_envelopeMicros = 0;
+        }
+        return bRet;
+    }
+
+    // Keeps the intervals sorted and merges overlapping ones, so a typical set of protocols ends up as a handful
+    bool PulseFilter::addInterval(uint32_t micros, byte tolerancePercent)
+    {
+        Interval interval = {micros * (100 - tolerancePercent) / 100, micros * (100 + tolerancePercent) / 100};
+        int      i        = 0;
+
+        while (i < m_intervalCount && m_intervals[i].MaxMicros < interval.MinMicros)
+        {
+            i++;
+        }
+        if (i < m_intervalCount && m_intervals[i].MinMicros <= interval.MaxMicros)
+        {
+            // Overlaps i, and possibly some after it
+            interval.MinMicros = std::min(interval.MinMicros, m_intervals[i].MinMicros);
+            while (i + 1 < m_intervalCount && m_intervals[i + 1].MinMicros <= interval.MaxMicros)
+            {
+                interval.MaxMicros = std::max(interval.MaxMicros, m_intervals[i + 1].MaxMicros);
+                memmove(&m_intervals[i + 1], &m_intervals[i + 2], (m_intervalCount - i - 2) * sizeof(Interval));
+                m_intervalCount--;
+            }
+            m_intervals[i].MinMicros = interval.MinMicros;
+            m_intervals[i].MaxMicros = std::max(interval.MaxMicros, m_intervals[i].MaxMicros);
+        }
+        else
+        {
+            if (m_intervalCount == kMaxIntervals)
+            {
+                return false;
+            }
+            memmove(&m_intervals[i + 1], &m_intervals[i], (m_intervalCount - i) * sizeof(Interval));
+            m_intervals[i] = interval;
+            m_intervalCount++;
+        }
+        m_envelopeMicros = std::max(m_envelopeMicros, interval.MaxMicros);
+        return true;
+    }
+
+    bool PulseFilter::inEnvelope(uint32_t micros) const
+    {
+        for (int i = 0; i < m_intervalCount && m_intervals[i].MinMicros <= micros; i++)
+        {
+            if (micros <= m_intervals[i].MaxMicros)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t PulseFilter::Filter(uint32_t startMicros, std::span<const Pulse> pulses, bool carrierSensed, Pulse *out, uint32_t &outStartMicros)
+    {
+        if (!m_started)
+        {
+            m_tailMicros = startMicros;
+            m_started    = true;
+        }
+        m_out            = out;
+        m_outCount       = 0;
+        m_outStartMicros = 0;
+
+        for (const Pulse &pulse : pulses)
+        {
+            // A glitch splits one pulse in two. Put them back together.
+            if (m_absorbNext)
+            {
+                m_pending.DurationMicros += pulse.DurationMicros;
+                m_absorbNext = false;
+                continue;
+            }
+            if (m_havePending && pulse.DurationMicros < m_config.MinPulseMicros)
+            {
+                m_pending.DurationMicros += pulse.DurationMicros;
+                m_absorbNext = true;
+                m_stats.Glitches++;
+                continue;
+            }
+            if (m_havePending)
+            {
+                classify(m_pending, carrierSensed);
+            }
+            m_pending     = pulse;
+            m_havePending = true;
+        }
+
+        outStartMicros = m_outStartMicros;
+        m_out          = nullptr;
+        return m_outCount;
+    }
+
+    void PulseFilter::Reset()
+    {
+        m_havePending = false;
+        m_absorbNext  = false;
+        m_heldCount   = 0;
+        m_passing     = false;
+        m_haveTail    = false;
+        m_started     = false;
+    }
+
+    void PulseFilter::classify(const Pulse &pulse, bool carrierSensed)
+    {
+        if (m_config.RequireCarrierSense && !carrierSensed)
+        {
+            rejectHeld();
+            reject(pulse, m_stats.NoCarrier);
+            return;
+        }
+        if (m_intervalCount == 0)
+        {
+            m_stats.Passed++;
+            emit(pulse);
+            return;
+        }
+        // Silence ends the burst. Pass it on if the burst made it through, so the decoders see the frame end.
+        if (!pulse.Level && pulse.DurationMicros > m_envelopeMicros)
+        {
+            rejectHeld();
+            m_stats.Passed += m_passing ? 1 : 0;
+            m_passing = false;
+            emit(pulse);
+            return;
+        }
+        if (!inEnvelope(pulse.DurationMicros))
+        {
+            rejectHeld();
+            reject(pulse, m_stats.OffProtocol);
+            return;
+        }
+        if (m_passing)
+        {
+            m_stats.Passed++;
+            emit(pulse);
+            return;
+        }
+        m_held[m_heldCount++] = pulse;
+        if (m_heldCount >= m_config.MinBurstPulses)
+        {
+            for (int i = 0; i < m_heldCount; i++)
+            {
+                emit(m_held[i]);
+            }
+            m_stats.Passed += m_heldCount;
+            m_heldCount = 0;
+            m_passing   = true;
+        }
+    }
+
+    void PulseFilter::rejectHeld()
+    {
+        for (int i = 0; i < m_heldCount; i++)
+        {
+            reject(m_held[i], m_stats.OffProtocol);
+        }
+        m_heldCount = 0;
+        m_passing   = false;
+    }
+
+    void PulseFilter::reject(const Pulse &pulse, uint32_t &counter)
+    {
+        counter++;
+        emit({pulse.DurationMicros, 0});
+    }
+
+    void PulseFilter::emit(const Pulse &pulse)
+    {
+        if (m_haveTail && m_tail.Level == pulse.Level && m_tail.DurationMicros < kMaxMergedMicros)
+        {
+            m_tail.DurationMicros += pulse.DurationMicros;
+            return;
+        }
+        if (m_haveTail)
+        {
+            if (m_outCount == 0)
+            {
+                m_outStartMicros = m_tailMicros;
+            }
+            m_out[m_outCount++] = m_tail;
+            m_tailMicros += m_tail.DurationMicros;
+        }
+        m_tail     = pulse;
+        m_haveTail = true;
+    }
+} // namespace TI_CC1101
@@ -0,0 +1,105 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <span>
+#include "PulseDecoder.h"
+
+namespace TI_CC1101
+{
+    struct PulseFilterConfig
+    {
+        // Shorter pulses are glitches. They and the pulse after them merge into the pulse before.
+        uint32_t MinPulseMicros{100};
+        // Drop pulses while the chip reports no carrier (PKTSTATUS.CS, or a GDO with GdoRole::CarrierSense).
+        // The threshold is CarrierSenseThresholdDb, and SyncMode should be one of the carrier sense modes.
+        bool     RequireCarrierSense{false};
+        // With protocols set, a burst only gets through once this many pulses in a row fit some protocol's timing
+        byte     MinBurstPulses{8};
+    };
+
+    // What the filter took out, in pulses
+    struct PulseFilterStats
+    {
+        uint32_t Glitches;
+        uint32_t NoCarrier;
+        uint32_t OffProtocol; // didn't fit any protocol's timing, or in a burst too short to qualify
+        uint32_t Passed;
+    };
+
+    // Sits between edge capture and PulseDecoderBank and keeps noise away from the decoders.
+    //
+    // The output is still one contiguous pulse stream, so timestamps stay right: whatever is filtered out becomes
+    // low, and merges with the lows around it. A second of noise comes out as a single long low. Pulses are held back
+    // while a burst qualifies, so output lags input by up to MinBurstPulses pulses.
+    class PulseFilter
+    {
+      public:
+        static const int kMaxIntervals  = 64;
+        static const int kMaxHeldPulses = 32;
+
+        // MinBurstPulses is capped at kMaxHeldPulses
+        void Configure(const PulseFilterConfig &config);
+        // Builds the timing envelope from every protocol registered with the bank. Call again after registering
+        // more. Returns false if the envelope doesn't fit, in which case protocol matching is off.
+        bool SetProtocols(const PulseDecoderBank &decoders);
+        bool RequiresCarrierSense() const { return m_config.RequireCarrierSense; }
+
+        // Returns the number of pulses written to out, which needs room for pulses.size() + kMaxHeldPulses + 2.
+        // outStartMicros is when the first of them started.
+        size_t Filter(uint32_t startMicros, std::span<const Pulse> pulses, bool carrierSensed, Pulse *out, uint32_t &outStartMicros);
+        void   Reset();
+
+        const PulseFilterStats &Stats() const { return m_stats; }
+
+      protected:
+        struct Interval
+        {
+            uint32_t MinMicros;
+            uint32_t MaxMicros;
+        };
+
+        bool addInterval(uint32_t micros, byte tolerancePercent);
+        bool inEnvelope(uint32_t micros) const;
+        void classify(const Pulse &pulse, bool carrierSensed);
+        void emit(const Pulse &pulse);
+        void reject(const Pulse &pulse, uint32_t &counter);
+        void rejectHeld();
+
+        PulseFilterConfig m_config;
+        PulseFilterStats  m_stats{};
+        Interval          m_intervals[kMaxIntervals];
+        int               m_intervalCount  = 0;
+        uint32_t          m_envelopeMicros = 0; // longest pulse any protocol uses, anything longer is silence
+
+        // Glitch stage
+        Pulse m_pending{};
+        bool  m_havePending = false;
+        bool  m_absorbNext  = false;
+
+        // Burst stage
+        Pulse m_held[kMaxHeldPulses];
+        int   m_heldCount = 0;
+        bool  m_passing   = false;
+
+        // Output. The last pulse is kept back so that lows can still merge into it.
+        bool     m_started = false;
+        Pulse    m_tail{};
+        bool     m_haveTail       = false;
+        uint32_t m_tailMicros     = 0; // when m_tail started
+        Pulse   *m_out            = nullptr;
+        size_t   m_outCount       = 0;
+        uint32_t m_outStartMicros = 0;
+    };
+} // namespace TI_CC1101
@@ -0,0 +1,45 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <stddef.h>
+#include "RadioResult.h"
+
+namespace TI_CC1101
+{
+    // The SPI transactions the CC1101 needs, as seen from the driver. SpiMaster implements it on the ESP32 (and
+    // Arduino); SimulatedRadioBus implements it on the host so code written against this runs in host builds.
+    //
+    // address is the full header byte: R/W in bit 7, burst in bit 6. outData is the chip status byte clocked out
+    // with the header, except for ReadRegister() where it is the register value. LastStatus() is the status byte
+    // from the header of the last successful call, reads included. When a call returns false, LastError() says why.
+    //
+    // ReadRegisters() does several single reads with CSn held low (Section 10.3 allows a new header right after the
+    // data byte). It is the only way to get more than one status register per transaction, since status registers
+    // can't be burst read.
+    class RadioBus
+    {
+      public:
+        virtual ~RadioBus() = default;
+
+        virtual bool WriteByte(byte toWrite, byte &outData)                                              = 0;
+        virtual bool WriteByteToAddress(byte address, byte value, byte &outData)                         = 0;
+        virtual bool WriteBytesToAddress(byte address, const byte *toWrite, size_t arrayLen, byte &outData) = 0;
+        virtual bool ReadBurstRegister(byte address, byte *toRead, size_t arrayLen)                      = 0;
+        virtual bool ReadRegister(byte addr, byte &outData)                                              = 0;
+        virtual bool ReadRegisters(const byte *addresses, byte *values, size_t count)                    = 0;
+        virtual byte       LastStatus() const = 0;
+        virtual RadioError LastError() const { return RadioError::SpiFailure; }
+    };
+} // namespace TI_CC1101
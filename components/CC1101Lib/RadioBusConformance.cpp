@@ -0,0 +1,112 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include "CC1101Lib.h"
+#include "RadioBusConformance.h"
+
+static const char *TAG = "RadioBusConformance";
+
+namespace TI_CC1101
+{
+    static const byte kReadBit  = 0b10000000;
+    static const byte kBurstBit = 0b01000000;
+
+    namespace
+    {
+        class Checker
+        {
+          public:
+            void Check(bool ok, const char *what)
+            {
+                Checks++;
+                if (!ok)
+                {
+                    Failures++;
+                    ESP_LOGE(TAG, "failed: %s", what);
+                }
+            }
+            int Checks   = 0;
+            int Failures = 0;
+        };
+    } // namespace
+
+    bool RadioBusConformance::Run(RadioBus &bus)
+    {
+        static const byte kPattern[8]  = {0xA5, 0x5A, 0x3C, 0xC3, 0x0F, 0xF0, 0x69, 0x96};
+        static const byte kStatusRegs[] = {CC1101_CONFIG::PARTNUM | kReadBit | kBurstBit, CC1101_CONFIG::VERSION | kReadBit | kBurstBit, CC1101_CONFIG::MARCSTATE | kReadBit | kBurstBit};
+        static const byte kSyncRegs[]   = {CC1101_CONFIG::SYNC1 | kReadBit, CC1101_CONFIG::SYNC0 | kReadBit, CC1101_CONFIG::PKTLEN | kReadBit};
+        Checker checker;
+        byte    status = 0;
+        byte    value  = 0;
+        byte    saved[8];
+        byte    readBack[8];
+        bool    idle   = false;
+
+        // IDLE first: SFRX/SFTX are only allowed there and the register writes below shouldn't happen in RX
+        checker.Check(bus.WriteByte(CC1101_CONFIG::SIDLE, status), "SIDLE strobe");
+        for (int polls = 0; !idle && polls < 100; polls++)
+        {
+            idle = bus.WriteByte(CC1101_CONFIG::SNOP, status) && ChipStatus::Decode(status, false).State == StatusByteStateMachineMode::IDLE;
+        }
+        checker.Check(idle, "status byte shows IDLE after SIDLE");
+        checker.Check(ChipStatus::Decode(status, false).ChipReady, "CHIP_RDYn low in the status byte");
+
+        // The FIFO field follows the R/W bit of the header
+        checker.Check(bus.WriteByte(CC1101_CONFIG::SFRX, status) && bus.WriteByte(CC1101_CONFIG::SFTX, status), "FIFO flush strobes");
+        checker.Check(bus.WriteByte(CC1101_CONFIG::SNOP | kReadBit, status) && ChipStatus::Decode(status, true).FifoBytes == 0, "SNOP with R/W set: empty RX FIFO");
+        checker.Check(bus.WriteByte(CC1101_CONFIG::SNOP, status) && ChipStatus::Decode(status, false).FifoBytes == 15, "SNOP with R/W clear: TX FIFO free");
+
+        // Single status register reads need the burst bit, and report the header's status byte
+        checker.Check(bus.ReadRegister(CC1101_CONFIG::PARTNUM | kReadBit | kBurstBit, value) && value == 0x00, "PARTNUM reads 0x00");
+        checker.Check(bus.ReadRegister(CC1101_CONFIG::VERSION | kReadBit | kBurstBit, value) && value == 0x14, "VERSION reads 0x14");
+        checker.Check(ChipStatus::Decode(bus.LastStatus(), true).State == StatusByteStateMachineMode::IDLE, "LastStatus() after a read");
+
+        // Single register write and read back
+        checker.Check(bus.ReadRegister(CC1101_CONFIG::SYNC1 | kReadBit, saved[0]), "SYNC1 read");
+        checker.Check(bus.WriteByteToAddress(CC1101_CONFIG::SYNC1, (byte)~saved[0], status), "SYNC1 write");
+        checker.Check(ChipStatus::Decode(status, false).State == StatusByteStateMachineMode::IDLE && bus.LastStatus() == status, "status byte from a register write");
+        checker.Check(bus.ReadRegister(CC1101_CONFIG::SYNC1 | kReadBit, value) && value == (byte)~saved[0], "SYNC1 reads back");
+        checker.Check(bus.WriteByteToAddress(CC1101_CONFIG::SYNC1, saved[0], status), "SYNC1 restore");
+
+        // Burst write, chained single reads, burst read
+        checker.Check(bus.ReadBurstRegister(CC1101_CONFIG::SYNC1 | kReadBit | kBurstBit, saved, 3), "SYNC1..PKTLEN burst read");
+        checker.Check(bus.WriteBytesToAddress(CC1101_CONFIG::SYNC1 | kBurstBit, kPattern, 3, status), "SYNC1..PKTLEN burst write");
+        checker.Check(bus.ReadRegisters(kSyncRegs, readBack, 3) && memcmp(readBack, kPattern, 3) == 0, "chained single reads see the burst write");
+        checker.Check(bus.WriteBytesToAddress(CC1101_CONFIG::SYNC1 | kBurstBit, saved, 3, status), "SYNC1..PKTLEN restore");
+        checker.Check(bus.ReadBurstRegister(CC1101_CONFIG::SYNC1 | kReadBit | kBurstBit, readBack, 3) && memcmp(readBack, saved, 3) == 0, "burst read sees the restore");
+
+        // PATABLE's index only resets when CSn goes high, so this fails on a backend that merges transactions
+        checker.Check(bus.ReadBurstRegister(CC1101_CONFIG::PATABLE | kReadBit | kBurstBit, saved, 8), "PATABLE burst read");
+        checker.Check(bus.WriteBytesToAddress(CC1101_CONFIG::PATABLE | kBurstBit, kPattern, 8, status), "PATABLE burst write");
+        checker.Check(bus.ReadBurstRegister(CC1101_CONFIG::PATABLE | kReadBit | kBurstBit, readBack, 8) && memcmp(readBack, kPattern, 8) == 0, "PATABLE reads back from entry 0");
+        checker.Check(bus.ReadRegister(CC1101_CONFIG::PATABLE | kReadBit, value) && value == kPattern[0], "single PATABLE read is entry 0");
+        checker.Check(bus.WriteBytesToAddress(CC1101_CONFIG::PATABLE | kBurstBit, saved, 8, status), "PATABLE restore");
+
+        // Several status registers in one transaction
+        checker.Check(bus.ReadRegisters(kStatusRegs, readBack, ARRAYSIZE(kStatusRegs)), "chained status register reads");
+        checker.Check(readBack[0] == 0x00 && readBack[1] == 0x14 && (readBack[2] & 0x1F) == (byte)MarcState::IDLE, "PARTNUM, VERSION, MARCSTATE in one transaction");
+
+        if (checker.Failures == 0)
+        {
+            ESP_LOGI(TAG, "all %d checks passed", checker.Checks);
+        }
+        else
+        {
+            ESP_LOGE(TAG, "%d of %d checks failed", checker.Failures, checker.Checks);
+        }
+        return checker.Failures == 0;
+    }
+} // namespace TI_CC1101
@@ -0,0 +1,32 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include "RadioBus.h"
+
+namespace TI_CC1101
+{
+    // Checks that a RadioBus does what the driver assumes of it: one CSn low period per call, CHIP_RDYn waited for,
+    // the status byte from the header (RX FIFO semantics on reads, TX FIFO on writes), bursts that auto-increment,
+    // PATABLE's index starting over at every transaction, and chained single reads. The same checks run on every
+    // backend: SpiMaster on ESP-IDF or Arduino against a real CC1101, and SimulatedRadioBus on the host.
+    //
+    // Flushes both FIFOs and leaves the chip in IDLE. Registers and PATABLE entries it writes are put back. Run it
+    // before CC1101Device::Init() or with the radio otherwise idle.
+    class RadioBusConformance
+    {
+      public:
+        static bool Run(RadioBus &bus); // logs each failed check
+    };
+} // namespace TI_CC1101
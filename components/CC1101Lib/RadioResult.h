@@ -0,0 +1,75 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include "LocalTypes.h"
+
+namespace TI_CC1101
+{
+    enum class RadioError : byte
+    {
+        None = 0,
+        SpiFailure,      // the SPI driver reported an error
+        ChipNotReady,    // SO (CHIP_RDYn) didn't go low after CSn, the crystal isn't running or the chip is gone
+        UnexpectedState, // MARCSTATE isn't what the operation should have left it in
+        RxFifoOverflow,
+        TxFifoUnderflow,
+        InvalidConfig,
+        UnknownChip,     // PARTNUM/VERSION don't match a CC1101
+        RegistersLost,   // configuration registers are back at their reset values, the chip reset itself (brownout)
+        NoActivity       // no edges or FIFO data for longer than the health watchdog allows
+    };
+
+    inline const char *RadioErrorName(RadioError error)
+    {
+        static const char *kNames[] = {"None", "SpiFailure", "ChipNotReady", "UnexpectedState", "RxFifoOverflow", "TxFifoUnderflow", "InvalidConfig", "UnknownChip", "RegistersLost", "NoActivity"};
+        return (size_t)error < ARRAYSIZE(kNames) ? kNames[(size_t)error] : "?";
+    }
+
+    // A value or a RadioError. Small and trivially copyable when T is, so returning one costs about what returning
+    // the value does; there's no allocation and nothing to unwind. Converts to bool (true on success) so it drops
+    // into the existing CBR()/if checks.
+    template <typename T>
+    class [[nodiscard]] Result
+    {
+      public:
+        Result(const T &value) : m_value(value) {}
+        Result(RadioError error) : m_value(), m_error(error) {}
+
+        bool       Ok() const { return m_error == RadioError::None; }
+        RadioError Error() const { return m_error; }
+        const T   &Value() const { return m_value; }
+        T          ValueOr(const T &fallback) const { return Ok() ? m_value : fallback; }
+        explicit   operator bool() const { return Ok(); }
+
+      private:
+        T          m_value;
+        RadioError m_error = RadioError::None;
+    };
+
+    template <>
+    class [[nodiscard]] Result<void>
+    {
+      public:
+        Result() = default;
+        Result(RadioError error) : m_error(error) {}
+
+        bool       Ok() const { return m_error == RadioError::None; }
+        RadioError Error() const { return m_error; }
+        explicit   operator bool() const { return Ok(); }
+
+      private:
+        RadioError m_error = RadioError::None;
+    };
+} // namespace TI_CC1101
@@ -0,0 +1,131 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstddef>
+#include <nvs.h>
+#include <esp_rom_crc.h>
+#include "RadioSnapshot.h"
+
+static const char *TAG = "RadioSnapshot";
+
+namespace TI_CC1101
+{
+    static const char *kNvsNamespace   = "cc1101";
+    static const char *kNvsSnapshotKey = "snapshot";
+
+    uint32_t RadioSnapshot::ComputeCrc() const
+    {
+        return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(this), offsetof(RadioSnapshot, Crc));
+    }
+
+    bool RadioSnapshot::IsValid(uint32_t expectedConfigHash) const
+    {
+        if (Version != kVersion)
+        {
+            ESP_LOGI(TAG, "snapshot version %d, expected %d", Version, kVersion);
+            return false;
+        }
+        if (Crc != ComputeCrc())
+        {
+            ESP_LOGW(TAG, "snapshot CRC mismatch");
+            return false;
+        }
+        if (ConfigHash != expectedConfigHash)
+        {
+            ESP_LOGI(TAG, "snapshot was taken with a different config");
+            return false;
+        }
+        return ChannelCount <= kMaxCalibratedChannels;
+    }
+
+    bool RadioSnapshotStore::Load(RadioSnapshot &snapshot)
+    {
+        bool         bRet   = true;
+        nvs_handle_t handle = 0;
+        size_t       length = sizeof(snapshot);
+        esp_err_t    ret;
+
+        ret = nvs_open(kNvsNamespace, NVS_READONLY, &handle);
+        CER(ret);
+
+        ret = nvs_get_blob(handle, kNvsSnapshotKey, &snapshot, &length);
+        CER(ret);
+        CBR(length == sizeof(snapshot));
+
+    Error:
+        if (handle != 0)
+        {
+            nvs_close(handle);
+        }
+        if (!bRet)
+        {
+            ESP_LOGI(TAG, "no usable snapshot in NVS (%d)", ret);
+        }
+        return bRet;
+    }
+
+    bool RadioSnapshotStore::Save(RadioSnapshot &snapshot)
+    {
+        bool         bRet   = true;
+        nvs_handle_t handle = 0;
+        esp_err_t    ret;
+
+        snapshot.Version = RadioSnapshot::kVersion;
+        snapshot.Crc     = snapshot.ComputeCrc();
+
+        ret = nvs_open(kNvsNamespace, NVS_READWRITE, &handle);
+        CERA(ret);
+
+        ret = nvs_set_blob(handle, kNvsSnapshotKey, &snapshot, sizeof(snapshot));
+        CERA(ret);
+
+        ret = nvs_commit(handle);
+        CERA(ret);
+
+    Error:
+        if (handle != 0)
+        {
+            nvs_close(handle);
+        }
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed (%d)", __PRETTY_FUNCTION__, ret);
+        }
+        return bRet;
+    }
+
+    bool RadioSnapshotStore::Erase()
+    {
+        bool         bRet   = true;
+        nvs_handle_t handle = 0;
+        esp_err_t    ret;
+
+        ret = nvs_open(kNvsNamespace, NVS_READWRITE, &handle);
+        CER(ret);
+
+        ret = nvs_erase_key(handle, kNvsSnapshotKey);
+        CBR(ret == ESP_OK || ret == ESP_ERR_NVS_NOT_FOUND);
+
+        ret = nvs_commit(handle);
+        CER(ret);
+
+    Error:
+        if (handle != 0)
+        {
+            nvs_close(handle);
+        }
+        return bRet;
+    }
+} // namespace TI_CC1101
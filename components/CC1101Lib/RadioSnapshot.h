@@ -0,0 +1,59 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include "CC1101Lib.h"
+
+namespace TI_CC1101
+{
+    // Result of an FS calibration (SCAL) on one channel. Writing these back, with MCSM0.FS_AUTOCAL = 0,
+    // lets the chip skip calibration when it comes back to this channel (Section 19.6).
+    struct ChannelCalibration
+    {
+        byte Channel;
+        byte FSCAL3;
+        byte FSCAL2;
+        byte FSCAL1;
+    };
+
+    // Everything needed to bring the radio back to where it was without going through regConfig()/configure() again.
+    // Stored in NVS as a single blob.
+    struct RadioSnapshot
+    {
+        // Bump this whenever the layout below, or the hardcoded values in regConfig(), change.
+        static const uint16_t kVersion               = 1;
+        static const int      kMaxCalibratedChannels = 16;
+
+        uint16_t           Version;
+        uint16_t           ChannelCount;
+        uint32_t           ConfigHash; // CC110DeviceConfig::Hash() of the config that produced this image
+        float              CarrierFrequencyMHz;
+        byte               Registers[CC1101_CONFIG::kNumConfigRegisters];
+        byte               PATable[8];
+        int8_t             FrequencyOffset; // learned FSCTRL0 value, also present in Registers
+        ChannelCalibration Channels[kMaxCalibratedChannels];
+        uint32_t           Crc; // CRC32 of everything above. Must stay the last member.
+
+        uint32_t ComputeCrc() const;
+        bool     IsValid(uint32_t expectedConfigHash) const;
+    };
+
+    class RadioSnapshotStore
+    {
+      public:
+        static bool Load(RadioSnapshot &snapshot);
+        static bool Save(RadioSnapshot &snapshot); // fills in Version and Crc
+        static bool Erase();
+    };
+} // namespace TI_CC1101
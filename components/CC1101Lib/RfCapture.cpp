@@ -0,0 +1,232 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include "RfCapture.h"
+#include "PacketKernels.h"
+
+namespace TI_CC1101
+{
+    size_t CaptureEncoder::EncodeVarint(uint32_t value, byte *out)
+    {
+        size_t length = 0;
+
+        while (value >= 0x80)
+        {
+            out[length++] = (byte)(value | 0x80);
+            value >>= 7;
+        }
+        out[length++] = (byte)value;
+        return length;
+    }
+
+    size_t CaptureEncoder::EncodeHeader(const CaptureHeader &header, byte *out)
+    {
+        memcpy(out, &header, sizeof(header));
+        return sizeof(header);
+    }
+
+    size_t CaptureEncoder::EncodePulses(uint32_t deltaMicros, const Pulse *pulses, size_t count, byte *out)
+    {
+        size_t length = 0;
+
+        out[length++] = (byte)CaptureRecordType::Pulses;
+        length += EncodeVarint(deltaMicros, out + length);
+        length += EncodeVarint((uint32_t)count, out + length);
+        for (size_t i = 0; i < count; i++)
+        {
+            // Anything longer than ~35 minutes is clamped, it's a gap and not a symbol anyway
+            uint32_t duration = pulses[i].DurationMicros < 0x7FFFFFFF ? pulses[i].DurationMicros : 0x7FFFFFFF;
+            length += EncodeVarint((duration << 1) | (pulses[i].Level & 1), out + length);
+        }
+        return length;
+    }
+
+    size_t CaptureEncoder::EncodeFifoBlock(uint32_t deltaMicros, const byte *data, size_t length, byte rssi, byte lqiCrcOk, byte *out)
+    {
+        size_t offset = 0;
+
+        out[offset++] = (byte)CaptureRecordType::FifoBlock;
+        offset += EncodeVarint(deltaMicros, out + offset);
+        offset += EncodeVarint((uint32_t)length, out + offset);
+        out[offset++] = rssi;
+        out[offset++] = lqiCrcOk;
+        memcpy(out + offset, data, length);
+        return offset + length;
+    }
+
+    bool CaptureReader::ReadHeader(CaptureHeader &header)
+    {
+        uint16_t headerLength = 0;
+
+        if (m_length < offsetof(CaptureHeader, ConfigHash))
+        {
+            return false;
+        }
+        memcpy(&header, m_data, offsetof(CaptureHeader, ConfigHash));
+        headerLength = header.HeaderLength;
+        // Records start at HeaderLength, so one shorter than this version's header would have them overlap it
+        if (header.Magic != CaptureHeader::kMagic || header.Version != CaptureHeader::kVersion || headerLength < sizeof(CaptureHeader) || headerLength > m_length)
+        {
+            return false;
+        }
+        // A newer writer may have appended fields, skip whatever we don't know about
+        memcpy(&header, m_data, sizeof(header));
+        m_offset          = headerLength;
+        m_timestamp       = 0;
+        m_pulsesRemaining = 0;
+        return true;
+    }
+
+    bool CaptureReader::Next(CaptureRecord &record)
+    {
+        uint32_t delta  = 0;
+        uint32_t length = 0;
+
+        // Skip pulses the caller didn't walk
+        while (m_pulsesRemaining > 0)
+        {
+            Pulse pulse;
+            if (!NextPulse(pulse))
+            {
+                return false;
+            }
+        }
+        if (m_offset >= m_length)
+        {
+            return false;
+        }
+        record.Type = (CaptureRecordType)m_data[m_offset++];
+        if (!readVarint(delta))
+        {
+            return false;
+        }
+        m_timestamp += delta;
+        record.TimestampMicros = m_timestamp;
+
+        switch (record.Type)
+        {
+            case CaptureRecordType::Pulses:
+                if (!readVarint(record.PulseCount))
+                {
+                    return false;
+                }
+                record.Data       = nullptr;
+                record.Length     = 0;
+                m_pulsesRemaining = record.PulseCount;
+                return true;
+            case CaptureRecordType::FifoBlock:
+                if (!readVarint(length) || m_length - m_offset < (size_t)length + 2)
+                {
+                    return false;
+                }
+                record.Rssi       = m_data[m_offset++];
+                record.LqiCrcOk   = m_data[m_offset++];
+                record.Data       = m_data + m_offset;
+                record.Length     = length;
+                record.PulseCount = 0;
+                m_offset += length;
+                return true;
+        }
+        // Unknown record type, the length isn't known so nothing after it can be trusted
+        return false;
+    }
+
+    bool CaptureReader::NextPulse(Pulse &pulse)
+    {
+        uint32_t value = 0;
+
+        if (m_pulsesRemaining == 0 || !readVarint(value))
+        {
+            m_pulsesRemaining = 0;
+            return false;
+        }
+        m_pulsesRemaining--;
+        pulse.DurationMicros = value >> 1;
+        pulse.Level          = value & 1;
+        return true;
+    }
+
+    bool CaptureReader::readVarint(uint32_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35 && m_offset < m_length; shift += 7)
+        {
+            byte current = m_data[m_offset++];
+            value |= (uint32_t)(current & 0x7F) << shift;
+            if ((current & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t CaptureFraming::Frame(const byte *chunk, size_t length, byte *out)
+    {
+        uint16_t crc = PacketKernels::Crc16(chunk, length);
+
+        memcpy(out, &kSync, 4);
+        out[4] = (byte)(length & 0xFF);
+        out[5] = (byte)(length >> 8);
+        memcpy(out + 6, chunk, length);
+        out[6 + length] = (byte)(crc & 0xFF);
+        out[7 + length] = (byte)(crc >> 8);
+        return length + kOverhead;
+    }
+
+    size_t CaptureFraming::Unframe(const byte *log, size_t logLength, byte *out, size_t *badFrames)
+    {
+        size_t offset  = 0;
+        size_t written = 0;
+        size_t bad     = 0;
+
+        while (offset + kOverhead <= logLength)
+        {
+            uint32_t sync;
+            size_t   length;
+            uint16_t crc;
+
+            memcpy(&sync, log + offset, 4);
+            if (sync != kSync)
+            {
+                offset++;
+                continue;
+            }
+            length = log[offset + 4] | (log[offset + 5] << 8);
+            if (length > kMaxChunkLength || offset + kOverhead + length > logLength)
+            {
+                bad++;
+                offset++;
+                continue;
+            }
+            crc = (uint16_t)(log[offset + 6 + length] | (log[offset + 7 + length] << 8));
+            if (crc != PacketKernels::Crc16(log + offset + 6, length))
+            {
+                bad++;
+                offset++;
+                continue;
+            }
+            memcpy(out + written, log + offset + 6, length);
+            written += length;
+            offset += kOverhead + length;
+        }
+        if (badFrames != nullptr)
+        {
+            *badFrames = bad;
+        }
+        return written;
+    }
+} // namespace TI_CC1101
@@ -0,0 +1,126 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <stddef.h>
+#include "CC1101Lib.h"
+
+namespace TI_CC1101
+{
+    // One level held for DurationMicros, as seen on the async serial data line
+    struct Pulse
+    {
+        uint32_t DurationMicros;
+        uint8_t  Level;
+    };
+
+    // Capture file (.cc1) layout, little endian:
+    //
+    //   CaptureHeader
+    //   record*
+    //
+    // Every record starts with a type byte and a varint (LEB128) time delta in microseconds from the previous record:
+    //
+    //   Pulses:    type, delta, varint count, count x varint(duration << 1 | level)
+    //   FifoBlock: type, delta, varint length, RSSI byte, LQI/CRC_OK byte, length bytes
+    //
+    // Pulses of a few hundred us take 2 bytes, which keeps hours of async traffic small enough to ship back.
+    // Deltas are 32 bit, so a writer puts out an empty Pulses record (count 0) when it has been quiet for a while;
+    // no delta then wraps, and readers add them up into a 64 bit timestamp that doesn't either.
+    enum class CaptureRecordType : byte
+    {
+        Pulses    = 1,
+        FifoBlock = 2
+    };
+
+    struct __attribute__((packed)) CaptureHeader
+    {
+        static constexpr uint32_t kMagic   = 0x43314343; // "CC1C"
+        static constexpr uint16_t kVersion = 1;
+
+        uint32_t Magic;
+        uint16_t Version;
+        uint16_t HeaderLength;  // sizeof(CaptureHeader) of the writer, records start here
+        uint32_t ConfigHash;    // CC110DeviceConfig::Hash()
+        float    CarrierFrequencyMHz;
+        uint32_t StartMicros;   // device clock when the capture started
+        byte     Registers[CC1101_CONFIG::kNumConfigRegisters]; // as read back from the chip, same as DumpRegisters()
+        byte     PATable[8];
+    };
+
+    struct CaptureRecord
+    {
+        CaptureRecordType Type;
+        uint64_t          TimestampMicros; // since the start of the capture
+        // FifoBlock
+        const byte       *Data;
+        size_t            Length;
+        byte              Rssi;
+        byte              LqiCrcOk;
+        // Pulses, walk them with CaptureReader::NextPulse()
+        uint32_t          PulseCount;
+    };
+
+    // Serializes records into caller provided buffers. No allocation, usable from the radio task.
+    class CaptureEncoder
+    {
+      public:
+        static const size_t kMaxVarintLength = 5;
+
+        static size_t EncodeVarint(uint32_t value, byte *out);
+        // Worst case size of a pulse record, to size buffers
+        static constexpr size_t MaxPulsesRecordLength(size_t pulseCount) { return 1 + 2 * kMaxVarintLength + pulseCount * kMaxVarintLength; }
+        static constexpr size_t MaxFifoRecordLength(size_t length) { return 1 + 2 * kMaxVarintLength + 2 + length; }
+
+        static size_t EncodeHeader(const CaptureHeader &header, byte *out);
+        static size_t EncodePulses(uint32_t deltaMicros, const Pulse *pulses, size_t count, byte *out);
+        static size_t EncodeFifoBlock(uint32_t deltaMicros, const byte *data, size_t length, byte rssi, byte lqiCrcOk, byte *out);
+    };
+
+    // Walks a capture held in memory (typically mmap'ed). Never reads past the end, a truncated last record ends the walk.
+    class CaptureReader
+    {
+      public:
+        CaptureReader(const byte *data, size_t length) : m_data(data), m_length(length) {}
+
+        bool ReadHeader(CaptureHeader &header);
+        bool Next(CaptureRecord &record);
+        // Only valid for the record last returned by Next()
+        bool NextPulse(Pulse &pulse);
+
+      protected:
+        bool readVarint(uint32_t &value);
+
+        const byte *m_data;
+        size_t      m_length;
+        size_t      m_offset          = 0;
+        uint64_t    m_timestamp       = 0;
+        uint32_t    m_pulsesRemaining = 0;
+    };
+
+    // Over the serial console captures share the line with log output, so each chunk of the capture stream is
+    // wrapped as: kSync (4 bytes), uint16 length, chunk, uint16 CRC16 of the chunk.
+    class CaptureFraming
+    {
+      public:
+        static const uint32_t kSync           = 0x52314343; // "CC1R"
+        static const size_t   kOverhead       = 8;
+        static const size_t   kMaxChunkLength = 1024;
+
+        static size_t Frame(const byte *chunk, size_t length, byte *out);
+        // Pulls the capture stream back out of a serial log, skipping anything that isn't a valid frame.
+        // Returns the number of bytes written to out, which needs to be at least logLength long.
+        static size_t Unframe(const byte *log, size_t logLength, byte *out, size_t *badFrames = nullptr);
+    };
+} // namespace TI_CC1101
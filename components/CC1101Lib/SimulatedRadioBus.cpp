@@ -0,0 +1,241 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include "SimulatedRadioBus.h"
+
+namespace TI_CC1101
+{
+    static const byte kReadBit  = 0b10000000;
+    static const byte kBurstBit = 0b01000000;
+
+    // Headers 0x30..0x3D without the burst bit are strobes. Anything else in a one byte transaction is a header
+    // whose data never came, which the chip ignores.
+    bool SimulatedRadioBus::WriteByte(byte toWrite, byte &outData)
+    {
+        byte address = toWrite & 0b00111111;
+
+        if (!begin(1))
+        {
+            return false;
+        }
+        // Like the chip, the status byte shows the state before the strobe takes effect
+        outData = m_lastStatus = statusByte(toWrite);
+        if ((toWrite & kBurstBit) == 0 && address >= CC1101_CONFIG::SRES && address <= CC1101_CONFIG::SNOP)
+        {
+            strobe(address);
+        }
+        return true;
+    }
+
+    bool SimulatedRadioBus::WriteByteToAddress(byte address, byte value, byte &outData)
+    {
+        if (!begin(2))
+        {
+            return false;
+        }
+        outData = m_lastStatus = statusByte(address);
+        write(address & 0b00111111, value, 0);
+        m_patableIndex = 0;
+        return true;
+    }
+
+    bool SimulatedRadioBus::WriteBytesToAddress(byte address, const byte *toWrite, size_t arrayLen, byte &outData)
+    {
+        if (!begin(1 + arrayLen))
+        {
+            return false;
+        }
+        outData = m_lastStatus = statusByte(address);
+        for (size_t i = 0; i < arrayLen; i++)
+        {
+            write(address & 0b00111111, toWrite[i], (address & kBurstBit) != 0 ? (int)i : 0);
+        }
+        m_patableIndex = 0;
+        return true;
+    }
+
+    bool SimulatedRadioBus::ReadBurstRegister(byte address, byte *toRead, size_t arrayLen)
+    {
+        if (!begin(1 + arrayLen))
+        {
+            return false;
+        }
+        m_lastStatus = statusByte(address);
+        for (size_t i = 0; i < arrayLen; i++)
+        {
+            toRead[i] = read(address, (address & kBurstBit) != 0 ? (int)i : 0);
+        }
+        m_patableIndex = 0;
+        return true;
+    }
+
+    bool SimulatedRadioBus::ReadRegister(byte addr, byte &outData)
+    {
+        if (!begin(2))
+        {
+            return false;
+        }
+        m_lastStatus   = statusByte(addr);
+        outData        = read(addr, 0);
+        m_patableIndex = 0;
+        return true;
+    }
+
+    bool SimulatedRadioBus::ReadRegisters(const byte *addresses, byte *values, size_t count)
+    {
+        if (!begin(2 * count))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            m_lastStatus = statusByte(addresses[i]);
+            values[i]    = read(addresses[i], 0);
+        }
+        m_patableIndex = 0;
+        return true;
+    }
+
+    void SimulatedRadioBus::FailNext(int count, RadioError error)
+    {
+        m_failuresLeft = count;
+        m_failure      = error;
+    }
+
+    bool SimulatedRadioBus::begin(size_t bytes)
+    {
+        m_transactions++;
+        m_busBytes += bytes;
+        if (m_failuresLeft > 0)
+        {
+            m_failuresLeft--;
+            m_lastError = m_failure;
+            return false;
+        }
+        return true;
+    }
+
+    void SimulatedRadioBus::reset()
+    {
+        static const byte kResetPATable[8] = {0xC6, 0, 0, 0, 0, 0, 0, 0};
+
+        memcpy(m_registers, ConfigValues::CONFIG_REGISTER_RESET_VALUES, sizeof(m_registers));
+        memcpy(m_patable, kResetPATable, sizeof(m_patable));
+        m_state = MarcState::IDLE;
+    }
+
+    void SimulatedRadioBus::strobe(byte command)
+    {
+        switch (command)
+        {
+            case CC1101_CONFIG::SRES:
+                reset();
+                break;
+            case CC1101_CONFIG::SIDLE:
+            case CC1101_CONFIG::SCAL:
+            case CC1101_CONFIG::SFRX:
+            case CC1101_CONFIG::SFTX:
+                m_state = MarcState::IDLE;
+                break;
+            case CC1101_CONFIG::SRX:
+                m_state = MarcState::RX;
+                break;
+            case CC1101_CONFIG::STX:
+                m_state = MarcState::TX;
+                break;
+            case CC1101_CONFIG::SFSTXON:
+                m_state = MarcState::FSTXON;
+                break;
+            case CC1101_CONFIG::SXOFF:
+            case CC1101_CONFIG::SPWD:
+                m_state = MarcState::SLEEP;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // CHIP_RDYn low, STATE in bits 6:4 (Table 23), FIFO_BYTES_AVAILABLE left at 0
+    // The FIFO field is RX bytes available for reads and TX bytes free for writes. There are no FIFO contents, so
+    // that is an empty RX FIFO and a TX FIFO with room for (at least) 15.
+    byte SimulatedRadioBus::statusByte(byte header) const
+    {
+        StatusByteStateMachineMode mode      = StatusByteStateMachineMode::IDLE;
+        byte                       fifoBytes = (header & kReadBit) != 0 ? 0 : 0x0F;
+
+        switch (m_state)
+        {
+            case MarcState::RX:
+                mode = StatusByteStateMachineMode::ReceiveMode;
+                break;
+            case MarcState::TX:
+                mode = StatusByteStateMachineMode::TransmitMode;
+                break;
+            case MarcState::FSTXON:
+                mode = StatusByteStateMachineMode::FastTXReady;
+                break;
+            default:
+                break;
+        }
+        return (byte)(((int)mode << 4) | fifoBytes);
+    }
+
+    byte SimulatedRadioBus::readStatusRegister(byte address) const
+    {
+        switch (address)
+        {
+            case CC1101_CONFIG::PARTNUM:
+                return kPartNum;
+            case CC1101_CONFIG::VERSION:
+                return kVersion;
+            case CC1101_CONFIG::RSSI:
+                return m_rssi;
+            case CC1101_CONFIG::MARCSTATE:
+                return (byte)m_state;
+            default:
+                return 0;
+        }
+    }
+
+    void SimulatedRadioBus::write(byte address, byte value, int index)
+    {
+        if (address == CC1101_CONFIG::PATABLE)
+        {
+            m_patable[m_patableIndex++ & 7] = value;
+        }
+        else if (address + index < CC1101_CONFIG::kNumConfigRegisters)
+        {
+            m_registers[address + index] = value;
+        }
+    }
+
+    byte SimulatedRadioBus::read(byte address, int index) const
+    {
+        bool burst = (address & kBurstBit) != 0;
+
+        address &= 0b00111111;
+        if (address == CC1101_CONFIG::PATABLE)
+        {
+            return m_patable[(m_patableIndex + index) & 7];
+        }
+        // Status registers share addresses with the strobes and are only reachable with the burst bit set
+        if (address >= CC1101_CONFIG::PARTNUM && address <= CC1101_CONFIG::RCCTRL0_STATUS)
+        {
+            return burst ? readStatusRegister(address) : statusByte(kReadBit);
+        }
+        return address + index < CC1101_CONFIG::kNumConfigRegisters ? m_registers[address + index] : 0;
+    }
+} // namespace TI_CC1101
@@ -0,0 +1,76 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include "CC1101Lib.h"
+#include "RadioBus.h"
+
+namespace TI_CC1101
+{
+    // A CC1101 behind a RadioBus, for host builds. Models the register file and PATABLE, the strobes that move
+    // the main state machine between IDLE, RX and TX, the status registers the driver polls and the chip status
+    // byte. No RF, no FIFO contents, and state changes are instantaneous.
+    //
+    // Counts transactions and bytes so host code can see what a sequence of operations costs on the bus, and can be
+    // told to fail transactions to exercise error handling.
+    class SimulatedRadioBus : public RadioBus
+    {
+      public:
+        static const byte kPartNum = 0x00;
+        static const byte kVersion = 0x14;
+
+        SimulatedRadioBus() { reset(); }
+
+        bool WriteByte(byte toWrite, byte &outData) override;
+        bool WriteByteToAddress(byte address, byte value, byte &outData) override;
+        bool WriteBytesToAddress(byte address, const byte *toWrite, size_t arrayLen, byte &outData) override;
+        bool ReadBurstRegister(byte address, byte *toRead, size_t arrayLen) override;
+        bool ReadRegister(byte addr, byte &outData) override;
+        bool ReadRegisters(const byte *addresses, byte *values, size_t count) override;
+        byte       LastStatus() const override { return m_lastStatus; }
+        RadioError LastError() const override { return m_lastError; }
+
+        byte      Register(byte address) const { return m_registers[address]; }
+        const byte *PATable() const { return m_patable; }
+        MarcState State() const { return m_state; }
+        void      SetRssi(byte rssi) { m_rssi = rssi; }
+
+        uint32_t Transactions() const { return m_transactions; } // CS low periods
+        uint32_t BusBytes() const { return m_busBytes; }         // header and data bytes clocked
+        void     ResetCounters() { m_transactions = m_busBytes = 0; }
+        // The next count transactions fail with error and change nothing
+        void     FailNext(int count, RadioError error);
+
+      protected:
+        bool begin(size_t bytes);
+        void reset();
+        void strobe(byte command);
+        byte statusByte(byte header) const;
+        byte readStatusRegister(byte address) const;
+        void write(byte address, byte value, int index);
+        byte read(byte address, int index) const;
+
+        byte       m_registers[CC1101_CONFIG::kNumConfigRegisters];
+        byte       m_patable[8];
+        int        m_patableIndex = 0; // PATABLE access goes through a counter that resets when CS goes high
+        MarcState  m_state        = MarcState::IDLE;
+        byte       m_rssi         = 0x80;
+        uint32_t   m_transactions = 0;
+        uint32_t   m_busBytes     = 0;
+        int        m_failuresLeft = 0;
+        RadioError m_failure      = RadioError::None;
+        RadioError m_lastError    = RadioError::None;
+        byte       m_lastStatus   = 0;
+    };
+} // namespace TI_CC1101
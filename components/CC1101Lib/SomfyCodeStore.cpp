@@ -0,0 +1,249 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstddef>
+#include <stdio.h>
+#include <string.h>
+#include <esp_rom_crc.h>
+#include "SomfyCodeStore.h"
+
+static const char *TAG = "SomfyCodeStore";
+
+namespace TI_CC1101
+{
+    static const char *kNvsNamespace = "cc1101";
+
+    namespace
+    {
+        void chunkKey(int chunk, int slot, char (&key)[NVS_KEY_NAME_MAX_SIZE])
+        {
+            snprintf(key, sizeof(key), "somfy%d.%d", chunk, slot);
+        }
+    } // namespace
+
+    uint32_t SomfyCodeStore::StoredChunk::ComputeCrc() const
+    {
+        return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(this), offsetof(StoredChunk, Crc));
+    }
+
+    SomfyCodeStore::SomfyCodeStore()
+    {
+        for (Remote &remote : m_remotes)
+        {
+            remote = {kNoRemote, 0, 0};
+        }
+    }
+
+    bool SomfyCodeStore::Load()
+    {
+        bool         bRet   = true;
+        nvs_handle_t handle = 0;
+        esp_err_t    ret;
+
+        ret = nvs_open(kNvsNamespace, NVS_READONLY, &handle);
+        // Nothing was ever saved
+        CBR(ret == ESP_OK || ret == ESP_ERR_NVS_NOT_FOUND);
+        for (int chunk = 0; chunk < kChunks && ret == ESP_OK; chunk++)
+        {
+            CBR(loadChunk(handle, chunk));
+        }
+        m_loaded = true;
+        ESP_LOGI(TAG, "%d remotes", RemoteCount());
+
+    Error:
+        if (handle != 0)
+        {
+            nvs_close(handle);
+        }
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed (%d)", __PRETTY_FUNCTION__, ret);
+        }
+        return bRet;
+    }
+
+    // Takes the newest slot that checks out. Every remote restarts at its limit: whatever it used before the reboot
+    // was below that.
+    bool SomfyCodeStore::loadChunk(nvs_handle_t handle, int chunk)
+    {
+        StoredChunk stored;
+        StoredChunk newest;
+        bool        found = false;
+        char        key[NVS_KEY_NAME_MAX_SIZE];
+
+        for (int slot = 0; slot < kSlots; slot++)
+        {
+            size_t    length = sizeof(stored);
+            esp_err_t ret;
+
+            chunkKey(chunk, slot, key);
+            ret = nvs_get_blob(handle, key, &stored, &length);
+            if (ret == ESP_ERR_NVS_NOT_FOUND)
+            {
+                continue;
+            }
+            if (ret != ESP_OK || length != sizeof(stored) || stored.Version != StoredChunk::kVersion || stored.Crc != stored.ComputeCrc())
+            {
+                ESP_LOGW(TAG, "ignoring %s (%d)", key, ret);
+                continue;
+            }
+            if (!found || (int32_t)(stored.Sequence - newest.Sequence) > 0)
+            {
+                newest = stored;
+                found  = true;
+            }
+        }
+        if (!found)
+        {
+            return true;
+        }
+        m_sequences[chunk] = newest.Sequence;
+        for (int i = 0; i < kRemotesPerChunk; i++)
+        {
+            const StoredRemote &storedRemote = newest.Remotes[i];
+            m_remotes[chunk * kRemotesPerChunk + i] = {storedRemote.Address, storedRemote.Limit, storedRemote.Limit};
+        }
+        return true;
+    }
+
+    bool SomfyCodeStore::saveChunk(int chunk, bool topUp)
+    {
+        bool         bRet   = true;
+        nvs_handle_t handle = 0;
+        Remote      *remotes = &m_remotes[chunk * kRemotesPerChunk];
+        StoredChunk  stored;
+        char         key[NVS_KEY_NAME_MAX_SIZE];
+        esp_err_t    ret;
+
+        memset(&stored, 0, sizeof(stored));
+        stored.Sequence = m_sequences[chunk] + 1;
+        stored.Version  = StoredChunk::kVersion;
+        for (int i = 0; i < kRemotesPerChunk; i++)
+        {
+            stored.Remotes[i] = {remotes[i].Address, remotes[i].Limit, 0};
+            if (topUp && remotes[i].Address != kNoRemote && (uint16_t)(remotes[i].Limit - remotes[i].Next) < kReserveBlock / 2)
+            {
+                stored.Remotes[i].Limit = remotes[i].Next + kReserveBlock;
+            }
+        }
+        stored.Crc = stored.ComputeCrc();
+        chunkKey(chunk, stored.Sequence % kSlots, key);
+
+        ret = nvs_open(kNvsNamespace, NVS_READWRITE, &handle);
+        CER(ret);
+
+        ret = nvs_set_blob(handle, key, &stored, sizeof(stored));
+        CER(ret);
+
+        ret = nvs_commit(handle);
+        CER(ret);
+
+        m_sequences[chunk] = stored.Sequence;
+        m_flashWrites++;
+        for (int i = 0; i < kRemotesPerChunk; i++)
+        {
+            remotes[i].Limit = stored.Remotes[i].Limit;
+        }
+
+    Error:
+        if (handle != 0)
+        {
+            nvs_close(handle);
+        }
+        if (!bRet)
+        {
+            ESP_LOGE(TAG, "%s failed (%d)", __PRETTY_FUNCTION__, ret);
+        }
+        return bRet;
+    }
+
+    int SomfyCodeStore::find(uint32_t address) const
+    {
+        for (int i = 0; i < kMaxRemotes; i++)
+        {
+            if (m_remotes[i].Address == address)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int SomfyCodeStore::RemoteCount() const
+    {
+        int count = 0;
+
+        for (const Remote &remote : m_remotes)
+        {
+            count += (remote.Address != kNoRemote) ? 1 : 0;
+        }
+        return count;
+    }
+
+    /// @param address 24 bit remote address, as the receiver will learn it
+    /// @param firstCode the first rolling code this remote sends
+    bool SomfyCodeStore::AddRemote(uint32_t address, uint16_t firstCode)
+    {
+        bool bRet  = true;
+        int  index = find(kNoRemote);
+
+        CBRA(m_loaded);
+        CBR(address <= 0xFFFFFF && !HasRemote(address));
+        CBR(index >= 0);
+
+        m_remotes[index] = {address, firstCode, firstCode};
+        bRet             = saveChunk(index / kRemotesPerChunk, true);
+        if (!bRet)
+        {
+            m_remotes[index].Address = kNoRemote;
+        }
+
+    Error:
+        return bRet;
+    }
+
+    bool SomfyCodeStore::RemoveRemote(uint32_t address)
+    {
+        bool bRet  = true;
+        int  index = find(address);
+
+        CBR(index >= 0);
+        m_remotes[index].Address = kNoRemote;
+        bRet                     = saveChunk(index / kRemotesPerChunk, false);
+        if (!bRet)
+        {
+            m_remotes[index].Address = address;
+        }
+
+    Error:
+        return bRet;
+    }
+
+    bool SomfyCodeStore::NextCode(uint32_t address, uint16_t &code)
+    {
+        bool bRet  = true;
+        int  index = find(address);
+
+        CBR(index >= 0);
+        if (m_remotes[index].Next == m_remotes[index].Limit)
+        {
+            CBR(saveChunk(index / kRemotesPerChunk, true));
+        }
+        code = m_remotes[index].Next++;
+
+    Error:
+        return bRet;
+    }
+} // namespace TI_CC1101
@@ -0,0 +1,95 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <nvs.h>
+#include "CC1101Lib.h"
+
+namespace TI_CC1101
+{
+    // Rolling codes for virtual Somfy RTS remotes. A receiver drops any frame whose code it has already seen, so a
+    // code must never go out twice, across reboots and crashes too.
+    //
+    // Counters live in RAM. What goes to NVS is, for every remote, a limit: the first code not yet handed out is
+    // always below it. When a remote reaches its limit the next kReserveBlock codes are reserved with one write. After
+    // a reboot every remote restarts at its limit, skipping whatever was reserved but not used.
+    //
+    // Remotes are grouped kRemotesPerChunk to an NVS blob, so a reservation rewrites one small chunk and tops up
+    // every remote in it. Each chunk alternates between kSlots keys with a sequence number and a CRC; a write torn
+    // by a crash leaves the previous slot, whose limits are still safe, in charge.
+    class SomfyCodeStore
+    {
+      public:
+        static const int      kMaxRemotes      = 256;
+        static const int      kRemotesPerChunk = 32;
+        static const int      kChunks          = kMaxRemotes / kRemotesPerChunk;
+        static const int      kSlots           = 2;
+        static const uint16_t kReserveBlock    = 64; // NVS writes per press <= 1/kReserveBlock
+        static const uint32_t kNoRemote        = 0xFFFFFFFF; // addresses are 24 bits
+
+        SomfyCodeStore();
+
+        // Reads every chunk back from NVS. Call once before anything else.
+        bool Load();
+        bool AddRemote(uint32_t address, uint16_t firstCode = 1);
+        bool RemoveRemote(uint32_t address);
+        bool HasRemote(uint32_t address) const { return find(address) >= 0; }
+        int  RemoteCount() const;
+
+        // The code to send in the next frame from this remote. Only fails if NVS does, in which case nothing is
+        // handed out.
+        bool NextCode(uint32_t address, uint16_t &code);
+
+        uint32_t FlashWrites() const { return m_flashWrites; }
+
+      protected:
+        struct StoredRemote
+        {
+            uint32_t Address;
+            uint16_t Limit;
+            uint16_t Reserved;
+        };
+
+        struct StoredChunk
+        {
+            static const uint16_t kVersion = 1;
+
+            uint32_t     Sequence;
+            uint16_t     Version;
+            uint16_t     Reserved;
+            StoredRemote Remotes[kRemotesPerChunk];
+            uint32_t     Crc; // CRC32 of everything above. Must stay the last member.
+
+            uint32_t ComputeCrc() const;
+        };
+
+        struct Remote
+        {
+            uint32_t Address;
+            uint16_t Next;
+            uint16_t Limit;
+        };
+
+        int  find(uint32_t address) const;
+        bool loadChunk(nvs_handle_t handle, int chunk);
+        // topUp reserves another block for every remote in the chunk that has used up half of its current one.
+        // The new limits only take effect in RAM once they are in NVS.
+        bool saveChunk(int chunk, bool topUp);
+
+        Remote   m_remotes[kMaxRemotes];
+        uint32_t m_sequences[kChunks] = {};
+        uint32_t m_flashWrites        = 0;
+        bool     m_loaded             = false;
+    };
+} // namespace TI_CC1101
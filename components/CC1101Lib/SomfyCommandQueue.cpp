@@ -0,0 +1,174 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include "SomfyCommandQueue.h"
+
+static const char *TAG = "SomfyCommandQueue";
+
+namespace TI_CC1101
+{
+    void SomfyCommandQueue::SetReportCallback(SomfyReportCallback callback, void *context)
+    {
+        m_reportCallback = callback;
+        m_reportContext  = context;
+    }
+
+    bool SomfyCommandQueue::Enqueue(uint32_t address, SomfyCommand command)
+    {
+        bool           bRet          = true;
+        uint32_t       enqueueMicros = micros();
+        QueuedCommand *queued        = nullptr;
+
+        CBR(m_codes.HasRemote(address));
+
+        if (isMovement(command))
+        {
+            for (int i = 0; i < m_count; i++)
+            {
+                if (m_commands[i].Address == address && isMovement(m_commands[i].Command))
+                {
+                    if (command == SomfyCommand::My && m_commands[i].Command != SomfyCommand::My)
+                    {
+                        // Stopping a move that never went out: sending My alone would go to the favourite position
+                        QueuedCommand stop = {address, command, m_commands[i].EnqueueMicros, 0, 0, {}};
+
+                        report(m_commands[i], SomfyOutcome::Cancelled);
+                        report(stop, SomfyOutcome::Cancelled);
+                        std::copy(m_commands + i + 1, m_commands + m_count, m_commands + i);
+                        m_count--;
+                        return true;
+                    }
+                    report(m_commands[i], SomfyOutcome::Coalesced);
+                    enqueueMicros = m_commands[i].EnqueueMicros;
+                    queued        = &m_commands[i];
+                    break;
+                }
+            }
+        }
+        if (queued == nullptr)
+        {
+            CBR(m_count < kMaxCommands);
+            queued = &m_commands[m_count++];
+        }
+        queued->Address       = address;
+        queued->Command       = command;
+        queued->EnqueueMicros = enqueueMicros;
+        queued->RollingCode   = 0;
+        queued->LatencyMicros = 0;
+
+    Error:
+        if (!bRet)
+        {
+            ESP_LOGW(TAG, "dropping command %d for %06lX, %d queued", (int)command, (unsigned long)address, m_count);
+        }
+        return bRet;
+    }
+
+    uint32_t SomfyCommandQueue::Process()
+    {
+        uint32_t now     = micros();
+        uint32_t elapsed = 0;
+
+        if (m_count == 0)
+        {
+            return 0;
+        }
+        for (int i = 0; i < m_count; i++)
+        {
+            elapsed = std::max(elapsed, now - m_commands[i].EnqueueMicros);
+        }
+        if (elapsed < kBatchWindowMicros)
+        {
+            return kBatchWindowMicros - elapsed;
+        }
+        transmitBatch();
+        return 0;
+    }
+
+    void SomfyCommandQueue::transmitBatch()
+    {
+        Pulse        pulses[SomfyFrame::kMaxPulses];
+        size_t       pulseCount  = 0;
+        int          ready       = 0;
+        uint32_t     startMicros = micros();
+        SomfyOutcome outcome     = SomfyOutcome::Sent;
+
+        // Codes are taken right before sending. A command that can't get one fails on its own.
+        for (int i = 0; i < m_count; i++)
+        {
+            QueuedCommand &command = m_commands[i];
+            if (!m_codes.NextCode(command.Address, command.RollingCode))
+            {
+                report(command, SomfyOutcome::Failed);
+                continue;
+            }
+            SomfyFrame::Encode(command.Address, command.Command, command.RollingCode, command.Frame);
+            m_commands[ready++] = command;
+        }
+        m_count = ready;
+
+        if (m_count > 0 && !m_device.BeginAsyncTransmit())
+        {
+            for (int i = 0; i < m_count; i++)
+            {
+                report(m_commands[i], SomfyOutcome::Failed);
+            }
+            m_count = 0;
+        }
+        if (m_count == 0)
+        {
+            return;
+        }
+
+        for (int repeat = 0; repeat <= m_repeats; repeat++)
+        {
+            for (int i = 0; i < m_count; i++)
+            {
+                QueuedCommand &command = m_commands[i];
+
+                pulseCount = SomfyFrame::ToPulses(command.Frame, repeat == 0 && i == 0,
+                                                  repeat == 0 ? SomfyFrame::kFirstHardwareSyncs : SomfyFrame::kRepeatHardwareSyncs, pulses);
+                m_device.TransmitPulses(std::span<const Pulse>(pulses, pulseCount));
+                if (repeat == 0)
+                {
+                    command.LatencyMicros = micros() - command.EnqueueMicros;
+                }
+            }
+        }
+        if (!m_device.EndAsyncTransmit())
+        {
+            ESP_LOGE(TAG, "radio not back to receiving normally after the batch");
+            outcome = SomfyOutcome::SentNotListening;
+        }
+
+        ESP_LOGI(TAG, "%d commands, %d frames in %lu ms", m_count, m_count * (m_repeats + 1), (unsigned long)((micros() - startMicros) / 1000));
+        for (int i = 0; i < m_count; i++)
+        {
+            report(m_commands[i], outcome);
+        }
+        m_count = 0;
+    }
+
+    void SomfyCommandQueue::report(const QueuedCommand &command, SomfyOutcome outcome)
+    {
+        SomfyReport report = {command.Address, command.Command, outcome, command.RollingCode, command.LatencyMicros};
+
+        if (m_reportCallback != nullptr)
+        {
+            m_reportCallback(report, m_reportContext);
+        }
+    }
+} // namespace TI_CC1101
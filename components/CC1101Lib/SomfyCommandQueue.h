@@ -0,0 +1,103 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include "CC1101Device.h"
+#include "SomfyCodeStore.h"
+#include "SomfyFrame.h"
+
+namespace TI_CC1101
+{
+    enum class SomfyOutcome
+    {
+        Sent,
+        SentNotListening, // sent, but the radio couldn't go back to receiving normally afterwards (GDO0 interrupt)
+        Coalesced, // replaced by a later command for the same remote before it went out
+        Cancelled, // a movement and the My that stopped it before either went out; neither is sent
+        Failed     // no rolling code (NVS) or the radio wouldn't go into TX
+    };
+
+    struct SomfyReport
+    {
+        uint32_t     Address;
+        SomfyCommand Command;
+        SomfyOutcome Outcome;
+        uint16_t     RollingCode;
+        uint32_t     LatencyMicros; // first enqueue for this remote to the end of its first frame, when the blind acts
+    };
+
+    typedef void (*SomfyReportCallback)(const SomfyReport &report, void *context);
+
+    // Batches Somfy RTS commands so that moving many blinds costs one transmission instead of one per blind.
+    //
+    // - Commands wait kBatchWindowMicros after the oldest one so others can join the batch.
+    // - Up, Down and My for a remote that already has one queued replace it: the latest wins, the earlier one is
+    //   reported as Coalesced. Its enqueue time carries over so the latency covers the whole request.
+    // - My for a remote with an unsent Up or Down drops both, reported as Cancelled. The blind never started moving,
+    //   and a lone My would send it to its favourite position instead.
+    // - A batch is one async TX session: the chip stays in TX across all frames and only goes back to RX at the end.
+    //   The ~100 ms wakeup pulse is sent once per batch rather than per command.
+    // - First frames go out round-robin before any repeats, so blind N acts after N frames, not N * (repeats + 1).
+    //
+    // Process() blocks for the length of the batch (about 116 ms per frame). Not thread safe, call from the task
+    // that owns the radio, as with TransmitScheduler.
+    class SomfyCommandQueue
+    {
+      public:
+        static const int      kMaxCommands       = 64;
+        static const uint32_t kBatchWindowMicros = 100000;
+        static const int      kDefaultRepeats    = 2;
+
+        SomfyCommandQueue(CC1101Device &device, SomfyCodeStore &codes) : m_device(device), m_codes(codes) {}
+
+        void SetReportCallback(SomfyReportCallback callback, void *context);
+        void SetRepeats(int repeats) { m_repeats = repeats; }
+
+        // Returns false if the queue is full or the remote isn't in the code store
+        bool Enqueue(uint32_t address, SomfyCommand command);
+
+        // Sends the batch once its window has passed. Returns the number of microseconds until it wants to be called
+        // again (0 if the queue is empty).
+        uint32_t Process();
+
+        int QueuedCommands() const { return m_count; }
+
+      protected:
+        struct QueuedCommand
+        {
+            uint32_t     Address;
+            SomfyCommand Command;
+            uint32_t     EnqueueMicros;
+            uint16_t     RollingCode;
+            uint32_t     LatencyMicros;
+            byte         Frame[SomfyFrame::kLength];
+        };
+
+        static bool isMovement(SomfyCommand command)
+        {
+            return command == SomfyCommand::Up || command == SomfyCommand::Down || command == SomfyCommand::My;
+        }
+
+        void transmitBatch();
+        void report(const QueuedCommand &command, SomfyOutcome outcome);
+
+        CC1101Device       &m_device;
+        SomfyCodeStore     &m_codes;
+        QueuedCommand       m_commands[kMaxCommands];
+        int                 m_count          = 0;
+        int                 m_repeats        = kDefaultRepeats;
+        SomfyReportCallback m_reportCallback = nullptr;
+        void               *m_reportContext  = nullptr;
+    };
+} // namespace TI_CC1101
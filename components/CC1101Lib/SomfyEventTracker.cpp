@@ -0,0 +1,191 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "SomfyEventTracker.h"
+
+namespace TI_CC1101
+{
+    void SomfyEventTracker::SetCallback(SomfyEventCallback callback, void *context)
+    {
+        m_callback = callback;
+        m_context  = context;
+    }
+
+    bool SomfyEventTracker::Feed(const DecodedFrame &frame)
+    {
+        uint32_t     address;
+        SomfyCommand command;
+        uint16_t     rollingCode;
+        uint32_t     now = frame.TimestampMicros;
+        int          index;
+
+        if (frame.BitCount != 8 * SomfyFrame::kLength || !SomfyFrame::Decode(frame.Bits, address, command, rollingCode))
+        {
+            return false;
+        }
+        m_frames++;
+        Expire(now);
+
+        index = find(address);
+        if (index >= 0)
+        {
+            Entry &entry = m_entries[index];
+
+            // Another repeat of the last press. Once it has been released it is a late one: SomfyCommandQueue sends a
+            // blind's repeats one round-robin pass apart, which is more than kRepeatGapMicros with a few blinds in the
+            // batch. The motor ignores a code it has already seen, so it isn't a replay either.
+            if (entry.RollingCode == rollingCode)
+            {
+                if (!entry.Pressed)
+                {
+                    return true;
+                }
+                entry.Repeats++;
+                entry.LastMicros = now;
+                if (!entry.HoldSent && now - entry.FirstMicros >= kHoldMicros)
+                {
+                    entry.HoldSent = true;
+                    emit(SomfyEventKind::Hold, entry, now);
+                }
+                return true;
+            }
+            // Codes only move forward. The remote's state stays as it was.
+            if ((int16_t)(rollingCode - entry.RollingCode) < 0)
+            {
+                Entry replayed       = entry;
+                replayed.RollingCode = rollingCode;
+                replayed.Command     = command;
+                replayed.Repeats     = 0;
+                replayed.FirstMicros = now;
+                replayed.LastMicros  = now;
+                emit(SomfyEventKind::Replay, replayed, now);
+                return true;
+            }
+            // A new press before the last one timed out
+            if (entry.Pressed)
+            {
+                entry.Pressed = false;
+                emit(SomfyEventKind::Release, entry, now);
+            }
+        }
+        else
+        {
+            index = insert(address);
+        }
+
+        m_entries[index] = {address, rollingCode, command, true, true, false, 0, now, now};
+        emit(SomfyEventKind::Press, m_entries[index], now);
+        return true;
+    }
+
+    void SomfyEventTracker::Expire(uint32_t nowMicros)
+    {
+        for (Entry &entry : m_entries)
+        {
+            if (entry.Used && entry.Pressed && (int32_t)(nowMicros - entry.LastMicros) > (int32_t)kRepeatGapMicros)
+            {
+                entry.Pressed = false;
+                emit(SomfyEventKind::Release, entry, nowMicros);
+            }
+        }
+    }
+
+    int SomfyEventTracker::find(uint32_t address) const
+    {
+        for (int i = hash(address);; i = (i + 1) & (kCapacity - 1))
+        {
+            if (!m_entries[i].Used)
+            {
+                return -1;
+            }
+            if (m_entries[i].Address == address)
+            {
+                return i;
+            }
+        }
+    }
+
+    int SomfyEventTracker::insert(uint32_t address)
+    {
+        int i;
+
+        if (m_count >= kCapacity * 3 / 4)
+        {
+            evictOldest();
+        }
+        for (i = hash(address); m_entries[i].Used; i = (i + 1) & (kCapacity - 1))
+        {
+        }
+        m_entries[i].Used    = true;
+        m_entries[i].Address = address;
+        m_count++;
+        return i;
+    }
+
+    // Prefers remotes that aren't in the middle of a press
+    void SomfyEventTracker::evictOldest()
+    {
+        int oldest = -1;
+
+        for (int i = 0; i < kCapacity; i++)
+        {
+            const Entry &entry = m_entries[i];
+            if (!entry.Used)
+            {
+                continue;
+            }
+            if (oldest < 0 || (m_entries[oldest].Pressed && !entry.Pressed) ||
+                (m_entries[oldest].Pressed == entry.Pressed && (int32_t)(entry.LastMicros - m_entries[oldest].LastMicros) < 0))
+            {
+                oldest = i;
+            }
+        }
+        if (oldest >= 0)
+        {
+            remove(oldest);
+        }
+    }
+
+    // Backward shift: pull later entries of the probe chain into the hole unless their home slot lies cyclically
+    // after the hole, in which case moving them would put them before their home.
+    void SomfyEventTracker::remove(int index)
+    {
+        int hole = index;
+
+        m_entries[hole].Used = false;
+        m_count--;
+        for (int i = (hole + 1) & (kCapacity - 1); m_entries[i].Used; i = (i + 1) & (kCapacity - 1))
+        {
+            int home = hash(m_entries[i].Address);
+            if (((i - home) & (kCapacity - 1)) >= ((i - hole) & (kCapacity - 1)))
+            {
+                m_entries[hole]   = m_entries[i];
+                m_entries[i].Used = false;
+                hole              = i;
+            }
+        }
+    }
+
+    void SomfyEventTracker::emit(SomfyEventKind kind, const Entry &entry, uint32_t timestampMicros)
+    {
+        SomfyEvent event = {kind, entry.Address, entry.Command, entry.RollingCode, entry.Repeats, entry.LastMicros - entry.FirstMicros, timestampMicros};
+
+        m_events++;
+        if (m_callback != nullptr)
+        {
+            m_callback(event, m_context);
+        }
+    }
+} // namespace TI_CC1101
@@ -0,0 +1,97 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include "PulseDecoder.h"
+#include "SomfyFrame.h"
+
+namespace TI_CC1101
+{
+    enum class SomfyEventKind : byte
+    {
+        Press,   // first frame of a new rolling code
+        Hold,    // the same press is still repeating after kHoldMicros, once per press
+        Release, // no repeat for kRepeatGapMicros. Repeats and PressMicros are final, later repeats are ignored.
+        Replay   // code older than the last one accepted from this remote: a replay, or frames out of order
+    };
+
+    struct SomfyEvent
+    {
+        SomfyEventKind Kind;
+        uint32_t       Address;
+        SomfyCommand   Command;
+        uint16_t       RollingCode;
+        uint16_t       Repeats;         // frames after the first
+        uint32_t       PressMicros;     // first frame to the start of the last one
+        uint32_t       TimestampMicros; // start of the frame that caused the event, or when the press expired
+    };
+
+    typedef void (*SomfyEventCallback)(const SomfyEvent &event, void *context);
+
+    // Turns the stream of decoded Somfy frames into press/hold/release events.
+    //
+    // Remotes live in an open-addressed (linear probing) table keyed on the address. Each entry holds the rolling
+    // code of the press in progress, which is what a repeat has to match, and stays after the press is released so
+    // that an old code showing up again is caught as a Replay. When the table fills up, the remote heard from least
+    // recently is evicted; deletion shifts the probe chain back, so there are no tombstones.
+    class SomfyEventTracker
+    {
+      public:
+        static const int      kCapacityBits    = 6;
+        static const int      kCapacity        = 1 << kCapacityBits; // filled to at most 3/4
+        static const uint32_t kRepeatGapMicros = 250000;              // repeats come every ~145 ms
+        static const uint32_t kHoldMicros      = 2000000;
+
+        void SetCallback(SomfyEventCallback callback, void *context);
+
+        // Frames that aren't 56 bit Somfy frames with a good checksum are ignored. Returns whether it was used.
+        bool Feed(const DecodedFrame &frame);
+        // Releases presses that stopped repeating. Call every so often even when no frames come in.
+        void Expire(uint32_t nowMicros);
+
+        int      TrackedRemotes() const { return m_count; }
+        uint32_t Frames() const { return m_frames; }
+        uint32_t Events() const { return m_events; }
+
+      protected:
+        struct Entry
+        {
+            uint32_t     Address;
+            uint16_t     RollingCode;
+            SomfyCommand Command;
+            bool         Used;
+            bool         Pressed;
+            bool         HoldSent;
+            uint16_t     Repeats;
+            uint32_t     FirstMicros;
+            uint32_t     LastMicros;
+        };
+
+        // Fibonacci hashing, the top bits of the product
+        static int hash(uint32_t address) { return (int)((address * 0x9E3779B1u) >> (32 - kCapacityBits)); }
+
+        int  find(uint32_t address) const;
+        int  insert(uint32_t address);
+        void evictOldest();
+        void remove(int index);
+        void emit(SomfyEventKind kind, const Entry &entry, uint32_t timestampMicros);
+
+        Entry              m_entries[kCapacity] = {};
+        int                m_count              = 0;
+        uint32_t           m_frames             = 0;
+        uint32_t           m_events             = 0;
+        SomfyEventCallback m_callback           = nullptr;
+        void              *m_context            = nullptr;
+    };
+} // namespace TI_CC1101
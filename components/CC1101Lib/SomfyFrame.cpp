@@ -0,0 +1,112 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "SomfyFrame.h"
+
+namespace TI_CC1101
+{
+    namespace
+    {
+        // Adjacent pulses of the same level (a 0 bit after a 1 bit, the software sync low and a 1 bit) are one pulse
+        void addPulse(Pulse *pulses, size_t &count, uint32_t durationMicros, byte level)
+        {
+            if (count > 0 && pulses[count - 1].Level == level)
+            {
+                pulses[count - 1].DurationMicros += durationMicros;
+                return;
+            }
+            pulses[count++] = {durationMicros, level};
+        }
+    } // namespace
+
+    void SomfyFrame::Encode(uint32_t address, SomfyCommand command, uint16_t rollingCode, byte (&frame)[kLength])
+    {
+        byte checksum = 0;
+
+        frame[0] = 0xA7; // "key", receivers don't check it
+        frame[1] = (byte)command << 4;
+        frame[2] = rollingCode >> 8;
+        frame[3] = rollingCode & 0xFF;
+        frame[4] = (address >> 16) & 0xFF;
+        frame[5] = (address >> 8) & 0xFF;
+        frame[6] = address & 0xFF;
+
+        // XOR of every nibble goes in the low nibble of byte 1
+        for (byte value : frame)
+        {
+            checksum ^= value ^ (value >> 4);
+        }
+        frame[1] |= checksum & 0x0F;
+
+        for (int i = 1; i < kLength; i++)
+        {
+            frame[i] ^= frame[i - 1];
+        }
+    }
+
+    bool SomfyFrame::Decode(uint64_t bits, uint32_t &address, SomfyCommand &command, uint16_t &rollingCode)
+    {
+        byte frame[kLength];
+        byte checksum = 0;
+
+        for (int i = 0; i < kLength; i++)
+        {
+            frame[i] = (bits >> (8 * (kLength - 1 - i))) & 0xFF;
+        }
+        for (int i = kLength - 1; i > 0; i--)
+        {
+            frame[i] ^= frame[i - 1];
+        }
+        // The checksum nibble makes the XOR of all nibbles zero
+        for (byte value : frame)
+        {
+            checksum ^= value ^ (value >> 4);
+        }
+        if ((checksum & 0x0F) != 0)
+        {
+            return false;
+        }
+        command     = (SomfyCommand)(frame[1] >> 4);
+        rollingCode = (frame[2] << 8) | frame[3];
+        address     = (frame[4] << 16) | (frame[5] << 8) | frame[6];
+        return true;
+    }
+
+    size_t SomfyFrame::ToPulses(const byte (&frame)[kLength], bool wakeup, int hardwareSyncs, Pulse *pulses)
+    {
+        size_t count = 0;
+
+        if (wakeup)
+        {
+            addPulse(pulses, count, kWakeupHighMicros, 1);
+            addPulse(pulses, count, kWakeupLowMicros, 0);
+        }
+        for (int i = 0; i < hardwareSyncs && i < kRepeatHardwareSyncs; i++)
+        {
+            addPulse(pulses, count, kHardwareSyncMicros, 1);
+            addPulse(pulses, count, kHardwareSyncMicros, 0);
+        }
+        addPulse(pulses, count, kSoftwareSyncMicros, 1);
+        addPulse(pulses, count, kHalfBitMicros, 0);
+        for (int bit = 0; bit < 8 * kLength; bit++)
+        {
+            byte value = (frame[bit / 8] >> (7 - bit % 8)) & 1;
+            addPulse(pulses, count, kHalfBitMicros, value ? 0 : 1);
+            addPulse(pulses, count, kHalfBitMicros, value ? 1 : 0);
+        }
+        addPulse(pulses, count, kInterFrameGapMicros, 0);
+        return count;
+    }
+} // namespace TI_CC1101
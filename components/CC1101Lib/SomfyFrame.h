@@ -0,0 +1,58 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <stddef.h>
+#include "RfCapture.h"
+
+namespace TI_CC1101
+{
+    enum class SomfyCommand : byte
+    {
+        My      = 0x1, // stop, or go to the favourite position when not moving
+        Up      = 0x2,
+        MyUp    = 0x3,
+        Down    = 0x4,
+        MyDown  = 0x5,
+        UpDown  = 0x6,
+        Prog    = 0x8,
+        SunFlag = 0x9,
+        Flag    = 0xA
+    };
+
+    // Somfy RTS frames: 7 bytes (key, command + checksum, rolling code, address), each byte XORed with the one
+    // before it, sent as 56 Manchester bits with 640 us half-bits. Rising edge = 1, same as KnownProtocols::Somfy.
+    class SomfyFrame
+    {
+      public:
+        static const int      kLength               = 7;
+        static const int      kFirstHardwareSyncs   = 2;
+        static const int      kRepeatHardwareSyncs  = 7;
+        static const uint32_t kHalfBitMicros        = 640;
+        static const uint32_t kHardwareSyncMicros   = 2416;
+        static const uint32_t kSoftwareSyncMicros   = 4550;
+        static const uint32_t kWakeupHighMicros     = 9415;
+        static const uint32_t kWakeupLowMicros      = 89565;
+        static const uint32_t kInterFrameGapMicros  = 30415;
+        // Wakeup, 7 hardware syncs, software sync, 56 bits and the gap, before merging
+        static const int      kMaxPulses            = 2 + 2 * kRepeatHardwareSyncs + 2 + 2 * 8 * kLength + 1;
+
+        static void   Encode(uint32_t address, SomfyCommand command, uint16_t rollingCode, byte (&frame)[kLength]);
+        // bits as PulseDecoderBank delivers them, first byte in the top 8 of 56. False if the checksum is off.
+        static bool   Decode(uint64_t bits, uint32_t &address, SomfyCommand &command, uint16_t &rollingCode);
+        // Writes the frame as pulses, ending with the inter-frame gap. The wakeup pulse is only needed before the
+        // first frame of a transmission. Returns the pulse count.
+        static size_t ToPulses(const byte (&frame)[kLength], bool wakeup, int hardwareSyncs, Pulse *pulses);
+    };
+} // namespace TI_CC1101
@@ -18,6 +18,12 @@
 
 static const char *TAG = "SpiMaster";
 
+// The Arduino core owns the SPI peripheral. SPI.begin() runs once in Init(); every RadioBus call is then one
+// SPI.beginTransaction()/endTransaction() pair with CSn low in between, same as the ESP-IDF backend. CSn stays a
+// plain GPIO (SPI.begin() gets no SS pin) because the chip has to be watched for CHIP_RDYn after CSn goes low.
+// Strobes and single register access use the single access clock, with header and data as separate
+// SPI.transfer() calls; bursts and chained reads use the burst clock (see SpiTiming).
+
 namespace TI_CC1101
 {
 
@@ -27,126 +33,157 @@ SpiMaster::SpiMaster()
 
 SpiMaster::~SpiMaster()
 {
+    SPI.end();
 }
 
 bool SpiMaster::Init(const SpiConfig &cfg)
 {
-    bool bRet = true;
-    esp_err_t ret;
+    static const uint8_t kSpiModes[] = {SPI_MODE0, SPI_MODE1, SPI_MODE2, SPI_MODE3};
 
-    m_config = cfg;
-    startTransaction();
+    m_config        = cfg;
+    m_settings      = SPISettings(cfg.SingleAccessClockHz(), MSBFIRST, kSpiModes[(int)cfg.spiMode & 3]);
+    m_burstSettings = SPISettings(cfg.BurstClockHz(), MSBFIRST, kSpiModes[(int)cfg.spiMode & 3]);
 
-    digitalWrite(cfg.chipSelectPin,HIGH);
-    digitalWrite(cfg.clockPin,HIGH);
-    digitalWrite(cfg.mosiPin,LOW);
+    pinMode(cfg.chipSelectPin, OUTPUT);
+    digitalWrite(cfg.chipSelectPin, HIGH);
 
-    endTransaction();
+    SPI.begin(cfg.clockPin, cfg.misoPin, cfg.mosiPin, -1);
+    if (cfg.hardwareChipSelect)
+    {
+        ESP_LOGW(TAG, "hardware chip select is ESP-IDF only, driving CSn as a GPIO");
+    }
+    ESP_LOGI(TAG, "SPI at %d Hz single access, %d Hz burst, mode %d", cfg.SingleAccessClockHz(), cfg.BurstClockHz(), (int)cfg.spiMode);
 
     return true;
 }
 bool SpiMaster::WriteByte(byte toWrite, byte& outData)
 {
-    startTransaction();
-
-    lowerChipSelect();
-    waitForMisoLow();
-    outData = SPI.transfer(toWrite);
-    raiseChipSelect();
-    endTransaction();
+    if (!beginChipTransaction(m_settings))
+    {
+        return false;
+    }
+    outData      = SPI.transfer(toWrite);
+    m_lastStatus = outData;
+    endChipTransaction();
 
     return true;
 }
-
 bool SpiMaster::WriteByteToAddress(byte address, byte value, byte&  outData)
 {
-    startTransaction();
-    lowerChipSelect();
-    waitForMisoLow();
-
-    outData  = SPI.transfer(address);
-    outData  = SPI.transfer(value);
-
-    raiseChipSelect();
-    endTransaction();
+    if (!beginChipTransaction(m_settings))
+    {
+        return false;
+    }
+    outData      = SPI.transfer(address);
+    m_lastStatus = outData;
+    SPI.transfer(value);
+    endChipTransaction();
 
     return true;
 }
-bool SpiMaster::WriteBytesToAddress(byte address,byte *toWrite, size_t arrayLen, byte& outData)
+bool SpiMaster::WriteBytesToAddress(byte address,const byte *toWrite, size_t arrayLen, byte& outData)
 {
-    startTransaction();
-    lowerChipSelect();
-    waitForMisoLow();
-
-    SPI.transfer(address);
-    for(size_t si= 0; si< arrayLen;si++)
+    if (!beginChipTransaction(m_burstSettings))
     {
-        outData = SPI.transfer(toWrite[si]);
+        return false;
     }
-
-    raiseChipSelect();
-    endTransaction();
+    outData      = SPI.transfer(address);
+    m_lastStatus = outData;
+    SPI.transferBytes(toWrite, nullptr, arrayLen);
+    endChipTransaction();
 
     return true;
 }
 bool SpiMaster::ReadBurstRegister(byte address, byte *toRead, size_t arrayLen)
 {
-    startTransaction();
-    lowerChipSelect();
-    waitForMisoLow();
-
-    SPI.transfer(address);
-    for(size_t si = 0; si < arrayLen; si++)
+    if (!beginChipTransaction(m_burstSettings))
     {
-        toRead[si] = SPI.transfer(0);
+        return false;
     }
-    raiseChipSelect();
-
-    endTransaction();
+    m_lastStatus = SPI.transfer(address);
+    // Clock out zeros, like the ESP-IDF backend, and read in place
+    memset(toRead, 0, arrayLen);
+    SPI.transferBytes(toRead, toRead, arrayLen);
+    endChipTransaction();
 
     return true;
 }
 bool SpiMaster::ReadRegister(byte addr, byte& outData)
 {
-    byte ignore = 0;
-    startTransaction();
-    lowerChipSelect();
-    waitForMisoLow();
-
-    ignore = SPI.transfer(addr);
-    outData = SPI.transfer(0);
+    if (!beginChipTransaction(m_settings))
+    {
+        return false;
+    }
+    m_lastStatus = SPI.transfer(addr);
+    outData      = SPI.transfer(0);
+    endChipTransaction();
 
-    raiseChipSelect();
-    endTransaction();
     return true;
 }
-void SpiMaster::startTransaction()
+bool SpiMaster::ReadRegisters(const byte *addresses, byte *values, size_t count)
 {
-    pinMode(m_config.mosiPin,OUTPUT);
-    pinMode(m_config.misoPin,INPUT);
-    pinMode(m_config.clockPin,OUTPUT);
-    pinMode(m_config.chipSelectPin,OUTPUT);
+    if (!beginChipTransaction(m_burstSettings))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        m_lastStatus = SPI.transfer(addresses[i]);
+        values[i]    = SPI.transfer(0);
+    }
+    endChipTransaction();
 
-    SPI.begin(m_config.clockPin,m_config.misoPin,m_config.mosiPin,m_config.chipSelectPin);
+    return true;
 }
-void SpiMaster::endTransaction()
+// CSn is always a GPIO here, so there is nothing to hand over
+bool SpiMaster::BeginManualChipSelect()
 {
-    SPI.end();
+    return true;
+}
+bool SpiMaster::EndManualChipSelect()
+{
+    return true;
+}
+// Claims the bus with the given clock and this device's mode, lowers CSn and waits for CHIP_RDYn
+bool SpiMaster::beginChipTransaction(const SPISettings &settings)
+{
+    SPI.beginTransaction(settings);
+    lowerChipSelect();
+    if (!waitForMisoLow())
+    {
+        endChipTransaction();
+        return false;
+    }
+    return true;
+}
+void SpiMaster::endChipTransaction()
+{
+    raiseChipSelect();
+    SPI.endTransaction();
 }
 void SpiMaster::lowerChipSelect()
 {
     digitalWrite(m_config.chipSelectPin, 0);
-
 }
 
 void SpiMaster::raiseChipSelect()
 {
     digitalWrite(m_config.chipSelectPin, 1);
 }
-void SpiMaster::waitForMisoLow()
+bool SpiMaster::waitForMisoLow()
 {
+    uint32_t startMicros = micros();
+
     while(digitalRead(m_config.misoPin))
+    {
+        if (micros() - startMicros > kChipReadyTimeoutMicros)
+        {
+            m_lastError = RadioError::ChipNotReady;
+            return false;
+        }
         delayMicroseconds(1);
+    }
+    return true;
 }
 
-} // namespace
\ No newline at end of file
+} // namespace
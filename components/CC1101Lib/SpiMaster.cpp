@@ -16,18 +16,47 @@
 #include "SpiMaster.h"
 
 static const char *TAG = "SpiMaster";
+// SPI_CLK_SRC_DEFAULT is the 80 MHz APB clock
+static const int kSpiSourceClockHz = 80'000'000;
 
 namespace TI_CC1101
 {
 
+// The driver picks the divider that gets closest to the requested clock, which can be above it (6.5 MHz becomes
+// 80/12 = 6.67 MHz). These limits are maximums, so ask for a clock the divider hits exactly.
+static int clockAtMost(int hz)
+{
+    return kSpiSourceClockHz / ((kSpiSourceClockHz + hz - 1) / hz);
+}
+
+// Strobes after which the crystal is (or will be) off until CSn goes low again
+static bool stopsCrystal(byte header)
+{
+    byte strobe = header & 0b00111111;
+    return strobe == CC1101_CONFIG::SRES || strobe == CC1101_CONFIG::SPWD || strobe == CC1101_CONFIG::SXOFF ||
+           strobe == CC1101_CONFIG::SWOR;
+}
+
+static spi_host_device_t hostOf(const SpiConfig &cfg)
+{
+    return cfg.spiHost == Esp32SPIHost::HOST_HSPI ? HSPI_HOST : VSPI_HOST;
+}
+
+// Whole SCLK cycles covering a delay, for cs_ena_pretrans/cs_ena_posttrans
+static int cyclesCovering(uint32_t nanos, int hz)
+{
+    int cycles = (int)(((uint64_t)nanos * hz + 999'999'999) / 1'000'000'000);
+    return cycles < 1 ? 1 : cycles;
+}
+
 SpiMaster::SpiMaster()
 {
 }
 
 SpiMaster::~SpiMaster()
 {
-    spi_bus_remove_device(m_DeviceHandle);
-    spi_bus_free(m_config.spiHost == Esp32SPIHost::HOST_HSPI ? HSPI_HOST : VSPI_HOST);
+    removeDevices();
+    spi_bus_free(hostOf(m_config));
 }
 
 bool SpiMaster::Init(const SpiConfig &cfg)
@@ -51,147 +80,299 @@ bool SpiMaster::Init(const SpiConfig &cfg)
         .isr_cpu_id = ESP_INTR_CPU_AFFINITY_AUTO,
         .intr_flags = 0
     };
+
+    ret = spi_bus_initialize(hostOf(cfg),  &busConfig,kDmaChannelToUse);
+
+    ESP_LOGI(TAG, "spi_bus_initialize() returned %d", ret);
+    CERA(ret);
+
+    CBRA(addDevices(cfg.hardwareChipSelect));
+
+Error:
+    if(!bRet)
+    {
+        ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+    }
+    return bRet;
+}
+bool SpiMaster::addDevices(bool hardwareChipSelect)
+{
+    bool      bRet = true;
+    esp_err_t ret  = ESP_OK;
     spi_device_interface_config_t deviceConfig = {
         .command_bits = 0,// No command bits
         .address_bits = 0,
         .dummy_bits = 0,
-        .mode = static_cast<uint8_t>(cfg.spiMode),
+        .mode = static_cast<uint8_t>(m_config.spiMode),
         .clock_source = SPI_CLK_SRC_DEFAULT,
         .duty_cycle_pos = 0,
         .cs_ena_pretrans = 0,
         .cs_ena_posttrans = 0,
-        .clock_speed_hz = cfg.clockFrequencyHz,
+        .clock_speed_hz = clockAtMost(m_config.SingleAccessClockHz()),
         .input_delay_ns = 0,
-        .spics_io_num = -1,// Required because we'll be managing the CS high/low ourselves.
+        .spics_io_num = -1,// CS is a GPIO unless hardwareChipSelect
         .flags = 0,
-        .queue_size = cfg.queueSize,
+        .queue_size = m_config.queueSize,
         .pre_cb = nullptr,
         .post_cb = nullptr
     };
 
-    gpio_reset_pin(cfg.chipSelectPin);
-    gpio_set_direction(cfg.chipSelectPin, GPIO_MODE_OUTPUT);
-    gpio_set_level(cfg.chipSelectPin, 1);
-
-    spi_host_device_t host_id = (cfg.spiHost == Esp32SPIHost::HOST_HSPI ? HSPI_HOST : VSPI_HOST);
-    ret = spi_bus_initialize(host_id,  &busConfig,kDmaChannelToUse);
+    if (hardwareChipSelect)
+    {
+        // A CSn pin follows one device's CS signal, so this is a single device. Everything runs at the burst
+        // clock, which also lets single register accesses go out as one transfer.
+        deviceConfig.clock_speed_hz   = clockAtMost(m_config.BurstClockHz());
+        deviceConfig.spics_io_num     = m_config.chipSelectPin;
+        // Full duplex takes at most one cycle of pretrans; at these clocks one cycle is well over t_sp anyway
+        deviceConfig.cs_ena_pretrans  = 1;
+        deviceConfig.cs_ena_posttrans = cyclesCovering(SpiTiming::kChipSelectHoldNanos, deviceConfig.clock_speed_hz);
+        ret = spi_bus_add_device(hostOf(m_config), &deviceConfig, &m_DeviceHandle);
+        CER(ret);
+        m_BurstDeviceHandle = m_DeviceHandle;
+        ESP_LOGI(TAG, "SPI at %d Hz, hardware CSn", deviceConfig.clock_speed_hz);
+    }
+    else
+    {
+        gpio_reset_pin(m_config.chipSelectPin);
+        gpio_set_direction(m_config.chipSelectPin, GPIO_MODE_OUTPUT);
+        gpio_set_level(m_config.chipSelectPin, 1);
 
-    ESP_LOGI(TAG, "spi_bus_initialize() returned %d", ret);
-    CERA(ret);
+        ret = spi_bus_add_device(hostOf(m_config), &deviceConfig, &m_DeviceHandle);
+        CER(ret);
 
-    ret = spi_bus_add_device(host_id,&deviceConfig,&m_DeviceHandle);
-    ESP_LOGI(TAG, "spi_bus_add_device() returned %d", ret);
-    CERA(ret);
+        // Same chip, same (manual) CSn, slower clock. The driver switches clocks when the device changes.
+        deviceConfig.clock_speed_hz = clockAtMost(m_config.BurstClockHz());
+        ret = spi_bus_add_device(hostOf(m_config), &deviceConfig, &m_BurstDeviceHandle);
+        CER(ret);
+        ESP_LOGI(TAG, "SPI at %d Hz single access, %d Hz burst", clockAtMost(m_config.SingleAccessClockHz()), deviceConfig.clock_speed_hz);
+    }
+    m_hardwareChipSelect = hardwareChipSelect;
 
 Error:
-    if(!bRet)
+    if (!bRet)
     {
-        ESP_LOGE(TAG, "%s failed", __PRETTY_FUNCTION__);
+        m_lastError = RadioError::SpiFailure;
+        ESP_LOGE(TAG, "spi_bus_add_device() returned %d", ret);
     }
     return bRet;
 }
-bool SpiMaster::WriteByte(byte toWrite, byte& outData)
+void SpiMaster::removeDevices()
 {
-    bool              bRet = true;
-    esp_err_t         retCode;
-    spi_transaction_t transaction;
-
-    intializeDefaultTransaction(transaction);
-    transaction.length    = 8;
-    transaction.tx_buffer = &toWrite;
-    transaction.rx_buffer = &outData;
-
-    retCode = spi_device_transmit(m_DeviceHandle, &transaction);
-    CERA(retCode);
-
-Error:
-    if (!bRet)
+    if (m_BurstDeviceHandle != nullptr && m_BurstDeviceHandle != m_DeviceHandle)
     {
-        ESP_LOGE(TAG, "%s failed, spi_device_transmit returned -> 0x%X", __PRETTY_FUNCTION__,retCode);
+        spi_bus_remove_device(m_BurstDeviceHandle);
     }
-    return bRet;
+    if (m_DeviceHandle != nullptr)
+    {
+        spi_bus_remove_device(m_DeviceHandle);
+    }
+    m_DeviceHandle      = nullptr;
+    m_BurstDeviceHandle = nullptr;
+}
+bool SpiMaster::BeginManualChipSelect()
+{
+    if (!m_hardwareChipSelect)
+    {
+        return true;
+    }
+    removeDevices();
+    return addDevices(false);
+}
+bool SpiMaster::EndManualChipSelect()
+{
+    if (!m_config.hardwareChipSelect || m_hardwareChipSelect)
+    {
+        return true;
+    }
+    removeDevices();
+    return addDevices(true);
+}
+bool SpiMaster::WriteByte(byte toWrite, byte& outData)
+{
+    bool ok = access([&]() {
+        if (!transfer(m_DeviceHandle, &toWrite, &outData, 1, false))
+        {
+            return false;
+        }
+        m_lastStatus = outData;
+        return true;
+    });
+
+    m_crystalMayBeOff = m_crystalMayBeOff || stopsCrystal(toWrite);
+    return ok;
 }
 
 bool SpiMaster::WriteByteToAddress(byte address, byte value, byte&  outData)
 {
-    bool              bRet = true;
-    esp_err_t         retCode;
-    spi_transaction_t transaction;
+    byte request[2] = {address, value};
+    byte reply[2]   = {0, 0};
 
-    intializeDefaultTransaction(transaction);
-    transaction.flags      = SPI_TRANS_USE_TXDATA;
-    transaction.length  = 16;
-    transaction.tx_data[0] = address;
-    transaction.tx_data[1] = value;
-    transaction.rx_buffer = &outData;
-    retCode = spi_device_transmit(m_DeviceHandle, &transaction);
-    CERA(retCode);
-Error:
-    if (!bRet)
-    {
-        ESP_LOGE(TAG, "%s failed, spi_device_transmit returned ->  0x%X", __PRETTY_FUNCTION__,retCode);
-    }
-    return bRet;
+    return access([&]() {
+        if (!singleAccess(request, reply))
+        {
+            return false;
+        }
+        outData      = reply[0];
+        m_lastStatus = outData;
+        return true;
+    });
 }
-bool SpiMaster::WriteBytesToAddress(byte address,byte *toWrite, size_t arrayLen, byte& outData)
+bool SpiMaster::WriteBytesToAddress(byte address,const byte *toWrite, size_t arrayLen, byte& outData)
 {
-    bool              bRet = true;
-    esp_err_t         retCode;
-    spi_transaction_t transaction;
+    // The whole burst has to happen inside one CS low period, otherwise the chip treats each byte as a new header.
+    return access([&]() {
+        if (!transfer(m_BurstDeviceHandle, &address, &outData, 1, true) ||
+            !transfer(m_BurstDeviceHandle, toWrite, nullptr, arrayLen, false))
+        {
+            return false;
+        }
+        m_lastStatus = outData;
+        return true;
+    });
+}
+bool SpiMaster::ReadBurstRegister(byte address, byte *toRead, size_t arrayLen)
+{
+    byte status = 0;
 
-    intializeDefaultTransaction(transaction);
-    transaction.flags      = SPI_TRANS_USE_TXDATA;
-    transaction.length  = 1;
-    transaction.tx_data[0] = address;
-    transaction.rx_buffer = &outData;
-    retCode = spi_device_transmit(m_DeviceHandle, &transaction);
-    CERA(retCode);
+    return access([&]() {
+        if (!transfer(m_BurstDeviceHandle, &address, &status, 1, true))
+        {
+            return false;
+        }
+        // Clock out zeros and read in place. Without DMA the driver copies out of and back into the buffer.
+        memset(toRead, 0, arrayLen);
+        if (!transfer(m_BurstDeviceHandle, toRead, toRead, arrayLen, false))
+        {
+            return false;
+        }
+        m_lastStatus = status;
+        return true;
+    });
+}
+bool SpiMaster::ReadRegister(byte address, byte& outData)
+{
+    byte request[2] = {address, 0};
+    byte reply[2]   = {0, 0};
 
-    intializeDefaultTransaction(transaction);
-    transaction.tx_buffer = toWrite;
-    transaction.length  = arrayLen;
-    transaction.rx_buffer = &outData;
-    retCode = spi_device_transmit(m_DeviceHandle, &transaction);
-    CERA(retCode);
+    return access([&]() {
+        if (!singleAccess(request, reply))
+        {
+            return false;
+        }
+        outData      = reply[1];
+        m_lastStatus = reply[0];
+        return true;
+    });
+}
+bool SpiMaster::ReadRegisters(const byte *addresses, byte *values, size_t count)
+{
+    byte request[2] = {0, 0};
+    byte reply[2]   = {0, 0};
 
-Error:
-    if (!bRet)
+    // Each header/data pair goes back to back, so this runs at the burst clock
+    return access([&]() {
+        for (size_t i = 0; i < count; i++)
+        {
+            request[0] = addresses[i];
+            if (!transfer(m_BurstDeviceHandle, request, reply, 2, i + 1 < count))
+            {
+                return false;
+            }
+            values[i] = reply[1];
+            // CHIP_RDYn is only checked on the first header
+            if (i == 0)
+            {
+                m_lastStatus = reply[0];
+            }
+        }
+        return true;
+    });
+}
+// On the single access clock header and data go as separate transfers, which leaves the t_sd gap that clock needs.
+// With hardware CSn everything runs at the burst clock and they go back to back.
+bool SpiMaster::singleAccess(const byte request[2], byte reply[2])
+{
+    if (m_hardwareChipSelect)
     {
-        ESP_LOGE(TAG, "%s failed, spi_device_transmit returned ->  0x%X", __PRETTY_FUNCTION__,retCode);
+        return transfer(m_DeviceHandle, request, reply, 2, false);
     }
-
-    return bRet;
+    return transfer(m_DeviceHandle, &request[0], &reply[0], 1, true) && transfer(m_DeviceHandle, &request[1], &reply[1], 1, false);
 }
-bool SpiMaster::ReadBurstRegister(byte address, byte *toRead, size_t arrayLen)
+// With CSn on a GPIO: lower it and wait for CHIP_RDYn. With hardware CSn: hold the bus, so that CSn can be kept
+// low across the transfers of one call.
+bool SpiMaster::beginChipTransaction()
 {
-    bool bRet = true;
-    byte statusCode;
-
+    if (m_hardwareChipSelect)
+    {
+        esp_err_t ret = spi_device_acquire_bus(m_DeviceHandle, portMAX_DELAY);
+        if (ret != ESP_OK)
+        {
+            m_lastError = RadioError::SpiFailure;
+            ESP_LOGE(TAG, "spi_device_acquire_bus() returned %d", ret);
+            return false;
+        }
+        return true;
+    }
     lowerChipSelect();
-    waitForMisoLow();
-    CBRA(WriteByte(address, statusCode));
-    for (size_t si = 0; si < arrayLen; si++)
+    if (!waitForMisoLow())
+    {
+        raiseChipSelect();
+        return false;
+    }
+    return true;
+}
+void SpiMaster::endChipTransaction()
+{
+    if (m_hardwareChipSelect)
     {
-        CBRA(WriteByte(0, statusCode));
-        toRead[si] = statusCode;
+        spi_device_release_bus(m_DeviceHandle);
+        return;
     }
     raiseChipSelect();
-Error:
-    return bRet;
 }
-bool SpiMaster::ReadRegister(byte address, byte& outData)
+// CSn low as a GPIO until SO shows CHIP_RDYn, then high again. The crystal keeps running (IDLE) afterwards.
+bool SpiMaster::wakeChip()
 {
-    byte ignore = 0;
-    bool bRet   = true;
+    bool ready = false;
 
+    if (!BeginManualChipSelect())
+    {
+        return false;
+    }
     lowerChipSelect();
-    waitForMisoLow();
-    CBRA(WriteByte(address, ignore));
-    CBRA(WriteByte(0, outData));
+    ready = waitForMisoLow();
     raiseChipSelect();
+    if (!EndManualChipSelect())
+    {
+        return false;
+    }
+    m_crystalMayBeOff = !ready;
+    return ready;
+}
+bool SpiMaster::chipWasReady() const
+{
+    return !m_hardwareChipSelect || ChipStatus::Decode(m_lastStatus, false).ChipReady;
+}
+// Polling rather than queued: every transfer here is a few bytes and the caller waits for it anyway, and the
+// interrupt round trip of spi_device_transmit() costs more than the bytes themselves.
+bool SpiMaster::transfer(spi_device_handle_t device, const byte *toWrite, byte *toRead, size_t length, bool keepSelected)
+{
+    spi_transaction_t transaction;
+    esp_err_t         retCode;
 
-Error:
-    return bRet;
+    intializeDefaultTransaction(transaction);
+    transaction.flags     = (keepSelected && m_hardwareChipSelect) ? SPI_TRANS_CS_KEEP_ACTIVE : 0;
+    transaction.length    = length * 8; // bits
+    transaction.tx_buffer = toWrite;
+    transaction.rx_buffer = toRead;
+    retCode = spi_device_polling_transmit(device, &transaction);
+    if (retCode != ESP_OK)
+    {
+        m_lastError = RadioError::SpiFailure;
+        ESP_LOGE(TAG, "%s failed, spi_device_polling_transmit returned -> 0x%X", __PRETTY_FUNCTION__, retCode);
+        return false;
+    }
+    return true;
 }
 void SpiMaster::lowerChipSelect()
 {
@@ -202,10 +383,23 @@ void SpiMaster::raiseChipSelect()
 {
     gpio_set_level(m_config.chipSelectPin, 1);
 }
-void SpiMaster::waitForMisoLow()
+// SO goes low once the crystal is running (CHIP_RDYn, pg 29). Bounded, so a chip that is gone or held in reset
+// shows up as ChipNotReady instead of hanging the caller.
+bool SpiMaster::waitForMisoLow()
 {
+    uint32_t startMicros = micros();
+
     while (gpio_get_level(m_config.misoPin))
+    {
+        if (micros() - startMicros > kChipReadyTimeoutMicros)
+        {
+            m_lastError = RadioError::ChipNotReady;
+            ESP_LOGW(TAG, "CHIP_RDYn timeout");
+            return false;
+        }
         delayMicroseconds(1);
+    }
+    return true;
 }
 
 } // namespace TI_CC1101
\ No newline at end of file
@@ -15,8 +15,10 @@
 
 #pragma once
 #include "LocalTypes.h"
+#include "RadioBus.h"
 #ifdef ARDUINO
 #include <stddef.h>
+#include <SPI.h>
 #else
 #include <memory.h>
 #include <driver/spi_master.h>
@@ -42,30 +44,67 @@ namespace TI_CC1101
   #ifdef ARDUINO
   typedef void* spi_device_handle_t;
   #endif
+  // SPI interface timing, Table 22. The clock the chip can take depends on whether there is a gap between the
+  // header and the data: with one (or for a lone strobe) it is 10 MHz, with bytes back to back in a burst 6.5 MHz.
+  // Single register accesses send the header and the data as separate transfers, and the per-transfer setup of
+  // either SPI driver is far longer than t_sd, so they run at the single access clock. Bursts and chained reads
+  // send everything back to back and run at the burst clock.
+  //
+  // CSn setup (t_sp) and hold (t_ns): with CSn on a GPIO, beginChipTransaction()/endChipTransaction() cover them.
+  // CSn goes low, then SO is polled for CHIP_RDYn before the first SCLK edge, and CSn only goes high once the
+  // transfer has returned. With hardware CSn they become cs_ena_pretrans/cs_ena_posttrans clock cycles. While the
+  // crystal is off t_sp is 150us, which the CHIP_RDYn wait takes care of.
+  struct SpiTiming
+  {
+    static const int      kMaxSingleAccessClockHz = 10'000'000;
+    static const int      kMaxBurstClockHz        = 6'500'000;
+    static const uint32_t kHeaderToDataNanos      = 100; // t_sd, needed above kMaxBurstClockHz
+    static const uint32_t kChipSelectSetupNanos   = 20;  // t_sp, XOSC running
+    static const uint32_t kChipSelectHoldNanos    = 20;  // t_ns, last SCLK edge to CSn high
+  };
   struct SpiConfig
   {
     gpio_num_t misoPin;
     gpio_num_t mosiPin;
     gpio_num_t clockPin;
     gpio_num_t chipSelectPin;
-    int        clockFrequencyHz;
+    int        clockFrequencyHz;      // strobes and single register access
+    int        burstClockFrequencyHz; // bursts and chained reads. 0 means clockFrequencyHz
     int        queueSize; // number of parallel transactions
+    // Let the SPI peripheral drive CSn. ESP-IDF only; the Arduino backend always drives it as a GPIO. It is one
+    // device, so single register accesses also run at the burst clock and clockFrequencyHz goes unused.
+    bool       hardwareChipSelect;
 
     SpiMode spiMode;
     Esp32SPIHost spiHost;
+
+    // What the backends actually use: the configured clocks, capped at what the chip allows for each kind of access
+    int SingleAccessClockHz() const { return clockFrequencyHz < SpiTiming::kMaxSingleAccessClockHz ? clockFrequencyHz : SpiTiming::kMaxSingleAccessClockHz; }
+    int BurstClockHz() const
+    {
+      int requested = burstClockFrequencyHz > 0 ? burstClockFrequencyHz : clockFrequencyHz;
+      return requested < SpiTiming::kMaxBurstClockHz ? requested : SpiTiming::kMaxBurstClockHz;
+    }
   };
 
-  class SpiMaster
+  class SpiMaster : public RadioBus
   {
     protected:
-      spi_device_handle_t m_DeviceHandle;
+      spi_device_handle_t m_DeviceHandle      = nullptr; // single access clock
+      spi_device_handle_t m_BurstDeviceHandle = nullptr; // burst clock, same bus and CSn. Same as m_DeviceHandle with hardware CSn
 
       const int kDmaChannelToUse = 0; // no DMA (for now ?)
+      // XOSC start-up is ~150us, anything much longer means the chip isn't there
+      static const uint32_t kChipReadyTimeoutMicros = 2000;
       SpiConfig m_config;
+      bool       m_hardwareChipSelect = false; // current mode; off during BeginManualChipSelect()
+      bool       m_crystalMayBeOff    = true;  // CHIP_RDYn has to be waited for before the next call, see access()
+      RadioError m_lastError = RadioError::None;
+      byte       m_lastStatus = 0;
 
     public:
       SpiMaster();
-      ~SpiMaster();
+      ~SpiMaster() override;
       bool Init(const SpiConfig &cfg);
 
       gpio_num_t MisoPin() { return m_config.misoPin; }
@@ -73,24 +112,75 @@ namespace TI_CC1101
       gpio_num_t ClockPin() { return m_config.clockPin; }
       gpio_num_t ChipSelectPin() { return m_config.chipSelectPin; }
 
-      bool WriteByte(byte toWrite,byte& outData);
-      bool WriteByteToAddress(byte address, byte value, byte&  outData);
-      bool WriteBytesToAddress(byte address,byte *toWrite, size_t arrayLen, byte&  outData);
-      bool ReadBurstRegister(byte address,byte *toRead, size_t arrayLen);
-      bool ReadRegister(byte addr, byte& outData);
+      bool WriteByte(byte toWrite,byte& outData) override;
+      bool WriteByteToAddress(byte address, byte value, byte&  outData) override;
+      bool WriteBytesToAddress(byte address,const byte *toWrite, size_t arrayLen, byte&  outData) override;
+      bool ReadBurstRegister(byte address,byte *toRead, size_t arrayLen) override;
+      bool ReadRegister(byte addr, byte& outData) override;
+      bool ReadRegisters(const byte *addresses, byte *values, size_t count) override;
+      byte LastStatus() const override { return m_lastStatus; }
+      RadioError LastError() const override { return m_lastError; }
       void lowerChipSelect();
       void raiseChipSelect();
-      void waitForMisoLow();
+      bool waitForMisoLow();
+      // Hands CSn over as a plain GPIO, for sequences that aren't SPI transactions (the CC1101 manual reset).
+      // RadioBus calls keep working in between. No-ops unless hardwareChipSelect is set.
+      bool BeginManualChipSelect();
+      bool EndManualChipSelect();
 
     protected:
+      // beginChipTransaction() lowers CSn and waits for CHIP_RDYn, endChipTransaction() raises CSn. Every RadioBus
+      // call is exactly one of these pairs.
 #ifndef ARDUINO
       inline void intializeDefaultTransaction(spi_transaction_t &transToInitialize) { memset(&transToInitialize, 0, sizeof(transToInitialize)); }
-      inline void startTransaction(){}
-      inline void endTransaction(){}
-#else  
-      void startTransaction();
-      void endTransaction();
-    #endif
+
+      bool beginChipTransaction();
+      void endChipTransaction();
+      bool chipWasReady() const;
+      // keepSelected holds hardware CSn low for the next transfer of the same call
+      bool transfer(spi_device_handle_t device, const byte *toWrite, byte *toRead, size_t length, bool keepSelected);
+      bool singleAccess(const byte request[2], byte reply[2]);
+      bool addDevices(bool hardwareChipSelect);
+      void removeDevices();
+      bool wakeChip();
+
+      // One RadioBus call: beginChipTransaction(), attempt(), endChipTransaction(). Each call goes out once.
+      //
+      // With hardware CSn the first SCLK edge follows CSn by cs_ena_pretrans cycles, and pre_cb runs before the
+      // peripheral lowers CSn, so CHIP_RDYn can't be waited for inside the transaction. It only goes high while
+      // the crystal is off: after power-up and after SRES, SPWD, SXOFF or SWOR. The first call after one of those
+      // goes through wakeChip(), which waits for CHIP_RDYn with CSn as a GPIO. A status byte that still shows
+      // CHIP_RDYn high (the chip reset itself) fails the call with ChipNotReady; repeating it could issue a strobe
+      // or a FIFO access twice.
+      template <typename Attempt>
+      bool access(Attempt &&attempt)
+      {
+        if (m_hardwareChipSelect && m_crystalMayBeOff && !wakeChip())
+        {
+          return false;
+        }
+        if (!beginChipTransaction())
+        {
+          return false;
+        }
+        m_crystalMayBeOff = false; // waited for above, or by beginChipTransaction() with CSn on a GPIO
+        bool ok = attempt();
+        endChipTransaction();
+        if (ok && !chipWasReady())
+        {
+          m_crystalMayBeOff = true;
+          m_lastError       = RadioError::ChipNotReady;
+          return false;
+        }
+        return ok;
+      }
+#else
+      SPISettings m_settings;      // single access clock
+      SPISettings m_burstSettings; // burst clock
+
+      bool beginChipTransaction(const SPISettings &settings);
+      void endChipTransaction();
+#endif
   };
 
 }//namespace
\ No newline at end of file
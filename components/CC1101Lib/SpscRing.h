@@ -0,0 +1,185 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include <atomic>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+namespace TI_CC1101
+{
+    // Single-producer/single-consumer lock-free ring, meant for handing events from an ISR to one task
+    // without going through a FreeRTOS queue (which takes a critical section and copies through the kernel).
+    //
+    // - N must be a power of two. Indices run freely and are masked on access.
+    // - Push() and PushFromISR() are force-inlined so they end up in the (IRAM) ISR that calls them, and they
+    //   touch nothing but the ring and, at most, one task notification.
+    // - The consumer task is only notified when the ring goes from empty to non-empty, so a burst of edges
+    //   costs one wakeup. "Empty" is judged from the tail read after the new head is published, with a fence on
+    //   each side (push() and Empty()), so either the producer sees the consumer caught up and notifies, or the
+    //   consumer sees the new element and doesn't go to sleep.
+    // - A full ring drops the new element and counts it in Overflows().
+    template <typename T, size_t N>
+    class SpscRing
+    {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+      public:
+        // ESP32 cache lines are 32 bytes. Keeping the indices apart means the producer core and the consumer
+        // core don't keep stealing the same line from each other.
+        static const size_t kCacheLineSize = 32;
+        static const size_t kCapacity      = N;
+
+        void SetConsumerTask(TaskHandle_t consumerTask) { m_consumerTask = consumerTask; }
+
+        __attribute__((always_inline)) bool PushFromISR(const T &item, BaseType_t *higherPriorityTaskWoken)
+        {
+            bool wasEmpty = false;
+            if (!push(item, wasEmpty))
+            {
+                return false;
+            }
+            if (wasEmpty && m_consumerTask != nullptr)
+            {
+                vTaskNotifyGiveFromISR(m_consumerTask, higherPriorityTaskWoken);
+            }
+            return true;
+        }
+
+        __attribute__((always_inline)) bool Push(const T &item)
+        {
+            bool wasEmpty = false;
+            if (!push(item, wasEmpty))
+            {
+                return false;
+            }
+            if (wasEmpty && m_consumerTask != nullptr)
+            {
+                xTaskNotifyGive(m_consumerTask);
+            }
+            return true;
+        }
+
+        // All or nothing, so a consumer never sees half of a multi-element record. Task context only.
+        bool PushBatch(std::span<const T> items)
+        {
+            uint32_t head = m_head.load(std::memory_order_relaxed);
+            uint32_t tail = m_tail.load(std::memory_order_acquire);
+
+            if (N - (head - tail) < items.size())
+            {
+                m_overflows.store(m_overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                m_items[(head + i) & (N - 1)] = items[i];
+            }
+            if (publish(head, items.size()) && !items.empty() && m_consumerTask != nullptr)
+            {
+                xTaskNotifyGive(m_consumerTask);
+            }
+            return true;
+        }
+
+        bool Pop(T &item)
+        {
+            uint32_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            item = m_items[tail & (N - 1)];
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Copies out as many items as are available and fit, and releases them all with one index update.
+        size_t PopBatch(std::span<T> out)
+        {
+            uint32_t tail  = m_tail.load(std::memory_order_relaxed);
+            uint32_t head  = m_head.load(std::memory_order_acquire);
+            size_t   count = head - tail;
+
+            if (count > out.size())
+            {
+                count = out.size();
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                out[i] = m_items[(tail + i) & (N - 1)];
+            }
+            m_tail.store(tail + count, std::memory_order_release);
+            return count;
+        }
+
+        // Blocks the consumer task until something is pushed or the timeout expires. Returns immediately if
+        // the ring already has data. Only the task passed to SetConsumerTask() may call this.
+        bool WaitForData(TickType_t timeoutTicks)
+        {
+            if (!Empty())
+            {
+                return true;
+            }
+            ulTaskNotifyTake(pdTRUE, timeoutTicks);
+            return !Empty();
+        }
+
+        // Consumer side: the fence orders the consumer's earlier tail stores before the head load, see publish()
+        bool Empty() const
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+        }
+
+        size_t   Size() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire); }
+        uint32_t Overflows() const { return m_overflows.load(std::memory_order_relaxed); }
+
+      protected:
+        __attribute__((always_inline)) bool push(const T &item, bool &wasEmpty)
+        {
+            uint32_t head = m_head.load(std::memory_order_relaxed);
+            uint32_t tail = m_tail.load(std::memory_order_acquire);
+
+            if (head - tail >= N)
+            {
+                m_overflows.store(m_overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+            m_items[head & (N - 1)] = item;
+            wasEmpty = publish(head, 1);
+            return true;
+        }
+
+        // Makes count elements written at head visible. Returns true if the consumer had nothing else left, which
+        // also covers it having taken some of the new elements already (a spurious wakeup at worst). The tail is
+        // read again after the fence: the one read before writing may be stale by the time the head is published,
+        // and a consumer that emptied the ring in between would miss its wakeup.
+        __attribute__((always_inline)) bool publish(uint32_t head, size_t count)
+        {
+            m_head.store(head + count, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return (uint32_t)(head + count - m_tail.load(std::memory_order_relaxed)) <= count;
+        }
+
+        alignas(kCacheLineSize) std::atomic<uint32_t> m_head{0}; // written by the producer only
+        alignas(kCacheLineSize) std::atomic<uint32_t> m_tail{0}; // written by the consumer only
+        alignas(kCacheLineSize) std::atomic<uint32_t> m_overflows{0};
+        TaskHandle_t m_consumerTask = nullptr;
+        T            m_items[N];
+    };
+} // namespace TI_CC1101
@@ -0,0 +1,139 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include "TransmitPowerControl.h"
+
+static const char *TAG = "TransmitPowerControl";
+
+namespace TI_CC1101
+{
+    void TransmitPowerControl::SetTarget(int targetRssiDbm, int marginDb)
+    {
+        m_targetRssiDbm = targetRssiDbm;
+        m_marginDb      = marginDb;
+    }
+
+    void TransmitPowerControl::ReportPeerFeedback(byte peer, int rssiDbm, byte lqi)
+    {
+        Peer *entry = find(peer, true);
+
+        // The peer heard the power we last picked for it, before any estimate that was the ceiling. The PA table
+        // rounds up to its next row, so the real power may be a bit higher and the estimate errs on the safe side.
+        addPathLoss(*entry, (float)(entry->PowerDbm - rssiDbm), lqi);
+    }
+
+    void TransmitPowerControl::ReportReceived(byte peer, int rssiDbm, byte lqi, int peerTxPowerDbm)
+    {
+        addPathLoss(*find(peer, true), (float)(peerTxPowerDbm - rssiDbm), lqi);
+    }
+
+    void TransmitPowerControl::ReportNoAck(byte peer)
+    {
+        Peer *entry = find(peer, true);
+
+        entry->ExtraMarginDb = (int8_t)std::min(entry->ExtraMarginDb + kNoAckStepDb, 60);
+        ESP_LOGD(TAG, "peer %d: no ack, +%d dB", peer, entry->ExtraMarginDb);
+    }
+
+    int TransmitPowerControl::PowerForPeer(byte peer)
+    {
+        Peer *entry    = find(peer, true);
+        int   required = requiredPower(*entry);
+
+        // Up right away, down only past the hysteresis
+        if (required > entry->PowerDbm || required <= entry->PowerDbm - kHysteresisDb)
+        {
+            entry->PowerDbm = (int8_t)required;
+        }
+        return entry->PowerDbm;
+    }
+
+    int TransmitPowerControl::Apply(byte peer)
+    {
+        int powerDbm = PowerForPeer(peer);
+
+        ESP_LOGD(TAG, "peer %d: %d dBm", peer, powerDbm);
+        return applyPower(powerDbm);
+    }
+
+    int TransmitPowerControl::applyPower(int powerDbm)
+    {
+        if (powerDbm != m_appliedDbm || m_device.PATableGeneration() != m_appliedGeneration)
+        {
+            m_device.SetOutputPower(powerDbm);
+            m_appliedDbm        = powerDbm;
+            m_appliedGeneration = m_device.PATableGeneration();
+            m_writes++;
+        }
+        return powerDbm;
+    }
+
+    // Peers are looked up linearly, the table is small and this runs once per frame
+    TransmitPowerControl::Peer *TransmitPowerControl::find(byte peer, bool create)
+    {
+        uint32_t now    = micros();
+        int      oldest = 0;
+
+        for (int i = 0; i < m_count; i++)
+        {
+            if (m_peers[i].Address == peer)
+            {
+                m_peers[i].LastUsedMicros = now;
+                return &m_peers[i];
+            }
+            if ((int32_t)(m_peers[i].LastUsedMicros - m_peers[oldest].LastUsedMicros) < 0)
+            {
+                oldest = i;
+            }
+        }
+        if (!create)
+        {
+            return nullptr;
+        }
+        if (m_count < kMaxPeers)
+        {
+            oldest = m_count++;
+        }
+        m_peers[oldest] = {peer, false, 0, (int8_t)m_maxPowerDbm, 0, 0, now};
+        return &m_peers[oldest];
+    }
+
+    void TransmitPowerControl::addPathLoss(Peer &entry, float pathLossDb, byte lqi)
+    {
+        // Exponential average with weight 1/4, enough to ride out a single faded frame
+        entry.PathLossDb    = entry.HasEstimate ? entry.PathLossDb + (pathLossDb - entry.PathLossDb) / 4 : pathLossDb;
+        entry.HasEstimate   = true;
+        entry.Lqi           = lqi & 0x7F; // bit 7 is CRC_OK
+        entry.ExtraMarginDb = 0;
+    }
+
+    int TransmitPowerControl::requiredPower(const Peer &entry) const
+    {
+        int required = m_maxPowerDbm;
+
+        if (entry.HasEstimate)
+        {
+            required = (int)std::ceil(m_targetRssiDbm + m_marginDb + entry.PathLossDb);
+            if (entry.Lqi > m_lqiThreshold)
+            {
+                required += kLqiPenaltyDb;
+            }
+        }
+        required += entry.ExtraMarginDb;
+        return std::clamp(required, kMinPowerDbm, m_maxPowerDbm);
+    }
+} // namespace TI_CC1101
@@ -0,0 +1,100 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include "CC1101Device.h"
+
+namespace TI_CC1101
+{
+    // Per-peer transmit power control. Keeps an estimate of the path loss to each peer and picks the lowest output
+    // power that still lands TargetRssiDbm + margin at the peer, instead of sending every frame at TxPower.
+    //
+    // - Path loss comes from what the peer reports about our frames (RSSI it measured, at the power we used), or from
+    //   our own RSSI of the peer's frames when its transmit power is known. Either way it is smoothed per peer.
+    //   A poor LQI (high value, the CC1101 counts errors) adds kLqiPenaltyDb of margin.
+    // - Power goes up as soon as the estimate says so, but only comes down once it is kHysteresisDb lower, so a
+    //   fading link doesn't flip PATABLE on every frame. A missing acknowledgement bumps the peer by kNoAckStepDb.
+    // - TxPower in the device config stays the ceiling. Peers without a measurement get the ceiling.
+    // - Apply() writes PATABLE (one burst) only when the power differs from what was last applied, or when something
+    //   else rewrote PATABLE since (SetPowerRamp, a profile switch, recovery), which PATableGeneration() shows.
+    //
+    // Peers are kept in a small table with least recently used eviction. Not thread safe; call from the task that
+    // owns the radio, like TransmitScheduler.
+    class TransmitPowerControl
+    {
+      public:
+        static constexpr int kMaxPeers            = 32;
+        static constexpr int kMinPowerDbm         = -30; // lowest row of the PA tables
+        static constexpr int kDefaultTargetRssi   = -90; // dBm at the peer, comfortably above sensitivity at low data rates
+        static constexpr int kDefaultMarginDb     = 6;
+        static constexpr int kHysteresisDb        = 3;
+        static constexpr int kNoAckStepDb         = 6;
+        static constexpr int kLqiPenaltyDb        = 3;
+        static constexpr int kDefaultLqiThreshold = 30;
+
+        TransmitPowerControl(CC1101Device &device, int maxPowerDbm) : m_device(device), m_maxPowerDbm(maxPowerDbm) {}
+
+        void SetTarget(int targetRssiDbm, int marginDb);
+        void SetLqiThreshold(byte lqi) { m_lqiThreshold = lqi; }
+
+        // The peer received our last frame at rssiDbm with this LQI, e.g. from fields in its acknowledgement
+        void ReportPeerFeedback(byte peer, int rssiDbm, byte lqi);
+        // We received a frame from the peer, sent at peerTxPowerDbm. rssiDbm and lqi are from the appended status bytes.
+        void ReportReceived(byte peer, int rssiDbm, byte lqi, int peerTxPowerDbm);
+        // A frame to the peer went unacknowledged
+        void ReportNoAck(byte peer);
+
+        // The power the next frame to the peer should go out at
+        int PowerForPeer(byte peer);
+        // Sets PATABLE for the peer, call right before loading the frame. Returns the power used.
+        int Apply(byte peer);
+        // Sets PATABLE back to the TxPower ceiling, for frames that aren't addressed to a tracked peer
+        int ApplyCeiling() { return applyPower(m_maxPowerDbm); }
+        // Forces the next Apply() to write PATABLE. Writes through CC1101Device are noticed without this.
+        void Invalidate() { m_appliedDbm = kNotApplied; }
+
+        int      TrackedPeers() const { return m_count; }
+        uint32_t PATableWrites() const { return m_writes; }
+
+      protected:
+        static constexpr int kNotApplied = INT16_MIN;
+
+        struct Peer
+        {
+            byte     Address;
+            bool     HasEstimate;
+            byte     Lqi;
+            int8_t   PowerDbm;      // last power chosen for this peer
+            int8_t   ExtraMarginDb; // from missed acknowledgements, cleared by the next feedback
+            float    PathLossDb;    // smoothed
+            uint32_t LastUsedMicros;
+        };
+
+        Peer *find(byte peer, bool create);
+        void  addPathLoss(Peer &entry, float pathLossDb, byte lqi);
+        int   requiredPower(const Peer &entry) const;
+        int   applyPower(int powerDbm);
+
+        CC1101Device &m_device;
+        Peer          m_peers[kMaxPeers];
+        int           m_count             = 0;
+        int           m_maxPowerDbm;
+        int           m_targetRssiDbm     = kDefaultTargetRssi;
+        int           m_marginDb          = kDefaultMarginDb;
+        byte          m_lqiThreshold      = kDefaultLqiThreshold;
+        int           m_appliedDbm        = kNotApplied;
+        uint32_t      m_appliedGeneration = 0; // CC1101Device::PATableGeneration() after our last write
+        uint32_t      m_writes            = 0;
+    };
+} // namespace TI_CC1101
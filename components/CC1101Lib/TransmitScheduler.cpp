@@ -0,0 +1,214 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+#ifndef ARDUINO
+#include <esp_random.h>
+#endif
+#include "TransmitScheduler.h"
+
+static const char *TAG = "TransmitScheduler";
+
+namespace TI_CC1101
+{
+    void TransmitScheduler::SetReportCallback(TransmitReportCallback callback, void *context)
+    {
+        m_reportCallback = callback;
+        m_reportContext  = context;
+    }
+
+    bool TransmitScheduler::Enqueue(uint32_t frameId, const byte *data, int length, uint8_t priority, uint32_t deadlineMicros, int peer)
+    {
+        bool         bRet  = true;
+        uint32_t     now   = micros();
+        QueuedFrame *frame = nullptr;
+
+        CBR(m_count < kMaxQueuedFrames);
+        CBR(length > 0 && length <= kMaxFrameLength);
+
+        frame                  = &m_frames[m_count++];
+        frame->FrameId         = frameId;
+        frame->Priority        = priority;
+        frame->HasDeadline     = deadlineMicros != 0;
+        frame->Retries         = 0;
+        frame->Peer            = peer;
+        frame->EnqueueMicros   = now;
+        frame->DeadlineMicros  = now + deadlineMicros;
+        frame->NotBeforeMicros = now;
+        frame->Length          = length;
+        memcpy(frame->Data, data, length);
+
+    Error:
+        if (!bRet)
+        {
+            ESP_LOGW(TAG, "dropping frame %lu, %d queued, length %d", (unsigned long)frameId, m_count, length);
+        }
+        return bRet;
+    }
+
+    uint32_t TransmitScheduler::Process()
+    {
+        uint32_t       now    = micros();
+        int            index  = 0;
+        QueuedFrame   *frame  = nullptr;
+        TransmitResult result = TransmitResult::Failed;
+        uint32_t       wait   = UINT32_MAX;
+
+        expireFrames(now);
+        if (m_count == 0)
+        {
+            return 0;
+        }
+
+        index = pickNext(now);
+        if (index < 0)
+        {
+            for (int i = 0; i < m_count; i++)
+            {
+                wait = std::min(wait, m_frames[i].NotBeforeMicros - now);
+            }
+            return wait;
+        }
+        frame = &m_frames[index];
+
+        // A different frame got ahead of the one left in the FIFO by a busy attempt
+        if (m_loadedFrameId >= 0 && m_loadedFrameId != frame->FrameId)
+        {
+            m_device.FlushTxFifo();
+            m_loadedFrameId = -1;
+        }
+
+        // PATABLE only matters once STX goes through, so it can change while a frame sits in the FIFO
+        if (m_powerControl != nullptr)
+        {
+            if (frame->Peer != kNoPeer)
+            {
+                m_powerControl->Apply((byte)frame->Peer);
+            }
+            else
+            {
+                m_powerControl->ApplyCeiling();
+            }
+        }
+        result = m_device.TryTransmit(frame->Data, frame->Length, kTransmitTimeoutMicros);
+        now    = micros();
+        switch (result)
+        {
+        case TransmitResult::ChannelBusy:
+            m_loadedFrameId        = frame->FrameId;
+            frame->NotBeforeMicros = now + backoffMicros(frame->Retries);
+            frame->Retries++;
+            ESP_LOGD(TAG, "frame %lu: channel busy, retry %d", (unsigned long)frame->FrameId, frame->Retries);
+            return frame->NotBeforeMicros - now;
+        case TransmitResult::Sent:
+            m_loadedFrameId = -1;
+            complete(index, FrameOutcome::Sent, now);
+            break;
+        case TransmitResult::Failed:
+            m_loadedFrameId = -1; // TryTransmit flushes on failure
+            complete(index, FrameOutcome::Failed, now);
+            break;
+        }
+        return m_count > 0 ? 1 : 0;
+    }
+
+    void TransmitScheduler::Clear()
+    {
+        if (m_loadedFrameId >= 0)
+        {
+            m_device.FlushTxFifo();
+            m_loadedFrameId = -1;
+        }
+        m_count = 0;
+    }
+
+    // Highest priority first, earliest deadline breaks ties, frames without a deadline go last.
+    // Frames still backing off are skipped.
+    int TransmitScheduler::pickNext(uint32_t now)
+    {
+        int best = -1;
+
+        for (int i = 0; i < m_count; i++)
+        {
+            const QueuedFrame &candidate = m_frames[i];
+            if (!timeReached(now, candidate.NotBeforeMicros))
+            {
+                continue;
+            }
+            if (best < 0)
+            {
+                best = i;
+                continue;
+            }
+            const QueuedFrame &current = m_frames[best];
+            if (candidate.Priority != current.Priority)
+            {
+                if (candidate.Priority > current.Priority)
+                {
+                    best = i;
+                }
+                continue;
+            }
+            if (candidate.HasDeadline && (!current.HasDeadline || (int32_t)(candidate.DeadlineMicros - current.DeadlineMicros) < 0))
+            {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void TransmitScheduler::expireFrames(uint32_t now)
+    {
+        for (int i = m_count - 1; i >= 0; i--)
+        {
+            if (m_frames[i].HasDeadline && timeReached(now, m_frames[i].DeadlineMicros))
+            {
+                if (m_loadedFrameId == m_frames[i].FrameId)
+                {
+                    m_device.FlushTxFifo();
+                    m_loadedFrameId = -1;
+                }
+                complete(i, FrameOutcome::Expired, now);
+            }
+        }
+    }
+
+    void TransmitScheduler::complete(int index, FrameOutcome outcome, uint32_t now)
+    {
+        const QueuedFrame &frame  = m_frames[index];
+        TransmitReport     report = {frame.FrameId, outcome, frame.Priority, frame.Retries, now - frame.EnqueueMicros};
+
+        ESP_LOGD(TAG, "frame %lu: outcome %d, %d retries, %lu us", (unsigned long)report.FrameId, (int)outcome, report.Retries, (unsigned long)report.LatencyMicros);
+
+        // order doesn't matter, pickNext() looks at every frame
+        m_frames[index] = m_frames[--m_count];
+
+        if (m_reportCallback != nullptr)
+        {
+            m_reportCallback(report, m_reportContext);
+        }
+    }
+
+    // Binary exponential backoff: kMinBackoffMicros plus a uniform draw from a window that
+    // starts at kMinBackoffMicros and doubles per retry, up to kMaxBackoffMicros
+    uint32_t TransmitScheduler::backoffMicros(uint16_t retries)
+    {
+        uint32_t window = kMinBackoffMicros << std::min<uint16_t>(retries, 7);
+
+        window = std::min(window, kMaxBackoffMicros);
+        return kMinBackoffMicros + esp_random() % window;
+    }
+} // namespace TI_CC1101
@@ -0,0 +1,108 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+#include "CC1101Device.h"
+#include "TransmitPowerControl.h"
+
+namespace TI_CC1101
+{
+    enum class FrameOutcome
+    {
+        Sent,
+        Expired, // deadline passed before the channel was clear
+        Failed   // the radio didn't get the frame out (timeout, underflow)
+    };
+
+    struct TransmitReport
+    {
+        uint32_t     FrameId;
+        FrameOutcome Outcome;
+        uint8_t      Priority;
+        uint16_t     Retries;       // number of times CCA found the channel busy
+        uint32_t     LatencyMicros; // enqueue to end of transmission (or to giving up)
+    };
+
+    typedef void (*TransmitReportCallback)(const TransmitReport &report, void *context);
+
+    // Queues outgoing frames and sends them one at a time with listen-before-talk.
+    //
+    // The chip does the actual channel assessment: with MCSM1.CCA_MODE != 0, an STX strobed while in RX is
+    // ignored if RSSI is above the carrier sense threshold (or a packet is being received), see pg 81.
+    // When that happens the frame stays queued and the scheduler waits a random backoff, drawn from a window
+    // that doubles on every busy attempt, so gateways sharing a channel don't retry in lockstep.
+    //
+    // Frames are picked by priority (higher first), then by earliest deadline. A frame whose deadline passes is
+    // dropped and reported as Expired. Not thread safe; Enqueue() and Process() should be called from the
+    // task that owns the radio.
+    //
+    // With a TransmitPowerControl set, frames enqueued with a peer address go out at that peer's power.
+    class TransmitScheduler
+    {
+      public:
+        static constexpr int      kMaxQueuedFrames       = 8;
+        static constexpr int      kMaxFrameLength        = 64;
+        static constexpr uint32_t kMinBackoffMicros      = 500;
+        static constexpr uint32_t kMaxBackoffMicros      = 64000;
+        static constexpr uint32_t kTransmitTimeoutMicros = 200000;
+        static constexpr int      kNoPeer                = -1;
+
+        TransmitScheduler(CC1101Device &device) : m_device(device) {}
+
+        void SetReportCallback(TransmitReportCallback callback, void *context);
+        void SetPowerControl(TransmitPowerControl *powerControl) { m_powerControl = powerControl; }
+
+        // deadlineMicros is relative to now; 0 means no deadline. peer picks the output power when power control is
+        // set, kNoPeer sends at whatever PATABLE holds. Returns false if the queue is full or the frame is too long.
+        bool Enqueue(uint32_t frameId, const byte *data, int length, uint8_t priority, uint32_t deadlineMicros, int peer = kNoPeer);
+
+        // Tries to make progress on the queue. Returns the number of microseconds until it wants to be called
+        // again (0 if the queue is empty).
+        uint32_t Process();
+
+        int  QueuedFrames() const { return m_count; }
+        void Clear();
+
+      protected:
+        struct QueuedFrame
+        {
+            uint32_t FrameId;
+            uint8_t  Priority;
+            bool     HasDeadline;
+            uint16_t Retries;
+            int      Peer;
+            uint32_t EnqueueMicros;
+            uint32_t DeadlineMicros;
+            uint32_t NotBeforeMicros; // backoff, the frame isn't tried again before this
+            int      Length;
+            byte     Data[kMaxFrameLength];
+        };
+
+        // micros() wraps every ~71 minutes, compare as a signed difference
+        static bool timeReached(uint32_t now, uint32_t when) { return (int32_t)(now - when) >= 0; }
+
+        int      pickNext(uint32_t now);
+        void     expireFrames(uint32_t now);
+        void     complete(int index, FrameOutcome outcome, uint32_t now);
+        uint32_t backoffMicros(uint16_t retries);
+
+        CC1101Device          &m_device;
+        QueuedFrame            m_frames[kMaxQueuedFrames];
+        int                    m_count          = 0;
+        int64_t                m_loadedFrameId  = -1; // frame currently sitting in the TX FIFO after a busy attempt
+        TransmitPowerControl  *m_powerControl   = nullptr;
+        TransmitReportCallback m_reportCallback = nullptr;
+        void                  *m_reportContext  = nullptr;
+    };
+} // namespace TI_CC1101
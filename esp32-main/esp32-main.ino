@@ -1,6 +1,13 @@
 #include "src/CC1101Lib/SpiMaster.h"
 #include "src/CC1101Lib/CC1101Lib.h"
 #include "src/CC1101Lib/CC1101Device.h"
+#include "src/CC1101Lib/RadioBusConformance.h"
+#include "src/CC1101Lib/PacketKernels.h"
+
+// Uncomment to check the SPI bus against the chip at startup
+// #define CC1101_BUS_CONFORMANCE
+// Uncomment to log CRC16/PN9 cycles per byte at startup
+// #define CC1101_KERNEL_BENCHMARK
 
 using namespace TI_CC1101;
 
@@ -15,28 +22,48 @@ void setup() {
     .mosiPin = GPIO_NUM_23,
     .clockPin = GPIO_NUM_18,
     .chipSelectPin = GPIO_NUM_5,
-    .clockFrequencyHz = 4'000'000,
+    .clockFrequencyHz = 10'000'000,
+    .burstClockFrequencyHz = 6'500'000,
     .queueSize = 8,
+    .hardwareChipSelect = false,
     .spiMode = SpiMode::ModeZero,
     .spiHost = Esp32SPIHost::HOST_VSPI
   };
   CC110DeviceConfig somfyRadioConfig = {
     .TxPin = GPIO_NUM_13,
-    .RxPin = GPIO_NUM_14,
-    .InterruptQueue = nullptr
+    .RxPin = GPIO_NUM_14
   };
 
   Serial.begin(9600);
 
   Log.begin(LOG_LEVEL_VERBOSE,&Serial);
 
+#ifdef CC1101_KERNEL_BENCHMARK
+  PacketKernels::Benchmark();
+#endif
+
   ESP_LOGD("main","Initializing SPI\n");
   spiMaster->Init(spiConfig);
+#ifdef CC1101_BUS_CONFORMANCE
+  if (!RadioBusConformance::Run(*spiMaster))
+  {
+    ESP_LOGW("main", "SPI bus doesn't behave the way the driver expects\n");
+  }
+#endif
 
   ESP_LOGD("main","Initializing CC1101\n");
-  assert(cc1101Device.Init(spiMaster, somfyRadioConfig));
+  Result<void> result = cc1101Device.Init(spiMaster, somfyRadioConfig);
+  if (!result)
+  {
+    ESP_LOGE("main","CC1101 init failed: %s\n", RadioErrorName(result.Error()));
+    return;
+  }
 
-  cc1101Device.BeginReceive();
+  result = cc1101Device.BeginReceive();
+  if (!result)
+  {
+    ESP_LOGE("main","CC1101 receive failed: %s\n", RadioErrorName(result.Error()));
+  }
 }
 void loop() {
   cc1101Device.Update();
@@ -0,0 +1,103 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Runs AsyncRadio against SimulatedRadioBus: write coalescing, writes the chip already holds, results of reads, and
+// which operations fail when the bus does. Exits nonzero if any check fails.
+//   async_radio_check
+#include <cstdio>
+#include <cstring>
+#include <CC1101Lib/AsyncRadio.h>
+#include <CC1101Lib/SimulatedRadioBus.h>
+
+using namespace TI_CC1101;
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const char *what)
+    {
+        printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+        failures += ok ? 0 : 1;
+    }
+} // namespace
+
+int main()
+{
+    SimulatedRadioBus bus;
+    AsyncRadio        radio(bus);
+    byte              registers[CC1101_CONFIG::kNumConfigRegisters];
+    byte              patable[8];
+    byte              value = 0;
+    int               op    = -1;
+    RadioFuture       first;
+    RadioFuture       second;
+
+    for (int i = 0; i < CC1101_CONFIG::kNumConfigRegisters; i++)
+    {
+        registers[i] = bus.Register(i);
+    }
+    memcpy(patable, bus.PATable(), sizeof(patable));
+    radio.SeedShadow(registers, patable);
+
+    // Adjacent registers from two operations share one burst
+    bus.ResetCounters();
+    op     = radio.Begin();
+    radio.AddWrite(op, CC1101_CONFIG::FREQ2, 0x10);
+    first  = radio.Submit(op);
+    op     = radio.Begin();
+    radio.AddWrite(op, CC1101_CONFIG::FREQ1, 0xB0);
+    second = radio.Submit(op);
+    radio.RunPending();
+    check(radio.Status(first) == RadioOpStatus::Done && radio.Status(second) == RadioOpStatus::Done, "back to back writes complete");
+    check(bus.Register(CC1101_CONFIG::FREQ2) == 0x10 && bus.Register(CC1101_CONFIG::FREQ1) == 0xB0, "chip holds both writes");
+    check(bus.Transactions() == 1, "one transaction for both writes");
+
+    // An image equal to what the chip holds only costs the strobe
+    registers[CC1101_CONFIG::FREQ2] = 0x10;
+    registers[CC1101_CONFIG::FREQ1] = 0xB0;
+    bus.ResetCounters();
+    first = radio.ApplyRegisters(registers, patable, false);
+    radio.RunPending();
+    check(radio.Status(first) == RadioOpStatus::Done && bus.Transactions() == 1, "unchanged image: only SIDLE goes out");
+
+    // Reads
+    first = radio.ReadStatus(CC1101_CONFIG::VERSION);
+    radio.RunPending();
+    check(radio.Result(first, &value, 1) == 1 && value == SimulatedRadioBus::kVersion, "VERSION read");
+
+    // A failed flush fails the operation that staged the write, not the one whose strobe flushed it
+    op     = radio.Begin();
+    radio.AddWrite(op, CC1101_CONFIG::SYNC1, (byte)~bus.Register(CC1101_CONFIG::SYNC1));
+    first  = radio.Submit(op);
+    second = radio.Strobe(CC1101_CONFIG::SIDLE);
+    value  = bus.Register(CC1101_CONFIG::SYNC1);
+    bus.FailNext(1, RadioError::SpiFailure);
+    radio.RunPending();
+    check(radio.Status(first) == RadioOpStatus::Failed && radio.Error(first) == RadioError::SpiFailure, "write that didn't reach the chip fails");
+    check(radio.Status(second) == RadioOpStatus::Done, "strobe after it still runs");
+    check(bus.Register(CC1101_CONFIG::SYNC1) == value, "chip unchanged");
+
+    // The failed write is unknown now, so the same value goes out again
+    bus.ResetCounters();
+    op    = radio.Begin();
+    radio.AddWrite(op, CC1101_CONFIG::SYNC1, value);
+    first = radio.Submit(op);
+    radio.RunPending();
+    check(radio.Status(first) == RadioOpStatus::Done && bus.Transactions() == 1, "register rewritten after a failed write");
+
+    printf("%s\n", failures == 0 ? "AsyncRadio: OK" : "AsyncRadio: FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Runs RadioBusConformance against SimulatedRadioBus, so the checks and the model are kept honest without a chip.
+// Exits nonzero if any check fails; each failure is logged.
+//   bus_conformance
+#include <cstdio>
+#include <CC1101Lib/SimulatedRadioBus.h>
+#include <CC1101Lib/RadioBusConformance.h>
+
+using namespace TI_CC1101;
+
+int main()
+{
+    SimulatedRadioBus bus;
+
+    if (!RadioBusConformance::Run(bus))
+    {
+        printf("SimulatedRadioBus: FAILED\n");
+        return 1;
+    }
+    printf("SimulatedRadioBus: OK\n");
+    return 0;
+}
@@ -0,0 +1,422 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Replays a capture recorded by CaptureStreamer.
+//
+//   capture_replay [--speed N] [--extract out.cc1] [--verbose] [--learn] [--filter MIN_US] capture
+//
+// capture is either a .cc1 file or a raw serial log containing framed capture output; the frames are pulled out of
+// the log first. --speed N paces records at N times real time, 0 (the default) replays as fast as possible.
+// --extract writes the unframed .cc1 stream and exits. Pulses go through every protocol in KnownProtocols,
+// --verbose prints each decoded frame. --learn runs PulseAnalyzer over each burst of pulses and prints the timing
+// tables it comes up with. --filter puts a PulseFilter, with MinPulseMicros = MIN_US, in front of the decoders the
+// way CC1101Device does, and reports what it dropped.
+#include <map>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <CC1101Lib/PulseAnalyzer.h>
+#include <CC1101Lib/PulseDecoder.h>
+#include <CC1101Lib/PulseFilter.h>
+#include <CC1101Lib/RfCapture.h>
+
+using namespace TI_CC1101;
+
+namespace
+{
+    // Where replayed records go
+    class ReplaySink
+    {
+      public:
+        virtual ~ReplaySink() = default;
+        virtual void OnPulse(uint32_t timestampMicros, const Pulse &pulse) = 0;
+        virtual void OnFifoBlock(const CaptureRecord &record) = 0;
+        virtual void Report() = 0;
+    };
+
+    class StatisticsSink : public ReplaySink
+    {
+      public:
+        void OnPulse(uint32_t, const Pulse &pulse) override
+        {
+            m_pulses++;
+            m_pulseMicros += pulse.DurationMicros;
+            m_histogram[std::min<size_t>(pulse.DurationMicros / 100, kBuckets - 1)]++;
+        }
+        void OnFifoBlock(const CaptureRecord &record) override
+        {
+            m_blocks++;
+            m_blockBytes += record.Length;
+            // With append status, bit 7 of the second status byte is CRC_OK
+            m_crcOk += (record.LqiCrcOk & 0x80) ? 1 : 0;
+        }
+        void Report() override
+        {
+            printf("%llu pulses, %.3f s of signal\n", (unsigned long long)m_pulses, m_pulseMicros / 1e6);
+            for (size_t i = 0; i < kBuckets; i++)
+            {
+                if (m_histogram[i] != 0)
+                {
+                    printf("  %5zu%s us: %llu\n", i * 100, i == kBuckets - 1 ? "+" : " ", (unsigned long long)m_histogram[i]);
+                }
+            }
+            printf("%llu FIFO blocks, %llu bytes, %llu with CRC_OK\n", (unsigned long long)m_blocks, (unsigned long long)m_blockBytes, (unsigned long long)m_crcOk);
+        }
+
+      private:
+        static const size_t kBuckets = 50;
+
+        uint64_t m_pulses              = 0;
+        uint64_t m_pulseMicros         = 0;
+        uint64_t m_histogram[kBuckets] = {};
+        uint64_t m_blocks              = 0;
+        uint64_t m_blockBytes          = 0;
+        uint64_t m_crcOk               = 0;
+    };
+
+    class DecoderSink : public ReplaySink
+    {
+      public:
+        DecoderSink(bool verbose, int filterMinMicros) : m_verbose(verbose), m_filtered(filterMinMicros >= 0)
+        {
+            PulseFilterConfig filterConfig;
+
+            m_bank.Register(KnownProtocols::EV1527);
+            m_bank.Register(KnownProtocols::PT2262);
+            m_bank.Register(KnownProtocols::NexaHomeEasy);
+            m_bank.Register(KnownProtocols::Somfy);
+            m_bank.SetCallback(onFrame, this);
+            filterConfig.MinPulseMicros = m_filtered ? filterMinMicros : 0;
+            m_filter.Configure(filterConfig);
+            m_filter.SetProtocols(m_bank);
+        }
+        void OnPulse(uint32_t timestampMicros, const Pulse &pulse) override
+        {
+            Pulse    filtered[PulseFilter::kMaxHeldPulses + 3];
+            uint32_t filteredMicros = 0;
+            size_t   count;
+
+            if (!m_filtered)
+            {
+                m_fed++;
+                m_bank.Feed(timestampMicros, pulse);
+                return;
+            }
+            count = m_filter.Filter(timestampMicros, std::span<const Pulse>(&pulse, 1), true, filtered, filteredMicros);
+            m_fed += count;
+            m_bank.Feed(filteredMicros, std::span<const Pulse>(filtered, count));
+        }
+        void OnFifoBlock(const CaptureRecord &) override {}
+        void Report() override
+        {
+            if (m_filtered)
+            {
+                const PulseFilterStats &stats = m_filter.Stats();
+                printf("filter: %u glitches, %u off protocol, %u passed\n", stats.Glitches, stats.OffProtocol, stats.Passed);
+            }
+            printf("%llu pulses decoded\n", (unsigned long long)m_fed);
+            for (const auto &[name, count] : m_counts)
+            {
+                printf("%-16s %llu frames\n", name.c_str(), (unsigned long long)count);
+            }
+        }
+
+      private:
+        static void onFrame(const DecodedFrame &frame, void *context)
+        {
+            DecoderSink *sink = static_cast<DecoderSink *>(context);
+            sink->m_counts[frame.Protocol->Name]++;
+            if (sink->m_verbose)
+            {
+                printf("%10.6f %-16s %2d bits %016llX\n", frame.TimestampMicros / 1e6, frame.Protocol->Name, frame.BitCount, (unsigned long long)frame.Bits);
+            }
+        }
+
+        PulseDecoderBank                m_bank;
+        PulseFilter                     m_filter;
+        bool                            m_verbose;
+        bool                            m_filtered;
+        uint64_t                        m_fed = 0;
+        std::map<std::string, uint64_t> m_counts;
+    };
+
+    // Bursts end at a long silence or when the analyzer window fills up
+    class LearnSink : public ReplaySink
+    {
+      public:
+        void OnPulse(uint32_t timestampMicros, const Pulse &pulse) override
+        {
+            if (m_analyzer.Count() == 0)
+            {
+                m_burstMicros = timestampMicros;
+            }
+            m_analyzer.Add(pulse);
+            if ((!pulse.Level && pulse.DurationMicros >= kSilenceMicros) || m_analyzer.Full())
+            {
+                analyze();
+            }
+        }
+        void OnFifoBlock(const CaptureRecord &) override {}
+        void Report() override
+        {
+            analyze();
+            printf("%llu bursts, %llu learned\n", (unsigned long long)m_bursts, (unsigned long long)m_learned);
+        }
+
+      private:
+        static const uint32_t kSilenceMicros = 100000;
+
+        void analyze()
+        {
+            static const char *kEncodings[] = {"unknown", "PWM", "PPM", "Manchester"};
+            PulseAnalysis      analysis;
+
+            if (m_analyzer.Count() == 0)
+            {
+                return;
+            }
+            m_bursts++;
+            if (m_analyzer.Analyze(analysis))
+            {
+                const ProtocolTiming &timing = analysis.Timing;
+
+                m_learned++;
+                printf("%10.6f %s, %d bits x %d, bit %u us, gap %u us, sync", m_burstMicros / 1e6, kEncodings[(int)analysis.Encoding],
+                       analysis.BitsPerFrame, analysis.Frames, analysis.SymbolPeriodMicros, analysis.FrameGapMicros);
+                for (int i = 0; i < timing.SyncLength; i++)
+                {
+                    printf(" %u", timing.Sync[i]);
+                }
+                if (timing.Encoding == PulseEncoding::Manchester)
+                {
+                    printf(", half-bit %u\n", timing.HalfBitMicros);
+                }
+                else
+                {
+                    printf(", 0 = %u/%u, 1 = %u/%u\n", timing.Zero[0], timing.Zero[1], timing.One[0], timing.One[1]);
+                }
+            }
+            m_analyzer.Reset();
+        }
+
+        PulseAnalyzer m_analyzer;
+        uint32_t      m_burstMicros = 0;
+        uint64_t      m_bursts      = 0;
+        uint64_t      m_learned     = 0;
+    };
+
+    class MappedFile
+    {
+      public:
+        bool Open(const char *path)
+        {
+            struct stat info;
+            int         fd = open(path, O_RDONLY);
+
+            if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0)
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+                return false;
+            }
+            m_length = (size_t)info.st_size;
+            m_data   = mmap(nullptr, m_length, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (m_data == MAP_FAILED)
+            {
+                m_data = nullptr;
+                return false;
+            }
+            // Records are walked front to back exactly once
+            madvise(m_data, m_length, MADV_SEQUENTIAL);
+            return true;
+        }
+        ~MappedFile()
+        {
+            if (m_data != nullptr)
+            {
+                munmap(m_data, m_length);
+            }
+        }
+        const byte *Data() const { return static_cast<const byte *>(m_data); }
+        size_t      Length() const { return m_length; }
+
+      private:
+        void  *m_data   = nullptr;
+        size_t m_length = 0;
+    };
+
+    void printHeader(const CaptureHeader &header)
+    {
+        printf("capture v%u, %.3f MHz, config hash %08X\n", header.Version, header.CarrierFrequencyMHz, header.ConfigHash);
+        printf("registers:");
+        for (size_t i = 0; i < sizeof(header.Registers); i++)
+        {
+            printf("%s%02X", (i % 16) == 0 ? "\n  " : " ", header.Registers[i]);
+        }
+        printf("\nPATABLE:");
+        for (byte value : header.PATable)
+        {
+            printf(" %02X", value);
+        }
+        printf("\n");
+    }
+
+    int replay(const byte *data, size_t length, double speed, const std::vector<ReplaySink *> &sinks)
+    {
+        CaptureReader   reader(data, length);
+        CaptureHeader   header;
+        CaptureRecord   record        = {};
+        Pulse           pulse;
+        uint64_t        records       = 0;
+        uint64_t        lastTimestamp = 0;
+        auto            start   = std::chrono::steady_clock::now();
+
+        if (!reader.ReadHeader(header))
+        {
+            fprintf(stderr, "not a capture\n");
+            return 1;
+        }
+        printHeader(header);
+        while (reader.Next(record))
+        {
+            records++;
+            lastTimestamp = record.TimestampMicros;
+            if (speed > 0)
+            {
+                std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t)(record.TimestampMicros / speed)));
+            }
+            if (record.Type == CaptureRecordType::Pulses)
+            {
+                // Sinks work on the device's 32 bit clock, wrap included
+                uint32_t timestamp = (uint32_t)record.TimestampMicros;
+                while (reader.NextPulse(pulse))
+                {
+                    for (ReplaySink *sink : sinks)
+                    {
+                        sink->OnPulse(timestamp, pulse);
+                    }
+                    timestamp += pulse.DurationMicros;
+                }
+            }
+            else
+            {
+                for (ReplaySink *sink : sinks)
+                {
+                    sink->OnFifoBlock(record);
+                }
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printf("%llu records, %.3f s captured, replayed in %.3f s\n", (unsigned long long)records, lastTimestamp / 1e6, elapsed.count());
+        for (ReplaySink *sink : sinks)
+        {
+            sink->Report();
+        }
+        return 0;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    double            speed       = 0;
+    const char       *extractPath = nullptr;
+    const char       *inputPath   = nullptr;
+    MappedFile        input;
+    std::vector<byte> unframed;
+    const byte       *data    = nullptr;
+    size_t            length  = 0;
+    bool              verbose = false;
+    bool              learn   = false;
+    int               filter  = -1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+        {
+            speed = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--extract") == 0 && i + 1 < argc)
+        {
+            extractPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--verbose") == 0)
+        {
+            verbose = true;
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            filter = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--learn") == 0)
+        {
+            learn = true;
+        }
+        else
+        {
+            inputPath = argv[i];
+        }
+    }
+    if (inputPath == nullptr || !input.Open(inputPath))
+    {
+        fprintf(stderr, "usage: %s [--speed N] [--extract out.cc1] [--verbose] [--learn] [--filter MIN_US] capture\n", argv[0]);
+        return 1;
+    }
+
+    data   = input.Data();
+    length = input.Length();
+    if (length < 4 || memcmp(data, &CaptureHeader::kMagic, 4) != 0)
+    {
+        size_t badFrames = 0;
+
+        unframed.resize(length);
+        unframed.resize(CaptureFraming::Unframe(data, length, unframed.data(), &badFrames));
+        fprintf(stderr, "serial log: %zu capture bytes, %zu bad frames\n", unframed.size(), badFrames);
+        data   = unframed.data();
+        length = unframed.size();
+    }
+
+    if (extractPath != nullptr)
+    {
+        FILE *output = fopen(extractPath, "wb");
+        if (output == nullptr || fwrite(data, 1, length, output) != length)
+        {
+            fprintf(stderr, "can't write %s\n", extractPath);
+            return 1;
+        }
+        fclose(output);
+        return 0;
+    }
+    StatisticsSink            statistics;
+    DecoderSink               decoders(verbose, filter);
+    LearnSink                 learner;
+    std::vector<ReplaySink *> sinks = {&statistics, &decoders};
+
+    if (learn)
+    {
+        sinks.push_back(&learner);
+    }
+    return replay(data, length, speed, sinks);
+}
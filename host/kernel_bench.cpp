@@ -0,0 +1,80 @@
+// Copyright (C) 2024 Amol Deshpande
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Throughput of the CRC16 and PN9 kernels on this machine. Also checks every implementation against the reference.
+//   kernel_bench [megabytes]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <CC1101Lib/PacketKernels.h>
+
+using namespace TI_CC1101;
+
+namespace
+{
+    template <typename F> double measureGBps(size_t bytes, F &&kernel)
+    {
+        auto start = std::chrono::steady_clock::now();
+        kernel();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return bytes / elapsed.count() / 1e9;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t            megabytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 256;
+    size_t            length    = megabytes << 20;
+    std::vector<byte> buffer(length);
+    uint16_t          reference = 0;
+    uint16_t          crc       = 0;
+    int               failures  = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        buffer[i] = (byte)(i * 2654435761u >> 24);
+    }
+
+    printf("%zu MB, PCLMULQDQ %s\n", megabytes, PacketKernels::ClmulSupported() ? "yes" : "no");
+
+    double gbps = measureGBps(length, [&] { reference = PacketKernels::Crc16Reference(buffer.data(), length); });
+    printf("crc16 reference   %8.3f GB/s  %04X\n", gbps, reference);
+
+    gbps = measureGBps(length, [&] { crc = PacketKernels::Crc16SliceBy8(buffer.data(), length); });
+    printf("crc16 slice-by-8  %8.3f GB/s  %04X\n", gbps, crc);
+    failures += crc != reference;
+
+    if (PacketKernels::ClmulSupported())
+    {
+        gbps = measureGBps(length, [&] { crc = PacketKernels::Crc16Clmul(buffer.data(), length); });
+        printf("crc16 clmul       %8.3f GB/s  %04X\n", gbps, crc);
+        failures += crc != reference;
+    }
+
+    std::vector<byte> copy = buffer;
+    gbps = measureGBps(length, [&] { PacketKernels::Pn9WhitenReference(copy.data(), length); });
+    printf("pn9 reference     %8.3f GB/s\n", gbps);
+
+    gbps = measureGBps(length, [&] { PacketKernels::Pn9Whiten(buffer.data(), length); });
+    printf("pn9 table         %8.3f GB/s\n", gbps);
+    failures += copy != buffer;
+
+    if (failures != 0)
+    {
+        printf("%d kernel(s) disagree with the reference\n", failures);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -17,21 +17,20 @@
 #include <memory>
 #include <driver/spi_master.h>
 #include <esp_log.h>
+#include <nvs_flash.h>
 #include<CC1101Lib/SpiMaster.h>
 #include <CC1101Lib/CC1101Lib.h>
 #include <CC1101Lib/CC1101Device.h>
+#include <CC1101Lib/RadioBusConformance.h>
+#include <CC1101Lib/PacketKernels.h>
 
 static const char *TAG = "main";
 using namespace TI_CC1101;
 
-static QueueHandle_t sg_CC1101_ISRQueueHandle;
-
 extern "C" void app_main(void)
 {
     CC1101Device cc1101Device; 
 
-    sg_CC1101_ISRQueueHandle = xQueueCreate(10, sizeof(CC1101Device *));
-
     auto spiMaster = std::make_shared<SpiMaster>();
 
     //https://randomnerdtutorials.com/esp32-pinout-reference-gpios/, VSPI Pinout
@@ -40,26 +39,58 @@ extern "C" void app_main(void)
         .mosiPin = GPIO_NUM_23,
         .clockPin = GPIO_NUM_18,
         .chipSelectPin = GPIO_NUM_5,
-        .clockFrequencyHz = 4'000'000,
+        .clockFrequencyHz = 10'000'000,
+        .burstClockFrequencyHz = 6'500'000,
         .queueSize = 8,
+        // Hardware CSn saves the GPIO toggles per call, but runs everything at the burst clock (6.5 MHz)
+        .hardwareChipSelect = false,
         .spiMode = SpiMode::ModeZero,
         .spiHost = Esp32SPIHost::HOST_VSPI
     };
     CC110DeviceConfig somfyRadioConfig = {
         .TxPin = GPIO_NUM_13,
         .RxPin = GPIO_NUM_14,
-        .InterruptQueue = sg_CC1101_ISRQueueHandle
+        .UseWarmBootSnapshot = true
     };
 
     esp_log_level_set("*", ESP_LOG_DEBUG);
 
+    // The radio snapshot lives in NVS. A full partition or one from a newer IDF is erased; the snapshot is only a cache.
+    esp_err_t nvsError = nvs_flash_init();
+    if (nvsError == ESP_ERR_NVS_NO_FREE_PAGES || nvsError == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        nvsError = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(nvsError);
+
+#ifdef CC1101_KERNEL_BENCHMARK
+    PacketKernels::Benchmark();
+#endif
+
     ESP_LOGI(TAG, "Initializing SPI");
     spiMaster->Init(spiConfig);
+#ifdef CC1101_BUS_CONFORMANCE
+    if (!RadioBusConformance::Run(*spiMaster))
+    {
+        ESP_LOGW(TAG, "SPI bus doesn't behave the way the driver expects");
+    }
+#endif
 
     ESP_LOGI(TAG, "Initializing CC1101");
-    assert(cc1101Device.Init(spiMaster,somfyRadioConfig));
+    Result<void> result = cc1101Device.Init(spiMaster,somfyRadioConfig);
+    if (!result)
+    {
+        ESP_LOGE(TAG, "CC1101 init failed: %s", RadioErrorName(result.Error()));
+        return;
+    }
 
-    cc1101Device.BeginReceive();
+    result = cc1101Device.BeginReceive();
+    if (!result)
+    {
+        ESP_LOGE(TAG, "CC1101 receive failed: %s", RadioErrorName(result.Error()));
+        return;
+    }
 
     while(true)
     {